@@ -0,0 +1,115 @@
+/************************************************************************
+
+    edc_benchmark.cpp
+
+    EFM-library - EDC implementation check and benchmark
+    Copyright (C) 2025 Simon Inns
+
+    This file is part of EFM-Tools.
+
+    This is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+************************************************************************/
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QVector>
+#include <QDebug>
+
+#include <random>
+
+#include "edc.h"
+
+// Checks the slice-by-8 and PCLMULQDQ EDC implementations against the
+// reference implementation on random sectors and then times each of them.
+// Usage: efm-edc-benchmark [number of sectors]
+//
+// Returns 0 if all the supported implementations agree, 1 otherwise
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    qint32 sectorCount = 20000;
+    if (argc > 1) {
+        sectorCount = QString(argv[1]).toInt();
+        if (sectorCount < 1) {
+            qCritical("Specified number of sectors must be greater than zero");
+            return 1;
+        }
+    }
+
+    const Edc edc;
+    const Edc::Implementation implementations[] = { Edc::Reference, Edc::SliceBy8, Edc::Pclmul };
+    qInfo().noquote() << "Selected EDC implementation:" << Edc::implementationName(edc.implementation());
+
+    // Random sectors
+    std::mt19937 generator(0x2064);
+    std::uniform_int_distribution<qint32> byteDistribution(0, 255);
+    std::uniform_int_distribution<qint32> sizeDistribution(0, 2352);
+    QVector<uchar> sectors(sectorCount * 2352);
+    for (qint32 i = 0; i < sectors.size(); i++) {
+        sectors[i] = static_cast<uchar>(byteDistribution(generator));
+    }
+
+    // Check every implementation against the reference over the EDC ranges of
+    // Mode 1 (2064) and Mode 2 Form 1/Form 2 (2056/2332) sectors and over a
+    // random size (including sizes that are not a whole number of blocks)
+    bool allMatch = true;
+    for (const Edc::Implementation implementation : implementations) {
+        if (implementation == Edc::Reference) continue;
+        if (!Edc::isSupported(implementation)) {
+            qInfo().noquote() << "The" << Edc::implementationName(implementation) << "implementation is not supported by this CPU";
+            continue;
+        }
+
+        qint32 mismatches = 0;
+        for (qint32 sector = 0; sector < sectorCount; sector++) {
+            const uchar *data = sectors.constData() + sector * 2352;
+            const qint32 sizes[] = { 2064, 2056, 2332, sizeDistribution(generator) };
+            for (const qint32 size : sizes) {
+                if (edc.crc32(implementation, data, size) != edc.crc32(Edc::Reference, data, size)) mismatches++;
+            }
+        }
+
+        if (mismatches) {
+            qCritical().noquote() << "The" << Edc::implementationName(implementation) << "implementation has" << mismatches
+                << "mismatches with the reference implementation";
+            allMatch = false;
+        } else {
+            qInfo().noquote() << "The" << Edc::implementationName(implementation) << "implementation matches the reference implementation on"
+                << sectorCount << "sectors";
+        }
+    }
+
+    // Time each implementation over the Mode 1 EDC range
+    for (const Edc::Implementation implementation : implementations) {
+        if (!Edc::isSupported(implementation)) continue;
+
+        QElapsedTimer timer;
+        quint32 result = 0;
+        timer.start();
+        for (qint32 sector = 0; sector < sectorCount; sector++) {
+            result ^= edc.crc32(implementation, sectors.constData() + sector * 2352, 2064);
+        }
+        const qint64 elapsed = qMax<qint64>(timer.nsecsElapsed(), 1);
+
+        const double megabytesPerSecond = (static_cast<double>(sectorCount) * 2064.0 / (1024.0 * 1024.0)) / (elapsed / 1e9);
+        qInfo().noquote().nospace() << Edc::implementationName(implementation) << ": "
+            << QString::number(static_cast<double>(elapsed) / sectorCount, 'f', 1) << " ns/sector, "
+            << QString::number(megabytesPerSecond, 'f', 1) << " MiB/s (result " << QString::number(result, 16) << ")";
+    }
+
+    return allMatch ? 0 : 1;
+}
@@ -0,0 +1,65 @@
+/************************************************************************
+
+    edc.h
+
+    EFM-library - ECMA-130 Error Detection Code (EDC) functions
+    Copyright (C) 2025 Simon Inns
+
+    This file is part of EFM-Tools.
+
+    This is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+************************************************************************/
+
+#ifndef EDC_H
+#define EDC_H
+
+#include <QtGlobal>
+#include <QByteArray>
+#include <QString>
+#include <QDebug>
+
+// ECMA-130 EDC (a 32-bit CRC with the polynomial
+// P(x) = (x^16 + x^15 + x^2 + 1) * (x^16 + x^2 + x + 1), least significant
+// bit first, with no initial value or final inversion)
+//
+// Three implementations are provided: the original byte-at-a-time table
+// look-up (kept as the reference), a slice-by-8 table look-up and, on x86-64,
+// carry-less multiply (PCLMULQDQ) folding.  The fastest implementation
+// supported by the CPU is selected at run-time (see libs/efm/benchmark for
+// the check of the implementations against each other).
+class Edc
+{
+public:
+    enum Implementation { Reference, SliceBy8, Pclmul };
+
+    Edc();
+    quint32 crc32(const QByteArray &src, qint32 size) const;
+    quint32 crc32(const uchar *data, qint32 size) const;
+    quint32 crc32(Implementation implementation, const uchar *data, qint32 size) const;
+
+    Implementation implementation() const { return m_implementation; }
+    static QString implementationName(Implementation implementation);
+    static bool isSupported(Implementation implementation);
+
+private:
+    Implementation m_implementation;
+    quint32 m_sliceLut[8][256];
+
+    quint32 crc32Reference(const uchar *data, qint32 size) const;
+    quint32 crc32SliceBy8(quint32 crc, const uchar *data, qint32 size) const;
+    quint32 crc32Pclmul(const uchar *data, qint32 size) const;
+};
+
+#endif // EDC_H
@@ -30,6 +30,12 @@
 #include <cstdint>
 #include <QDebug>
 
+// Per-frame quality flags carried from the channel frame decoding through to the F2 frames
+enum FrameQualityFlag {
+    FrameBitCountError = 0x01, // Channel frame was not exactly 588 bits
+    FrameSubcodeError = 0x02   // Subcode EFM symbol was invalid
+};
+
 // Frame class - base class for F1, F2, and F3 frames
 class Frame
 {
@@ -85,6 +91,12 @@ public:
     F2Frame();
     int frameSize() const override;
     void showData();
+
+    void setQualityFlags(quint8 qualityFlags);
+    quint8 qualityFlags() const;
+
+private:
+    quint8 m_qualityFlags;
 };
 
 class F3Frame : public Frame
@@ -103,11 +115,15 @@ public:
     QString f3FrameTypeAsString() const;
     quint8 subcodeByte() const;
 
+    void setQualityFlags(quint8 qualityFlags);
+    quint8 qualityFlags() const;
+
     void showData();
 
 private:
     F3FrameType m_f3FrameType;
     quint8 m_subcodeByte;
+    quint8 m_qualityFlags;
 };
 
 #endif // FRAME_H
\ No newline at end of file
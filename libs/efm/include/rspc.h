@@ -27,12 +27,43 @@
 
 #include <QDebug>
 
+// ECMA-130 RSPC (Reed-Solomon Product-like Code) Q and P parity error correction
+//
+// The Q (RS(45,43)) and P (RS(26,24)) codeword layouts are held in
+// precomputed index tables and each codeword is decoded in place from its
+// two syndromes (correcting one error or up to two erasures), so nothing
+// is allocated per codeword or per sector.
 class Rspc
 {
 public:
     Rspc();
     void qParityEcc(QByteArray &inputData, QByteArray &errorData, bool m_showDebug);
     void pParityEcc(QByteArray &inputData, QByteArray &errorData, bool m_showDebug);
+    qint32 iterativeEcc(QByteArray &inputData, QByteArray &errorData, qint32 maxPasses, bool m_showDebug);
+    qint32 iterativeEcc(uchar *data, uchar *erasures, qint32 maxPasses, bool m_showDebug);
+
+private:
+    enum {
+        QCodewords = 52,
+        QLength = 45,
+        PCodewords = 86,
+        PLength = 26
+    };
+
+    struct Tables {
+        quint8 exp[512];
+        quint8 log[256];
+        quint16 qIndex[QCodewords][QLength];
+        quint16 pIndex[PCodewords][PLength];
+        Tables();
+    };
+    static const Tables &tables();
+
+    qint32 qPass(uchar *data, uchar *erasures, qint32 &correctedSymbols) const;
+    qint32 pPass(uchar *data, uchar *erasures, qint32 &correctedSymbols) const;
+    qint32 decodeCodeword(uchar *data, uchar *erasures, const quint16 *index, qint32 length) const;
+
+    const Tables &m_tables;
 };
 
-#endif // RSPC_H
\ No newline at end of file
+#endif // RSPC_H
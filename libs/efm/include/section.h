@@ -44,6 +44,7 @@ public:
 
     friend QDataStream& operator<<(QDataStream& stream, const F2Section& section);
     friend QDataStream& operator>>(QDataStream& stream, F2Section& section);
+    friend class F2SectionFile;
 
     SectionMetadata metadata;
 
@@ -52,6 +53,34 @@ private:
     bool m_isPadding;
 };
 
+// F2 section file format
+//
+// Files start with a 16 byte header followed by the F2 sections serialised
+// with QDataStream.  From version 2 each section is followed by one quality
+// flags byte (see FrameQualityFlag) per frame.  Header values are
+// little-endian.
+//
+// Header:
+//   0-7    Magic "EFMF2SEC"
+//   8-11   Version
+//   12-15  Reserved (0)
+//
+// Files without the header are the original (version 1) format, which has
+// no quality flags; these are read with all quality flags clear
+class F2SectionFile
+{
+public:
+    enum {
+        Version = 2,
+        HeaderSize = 16
+    };
+
+    static void encodeHeader(quint8 *header);
+    static qint32 headerVersion(const quint8 *header, qint64 size);
+    static void writeQualityFlags(QDataStream &stream, const F2Section &section);
+    static void readQualityFlags(QDataStream &stream, F2Section &section);
+};
+
 class F1Section
 {
 public:
@@ -46,6 +46,7 @@ SectorAddress();
     qint32 frameNumber() const { return m_address % 75; }
 
     QString toString() const;
+    void toBcd(quint8 *bcd) const;
 
     bool operator==(const SectorAddress &other) const { return m_address == other.m_address; }
     bool operator!=(const SectorAddress &other) const { return m_address != other.m_address; }
@@ -99,56 +100,100 @@ private:
     static quint8 intToBcd(quint32 value);
 };
 
+// Sectors hold their data, error and padding flags in fixed size inline
+// storage (one flag byte per data byte, 0 or 1).  The pointer accessors give
+// direct access to the storage without copying
 class RawSector
 {
 public:
+    enum { Size = 2352 };
+
     RawSector();
     void pushData(const QByteArray &inData);
     void pushErrorData(const QByteArray &inData);
     void pushPaddedData(const QByteArray &inData);
-    QByteArray data() const;
-    QByteArray errorData() const;
-    QByteArray paddedData() const;
-    quint32 size() const;
+    const quint8 *data() const { return m_data; }
+    const quint8 *errorData() const { return m_errorData; }
+    const quint8 *paddedData() const { return m_paddedData; }
+    quint8 *data() { return m_data; }
+    quint8 *errorData() { return m_errorData; }
+    quint8 *paddedData() { return m_paddedData; }
+    quint32 size() const { return Size; }
     void showData();
 
 private:
-    QByteArray m_data;
-    QByteArray m_errorData;
-    QByteArray m_paddedData;
+    quint8 m_data[Size];
+    quint8 m_errorData[Size];
+    quint8 m_paddedData[Size];
 
     quint8 bcdToInt(quint8 bcd);
 };
 
+// A sector keeps the whole (corrected) raw sector so that it can be written in
+// raw form; data() and size() give the user data for the sector's mode and
+// form (2048 bytes for Mode 1 and Mode 2 Form 1, 2324 bytes for Mode 2 Form 2
+// and 2336 bytes for Mode 2 without an XA subheader)
 class Sector
 {
 public:
+    enum { Size = 2048, RawSize = 2352 };
+
     Sector();
     void pushData(const QByteArray &inData);
     void pushErrorData(const QByteArray &inData);
     void pushPaddedData(const QByteArray &inData);
-    QByteArray data() const;
-    QByteArray errorData() const;
-    QByteArray paddedData() const;
+    void pushRawSector(const RawSector &rawSector);
+    const quint8 *data() const { return m_data + userDataOffset(); }
+    const quint8 *errorData() const { return m_errorData + userDataOffset(); }
+    const quint8 *paddedData() const { return m_paddedData + userDataOffset(); }
+    quint8 *data() { return m_data + userDataOffset(); }
+    quint8 *errorData() { return m_errorData + userDataOffset(); }
+    quint8 *paddedData() { return m_paddedData + userDataOffset(); }
     quint32 size() const;
+    const quint8 *rawData() const { return m_data; }
+    const quint8 *rawErrorData() const { return m_errorData; }
+    quint8 *rawData() { return m_data; }
+    quint8 *rawErrorData() { return m_errorData; }
     void showData();
 
     void setAddress(SectorAddress address);
     SectorAddress address() const;
     void setMode(qint32 mode);
     qint32 mode() const;
+    void setForm(qint32 form);
+    qint32 form() const { return m_form; }
 
     void dataValid(bool isValid) { m_validData = isValid; }
     bool isDataValid() const { return m_validData; }
 
 private:
-    QByteArray m_data;
-    QByteArray m_errorData;
-    QByteArray m_paddedData;
+    quint8 m_data[RawSize];
+    quint8 m_errorData[RawSize];
+    quint8 m_paddedData[RawSize];
 
     SectorAddress m_address;
     qint32 m_mode;
+    qint32 m_form;
     bool m_validData;
+
+    qint32 userDataOffset() const { return (m_mode == 2 && m_form != 0) ? 24 : 16; }
+};
+
+// A run of consecutive sectors, used to pass ranges of missing sectors through
+// the decoders without creating a Sector for each one
+class SectorRange
+{
+public:
+    SectorRange() : m_first(0), m_count(0) {}
+    SectorRange(const SectorAddress &first, qint32 count) : m_first(first), m_count(count) {}
+
+    SectorAddress first() const { return m_first; }
+    SectorAddress last() const { return m_first + (m_count - 1); }
+    qint32 count() const { return m_count; }
+
+private:
+    SectorAddress m_first;
+    qint32 m_count;
 };
 
 #endif // SECTOR_H
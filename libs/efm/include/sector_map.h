@@ -0,0 +1,88 @@
+/************************************************************************
+
+    sector_map.h
+
+    EFM-library - Binary sector map (status and error bitmap) format
+    Copyright (C) 2025 Simon Inns
+
+    This file is part of EFM-Tools.
+
+    This is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+************************************************************************/
+
+#ifndef SECTOR_MAP_H
+#define SECTOR_MAP_H
+
+#include <QtGlobal>
+
+#include "sector.h"
+
+// Binary sector map file format
+//
+// The file is a 24 byte header followed by one fixed size record per sector
+// in the order the sectors were written.  All values are little-endian.
+//
+// Header:
+//   0-7    Magic "EFMSMAP\0"
+//   8-11   Version
+//   12-15  Record size in bytes
+//   16-19  Error bitmap size in bytes
+//   20-23  Reserved (0)
+//
+// Record:
+//   0-3    Sector address (in frames from 00:00:00)
+//   4      Status flags
+//   5      Mode (-1 if unknown)
+//   6      Form (Mode 2 only)
+//   7      Reserved (0)
+//   8-301  Error bitmap for the 2352 byte raw sector (bit n % 8 of byte
+//          n / 8 is set if raw sector byte n is in error)
+//   302-303 Padding (0)
+//
+// Missing sectors are written as all zero records (so they can be left as a
+// hole in the file), which have no Present or Valid flag and an address of 0.
+//
+// As the records are fixed size the file can be memory mapped and indexed
+// directly rather than parsed
+class SectorMap
+{
+public:
+    enum {
+        Version = 1,
+        HeaderSize = 24,
+        BitmapSize = RawSector::Size / 8,
+        RecordSize = 304
+    };
+
+    enum StatusFlag {
+        Valid = 0x01,  // Sector data is valid (EDC correct or corrected)
+        Present = 0x02 // Record holds decoded sector data (i.e. the sector isn't missing)
+    };
+
+    static void encodeHeader(quint8 *header);
+    static bool isValidHeader(const quint8 *header, qint64 size);
+    static void encodeRecord(const Sector &sector, quint8 *record);
+    static void encodeRecord(qint32 address, quint8 status, qint32 mode, qint32 form,
+        const quint8 *errorData, quint8 *record);
+
+    static qint32 recordAddress(const quint8 *record);
+    static quint8 recordStatus(const quint8 *record) { return record[4]; }
+    static qint32 recordMode(const quint8 *record) { return static_cast<qint8>(record[5]); }
+    static qint32 recordForm(const quint8 *record) { return record[6]; }
+    static const quint8 *recordBitmap(const quint8 *record) { return record + 8; }
+    static void decodeBitmap(const quint8 *record, quint8 *errorData);
+};
+
+#endif // SECTOR_MAP_H
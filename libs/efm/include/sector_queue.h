@@ -0,0 +1,96 @@
+/************************************************************************
+
+    sector_queue.h
+
+    EFM-library - Sector queue class
+    Copyright (C) 2025 Simon Inns
+
+    This file is part of EFM-Tools.
+
+    This is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+************************************************************************/
+
+#ifndef SECTOR_QUEUE_H
+#define SECTOR_QUEUE_H
+
+#include <QtGlobal>
+#include <QVector>
+
+// First-in first-out queue held in a ring of preallocated slots
+//
+// Sectors are large (the data, error and padding flags are stored inline), so
+// rather than copying them into and out of a QQueue (which also allocates a
+// list node for every large item) the producer fills the next free slot in
+// place with tail() and push(), and the consumer reads the oldest sector in
+// place with head() before releasing it with pop().  The ring only grows
+// (doubling in size) when it is full, so once the decoding pipeline has
+// reached its working depth there are no further allocations.
+template <typename T>
+class SectorQueue
+{
+public:
+    explicit SectorQueue(qint32 capacity = 16)
+        : m_slots(qMax(capacity, 1)), m_head(0), m_size(0)
+    {}
+
+    // The next free slot.  A slot holds whatever was last stored in it, so
+    // the caller must set all of it before adding it to the queue with push()
+    T &tail()
+    {
+        if (m_size == m_slots.size()) grow();
+        return m_slots[index(m_size)];
+    }
+    void push() { m_size++; }
+    void push(const T &value)
+    {
+        tail() = value;
+        push();
+    }
+
+    // The oldest item in the queue (or the item at position n from it)
+    T &head() { return m_slots[m_head]; }
+    const T &head() const { return m_slots.at(m_head); }
+    T &at(qint32 n) { return m_slots[index(n)]; }
+    const T &at(qint32 n) const { return m_slots.at(index(n)); }
+    void pop()
+    {
+        m_head = index(1);
+        m_size--;
+    }
+
+    bool isEmpty() const { return m_size == 0; }
+    qint32 size() const { return m_size; }
+
+private:
+    QVector<T> m_slots;
+    qint32 m_head;
+    qint32 m_size;
+
+    qint32 index(qint32 n) const
+    {
+        const qint32 position = m_head + n;
+        return position < m_slots.size() ? position : position - m_slots.size();
+    }
+
+    void grow()
+    {
+        QVector<T> slots(m_slots.size() * 2);
+        for (qint32 i = 0; i < m_size; i++) slots[i] = m_slots.at(index(i));
+        m_slots.swap(slots);
+        m_head = 0;
+    }
+};
+
+#endif // SECTOR_QUEUE_H
@@ -0,0 +1,57 @@
+/************************************************************************
+
+    sector_verifier.h
+
+    EFM-library - ECMA-130 sector EDC checking and Q/P correction
+    Copyright (C) 2025 Simon Inns
+
+    This file is part of EFM-Tools.
+
+    This is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+************************************************************************/
+
+#ifndef SECTOR_VERIFIER_H
+#define SECTOR_VERIFIER_H
+
+#include <QtGlobal>
+#include <QDebug>
+
+#include "edc.h"
+#include "rspc.h"
+
+// EDC checking and RSPC (Q and P parity) correction of 2352 byte raw sectors
+// for Mode 1 and Mode 2 (XA Form 1 and Form 2).  The error data is one flag
+// byte per sector byte (non-zero for bytes in error), used as erasures by the
+// RSPC correction
+class SectorVerifier
+{
+public:
+    SectorVerifier();
+
+    static qint32 subheaderForm(const quint8 *data, const quint8 *errorData);
+    bool edcValid(const quint8 *data, qint32 form) const;
+    void correct(quint8 *data, quint8 *errorData, qint32 mode, bool showDebug);
+    bool verify(quint8 *data, quint8 *errorData, qint32 &mode, qint32 &form, bool &corrected, bool showDebug);
+    bool verifyMode2(quint8 *data, quint8 *errorData, qint32 &form, bool &corrected, bool showDebug);
+
+private:
+    Edc m_edc;
+    Rspc m_rspc;
+
+    bool verifyMode1(quint8 *data, quint8 *errorData, bool &corrected, bool showDebug);
+    static bool hasErrors(const quint8 *errorData, qint32 size);
+};
+
+#endif // SECTOR_VERIFIER_H
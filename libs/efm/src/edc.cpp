@@ -0,0 +1,231 @@
+/************************************************************************
+
+    edc.cpp
+
+    EFM-library - ECMA-130 Error Detection Code (EDC) functions
+    Copyright (C) 2025 Simon Inns
+
+    This file is part of EFM-Tools.
+
+    This is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+************************************************************************/
+
+#include "edc.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define EDC_HAVE_PCLMUL
+#include <emmintrin.h>
+#include <wmmintrin.h>
+#endif
+
+// This table is the CRC32 look-up for the EDC data
+static const quint32 crc32Lut[256] = {
+    0x00000000, 0x90910101, 0x91210201, 0x01B00300, 0x92410401, 0x02D00500, 0x03600600, 0x93F10701,
+    0x94810801, 0x04100900, 0x05A00A00, 0x95310B01, 0x06C00C00, 0x96510D01, 0x97E10E01, 0x07700F00,
+    0x99011001, 0x09901100, 0x08201200, 0x98B11301, 0x0B401400, 0x9BD11501, 0x9A611601, 0x0AF01700,
+    0x0D801800, 0x9D111901, 0x9CA11A01, 0x0C301B00, 0x9FC11C01, 0x0F501D00, 0x0EE01E00, 0x9E711F01,
+    0x82012001, 0x12902100, 0x13202200, 0x83B12301, 0x10402400, 0x80D12501, 0x81612601, 0x11F02700,
+    0x16802800, 0x86112901, 0x87A12A01, 0x17302B00, 0x84C12C01, 0x14502D00, 0x15E02E00, 0x85712F01,
+    0x1B003000, 0x8B913101, 0x8A213201, 0x1AB03300, 0x89413401, 0x19D03500, 0x18603600, 0x88F13701,
+    0x8F813801, 0x1F103900, 0x1EA03A00, 0x8E313B01, 0x1DC03C00, 0x8D513D01, 0x8CE13E01, 0x1C703F00,
+    0xB4014001, 0x24904100, 0x25204200, 0xB5B14301, 0x26404400, 0xB6D14501, 0xB7614601, 0x27F04700,
+    0x20804800, 0xB0114901, 0xB1A14A01, 0x21304B00, 0xB2C14C01, 0x22504D00, 0x23E04E00, 0xB3714F01,
+    0x2D005000, 0xBD915101, 0xBC215201, 0x2CB05300, 0xBF415401, 0x2FD05500, 0x2E605600, 0xBEF15701,
+    0xB9815801, 0x29105900, 0x28A05A00, 0xB8315B01, 0x2BC05C00, 0xBB515D01, 0xBAE15E01, 0x2A705F00,
+    0x36006000, 0xA6916101, 0xA7216201, 0x37B06300, 0xA4416401, 0x34D06500, 0x35606600, 0xA5F16701,
+    0xA2816801, 0x32106900, 0x33A06A00, 0xA3316B01, 0x30C06C00, 0xA0516D01, 0xA1E16E01, 0x31706F00,
+    0xAF017001, 0x3F907100, 0x3E207200, 0xAEB17301, 0x3D407400, 0xADD17501, 0xAC617601, 0x3CF07700,
+    0x3B807800, 0xAB117901, 0xAAA17A01, 0x3A307B00, 0xA9C17C01, 0x39507D00, 0x38E07E00, 0xA8717F01,
+    0xD8018001, 0x48908100, 0x49208200, 0xD9B18301, 0x4A408400, 0xDAD18501, 0xDB618601, 0x4BF08700,
+    0x4C808800, 0xDC118901, 0xDDA18A01, 0x4D308B00, 0xDEC18C01, 0x4E508D00, 0x4FE08E00, 0xDF718F01,
+    0x41009000, 0xD1919101, 0xD0219201, 0x40B09300, 0xD3419401, 0x43D09500, 0x42609600, 0xD2F19701,
+    0xD5819801, 0x45109900, 0x44A09A00, 0xD4319B01, 0x47C09C00, 0xD7519D01, 0xD6E19E01, 0x46709F00,
+    0x5A00A000, 0xCA91A101, 0xCB21A201, 0x5BB0A300, 0xC841A401, 0x58D0A500, 0x5960A600, 0xC9F1A701,
+    0xCE81A801, 0x5E10A900, 0x5FA0AA00, 0xCF31AB01, 0x5CC0AC00, 0xCC51AD01, 0xCDE1AE01, 0x5D70AF00,
+    0xC301B001, 0x5390B100, 0x5220B200, 0xC2B1B301, 0x5140B400, 0xC1D1B501, 0xC061B601, 0x50F0B700,
+    0x5780B800, 0xC711B901, 0xC6A1BA01, 0x5630BB00, 0xC5C1BC01, 0x5550BD00, 0x54E0BE00, 0xC471BF01,
+    0x6C00C000, 0xFC91C101, 0xFD21C201, 0x6DB0C300, 0xFE41C401, 0x6ED0C500, 0x6F60C600, 0xFFF1C701,
+    0xF881C801, 0x6810C900, 0x69A0CA00, 0xF931CB01, 0x6AC0CC00, 0xFA51CD01, 0xFBE1CE01, 0x6B70CF00,
+    0xF501D001, 0x6590D100, 0x6420D200, 0xF4B1D301, 0x6740D400, 0xF7D1D501, 0xF661D601, 0x66F0D700,
+    0x6180D800, 0xF111D901, 0xF0A1DA01, 0x6030DB00, 0xF3C1DC01, 0x6350DD00, 0x62E0DE00, 0xF271DF01,
+    0xEE01E001, 0x7E90E100, 0x7F20E200, 0xEFB1E301, 0x7C40E400, 0xECD1E501, 0xED61E601, 0x7DF0E700,
+    0x7A80E800, 0xEA11E901, 0xEBA1EA01, 0x7B30EB00, 0xE8C1EC01, 0x7850ED00, 0x79E0EE00, 0xE971EF01,
+    0x7700F000, 0xE791F101, 0xE621F201, 0x76B0F300, 0xE541F401, 0x75D0F500, 0x7460F600, 0xE4F1F701,
+    0xE381F801, 0x7310F900, 0x72A0FA00, 0xE231FB01, 0x71C0FC00, 0xE151FD01, 0xE0E1FE01, 0x7070FF00
+};
+Edc::Edc()
+    : m_implementation(Reference)
+{
+    // Slice n gives the CRC of a byte followed by n zero bytes
+    for (qint32 i = 0; i < 256; i++) {
+        m_sliceLut[0][i] = crc32Lut[i];
+    }
+    for (qint32 slice = 1; slice < 8; slice++) {
+        for (qint32 i = 0; i < 256; i++) {
+            const quint32 previous = m_sliceLut[slice - 1][i];
+            m_sliceLut[slice][i] = (previous >> 8) ^ crc32Lut[previous & 0xFF];
+        }
+    }
+
+    // Select the fastest implementation supported by the CPU (the
+    // implementations are checked against each other by efm-edc-benchmark)
+    m_implementation = isSupported(Pclmul) ? Pclmul : SliceBy8;
+    qDebug().noquote() << "Edc::Edc(): Using the" << implementationName(m_implementation) << "EDC implementation";
+}
+
+quint32 Edc::crc32(const QByteArray &src, qint32 size) const
+{
+    return crc32(reinterpret_cast<const uchar*>(src.constData()), size);
+}
+
+quint32 Edc::crc32(const uchar *data, qint32 size) const
+{
+    return crc32(m_implementation, data, size);
+}
+
+quint32 Edc::crc32(Implementation implementation, const uchar *data, qint32 size) const
+{
+    switch (implementation) {
+        case Pclmul:
+            return crc32Pclmul(data, size);
+        case SliceBy8:
+            return crc32SliceBy8(0, data, size);
+        default:
+            return crc32Reference(data, size);
+    }
+}
+
+QString Edc::implementationName(Implementation implementation)
+{
+    switch (implementation) {
+        case Pclmul:
+            return QString("PCLMULQDQ folding");
+        case SliceBy8:
+            return QString("slice-by-8");
+        default:
+            return QString("reference");
+    }
+}
+
+bool Edc::isSupported(Implementation implementation)
+{
+    if (implementation != Pclmul) return true;
+#if defined(EDC_HAVE_PCLMUL)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("pclmul");
+#else
+    return false;
+#endif
+}
+
+// CRC code adapted and used under GPLv3 from:
+// https://github.com/claunia/edccchk/blob/master/edccchk.c
+quint32 Edc::crc32Reference(const uchar *data, qint32 size) const
+{
+    quint32 crc = 0;
+
+    while(size--) {
+        crc = (crc >> 8) ^ crc32Lut[(crc ^ (*data++)) & 0xFF];
+    }
+
+    return crc;
+}
+
+quint32 Edc::crc32SliceBy8(quint32 crc, const uchar *data, qint32 size) const
+{
+    // 8 bytes per step (the CRC is little-endian, so the bytes are assembled
+    // explicitly rather than relying on the host byte order)
+    while (size >= 8) {
+        const quint32 low = crc ^ (data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<quint32>(data[3]) << 24));
+        const quint32 high = data[4] | (data[5] << 8) | (data[6] << 16) | (static_cast<quint32>(data[7]) << 24);
+        crc = m_sliceLut[7][low & 0xFF] ^ m_sliceLut[6][(low >> 8) & 0xFF] ^
+              m_sliceLut[5][(low >> 16) & 0xFF] ^ m_sliceLut[4][low >> 24] ^
+              m_sliceLut[3][high & 0xFF] ^ m_sliceLut[2][(high >> 8) & 0xFF] ^
+              m_sliceLut[1][(high >> 16) & 0xFF] ^ m_sliceLut[0][high >> 24];
+        data += 8;
+        size -= 8;
+    }
+
+    while (size--) {
+        crc = (crc >> 8) ^ m_sliceLut[0][(crc ^ (*data++)) & 0xFF];
+    }
+
+    return crc;
+}
+
+#if defined(EDC_HAVE_PCLMUL)
+// Multiply a 128-bit block by x^T modulo P, giving a value that is congruent to
+// the block moved forward T bits.  The low and high 64-bit halves are
+// multiplied by (x^(T+63) mod P) and (x^(T-1) mod P); the constants are bit
+// reversed (as the data is) and the missing power of x from the reflected
+// carry-less multiply is taken out of the exponents
+__attribute__((target("sse2,pclmul")))
+static inline __m128i foldBlock(__m128i block, __m128i constants)
+{
+    return _mm_xor_si128(_mm_clmulepi64_si128(block, constants, 0x00),
+                         _mm_clmulepi64_si128(block, constants, 0x11));
+}
+
+// Fold the data down to a single 128-bit block with the same remainder and
+// finish with the table look-up (which also applies the final x^32)
+__attribute__((target("sse2,pclmul")))
+quint32 Edc::crc32Pclmul(const uchar *data, qint32 size) const
+{
+    if (size < 64) return crc32SliceBy8(0, data, size);
+
+    // Constants are (x^(T+63) mod P, x^(T-1) mod P) for T = 512, 384, 256 and 128
+    const __m128i fold512 = _mm_set_epi64x(0x1100000100000000LL, 0x6851500100000000LL);
+    const __m128i fold384 = _mm_set_epi64x(static_cast<qint64>(0xAC51C10100000000ULL), static_cast<qint64>(0xEE54F14000000000ULL));
+    const __m128i fold256 = _mm_set_epi64x(0x5001000000000000LL, static_cast<qint64>(0xA951810000000000ULL));
+    const __m128i fold128 = _mm_set_epi64x(0x5101000100000000LL, 0x5C11C10000000000LL);
+
+    __m128i block0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+    __m128i block1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 16));
+    __m128i block2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 32));
+    __m128i block3 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 48));
+    data += 64;
+    size -= 64;
+
+    // Four blocks in parallel, 64 bytes per step
+    while (size >= 64) {
+        block0 = _mm_xor_si128(foldBlock(block0, fold512), _mm_loadu_si128(reinterpret_cast<const __m128i *>(data)));
+        block1 = _mm_xor_si128(foldBlock(block1, fold512), _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 16)));
+        block2 = _mm_xor_si128(foldBlock(block2, fold512), _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 32)));
+        block3 = _mm_xor_si128(foldBlock(block3, fold512), _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 48)));
+        data += 64;
+        size -= 64;
+    }
+
+    // Combine the four blocks into one, then fold in any remaining whole blocks
+    __m128i block = _mm_xor_si128(_mm_xor_si128(foldBlock(block0, fold384), foldBlock(block1, fold256)),
+                                  _mm_xor_si128(foldBlock(block2, fold128), block3));
+    while (size >= 16) {
+        block = _mm_xor_si128(foldBlock(block, fold128), _mm_loadu_si128(reinterpret_cast<const __m128i *>(data)));
+        data += 16;
+        size -= 16;
+    }
+
+    uchar remainder[16];
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(remainder), block);
+    return crc32SliceBy8(crc32SliceBy8(0, remainder, 16), data, size);
+}
+#else
+quint32 Edc::crc32Pclmul(const uchar *data, qint32 size) const
+{
+    return crc32SliceBy8(0, data, size);
+}
+#endif
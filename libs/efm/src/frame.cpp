@@ -265,6 +265,7 @@ F2Frame::F2Frame()
     m_frameErrorData.fill(false);
     m_framePaddedData.resize(frameSize());
     m_framePaddedData.fill(false);
+    m_qualityFlags = 0;
 }
 
 // Get the frame size for F2Frame
@@ -296,12 +297,25 @@ void F2Frame::showData()
     }
 }
 
+// Set the quality flags (see FrameQualityFlag) for the frame
+void F2Frame::setQualityFlags(quint8 qualityFlags)
+{
+    m_qualityFlags = qualityFlags;
+}
+
+// Get the quality flags for the frame
+quint8 F2Frame::qualityFlags() const
+{
+    return m_qualityFlags;
+}
+
 // Constructor for F3Frame, initializes data to the frame size
 F3Frame::F3Frame()
 {
     m_frameData.resize(frameSize());
     m_subcodeByte = 0;
     m_f3FrameType = Subcode;
+    m_qualityFlags = 0;
 }
 
 // Get the frame size for F3Frame
@@ -358,6 +372,18 @@ quint8 F3Frame::subcodeByte() const
     return m_subcodeByte;
 }
 
+// Set the quality flags (see FrameQualityFlag) for the frame
+void F3Frame::setQualityFlags(quint8 qualityFlags)
+{
+    m_qualityFlags = qualityFlags;
+}
+
+// Get the quality flags for the frame
+quint8 F3Frame::qualityFlags() const
+{
+    return m_qualityFlags;
+}
+
 void F3Frame::showData()
 {
     QString dataString;
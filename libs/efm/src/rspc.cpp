@@ -22,172 +22,222 @@
 
 ************************************************************************/
 
-#include "ezpwd/rs_base"
-#include "ezpwd/rs"
 #include "rspc.h"
 
-// ECMA-130 Q and P specific CIRC configuration for Reed-Solomon forward error correction
-template < size_t SYMBOLS, size_t PAYLOAD > struct QRS;
-template < size_t PAYLOAD > struct QRS<255, PAYLOAD>
-    : public __RS(QRS, uint8_t, 255, PAYLOAD, 0x11d, 0, 1, false);
-
-template < size_t SYMBOLS, size_t PAYLOAD > struct PRS;
-template < size_t PAYLOAD > struct PRS<255, PAYLOAD>
-    : public __RS(PRS, uint8_t, 255, PAYLOAD, 0x11d, 0, 1, false);
-
-Rspc::Rspc()
-{}
-
-void Rspc::qParityEcc(QByteArray &inputData, QByteArray &errorData, bool m_showDebug)
+// Calculations are based on ECMA-130 Annex A
+//
+// Both codes use GF(2^8) with the primitive polynomial x^8 + x^4 + x^3 + x^2 + 1
+// (0x11D) and the generator roots alpha^0 and alpha^1.  Symbol i of an n symbol
+// codeword is the coefficient of x^(n-1-i)
+Rspc::Tables::Tables()
 {
-    // Initialise the RS error corrector
-    QRS<255,255-2> qrs; // Up to 251 symbols data load with 2 symbols parity RS(45,43)
-
-    // Keep track of the number of successful corrections
-    qint32 successfulCorrections = 0;
+    // Galois field exponent and logarithm tables (the exponent table is
+    // doubled so products don't need a modulo)
+    quint32 value = 1;
+    for (qint32 i = 0; i < 255; i++) {
+        exp[i] = static_cast<quint8>(value);
+        exp[i + 255] = static_cast<quint8>(value);
+        log[value] = static_cast<quint8>(i);
+        value <<= 1;
+        if (value & 0x100) value ^= 0x11D;
+    }
+    exp[510] = exp[0];
+    exp[511] = exp[1];
+    log[0] = 0;
 
     // RS code is Q(45,43)
     // There are 104 bytes of Q-Parity (52 code words)
     // Each Q field covers 12 to 2248 = 2236 bytes (2 * 1118)
     // 2236 / 43 = 52 Q-parity words (= 104 Q-parity bytes)
+    // Note: Q-Parity data starts at 12 + 2236
     //
-    // Calculations are based on ECMA-130 Annex A
-
-    uchar* uF1Data = reinterpret_cast<uchar*>(inputData.data());
-    uchar* uF1Erasures = reinterpret_cast<uchar*>(errorData.data());
-
-    // Ignore the 12 sync bytes
-    uF1Data += 12;
-    uF1Erasures += 12;
-
-    // Store the data and erasures in the form expected by the ezpwd library
-    std::vector<uchar> qField;
-    std::vector<int> qFieldErasures;
-    qField.resize(45); // 43 + 2 parity bytes = 45
-
     // evenOdd = 0 = LSBs / evenOdd = 1 = MSBs
     for (qint32 evenOdd = 0; evenOdd < 2; evenOdd++) {
         for (qint32 Nq = 0; Nq < 26; Nq++) {
-            qFieldErasures.clear();
+            quint16 *index = qIndex[evenOdd * 26 + Nq];
             for (qint32 Mq = 0; Mq < 43; Mq++) {
-                // Get 43 byte codeword location
-                qint32 Vq = 2 * ((44 * Mq + 43 * Nq) % 1118) + evenOdd;
-                qField[static_cast<size_t>(Mq)] = uF1Data[Vq];
-
-                // Get codeword erasures if present
-                if (uF1Erasures[Vq] == 1) qFieldErasures.push_back(Mq);
+                index[Mq] = static_cast<quint16>(12 + 2 * ((44 * Mq + 43 * Nq) % 1118) + evenOdd);
             }
-            // Get 2 byte parity location
-            qint32 qParityByte0 = 2 * ((43 * 26 + Nq) % 1118) + evenOdd;
-            qint32 qParityByte1 = 2 * ((44 * 26 + Nq) % 1118) + evenOdd;
-
-            // Note: Q-Parity data starts at 12 + 2236
-            qField[43] = uF1Data[qParityByte0 + 2236];
-            qField[44] = uF1Data[qParityByte1 + 2236];
-
-            // Perform RS decode/correction
-            if (qFieldErasures.size() > 2) qFieldErasures.clear();
-            std::vector<int> position;
-            int fixed = -1;
-            fixed = qrs.decode(qField, qFieldErasures, &position);
-
-            // If correction was successful add to success counter
-            // and copy back the corrected data
-            if (fixed >= 0) {
-                successfulCorrections++;
-
-                // Here we use the calculation in reverse to put the corrected
-                // data back into it's original position
-                for (qint32 Mq = 0; Mq < 43; Mq++) {
-                    qint32 Vq = 2 * ((44 * Mq + 43 * Nq) % 1118) + evenOdd;
-                    uF1Data[Vq] = qField[static_cast<size_t>(Mq)];
-                }
+            index[43] = static_cast<quint16>(12 + 2236 + 2 * ((43 * 26 + Nq) % 1118) + evenOdd);
+            index[44] = static_cast<quint16>(12 + 2236 + 2 * ((44 * 26 + Nq) % 1118) + evenOdd);
+        }
+    }
+
+    // RS code is P(26,24)
+    // There are 172 bytes of P-Parity (86 code words)
+    // Each P field covers 12 to 2076 = 2064 bytes (2 * 1032)
+    // 2064 / 24 = 86 P-parity words (= 172 P-parity bytes)
+    for (qint32 evenOdd = 0; evenOdd < 2; evenOdd++) {
+        for (qint32 Np = 0; Np < 43; Np++) {
+            quint16 *index = pIndex[evenOdd * 43 + Np];
+            for (qint32 Mp = 0; Mp < 26; Mp++) {
+                index[Mp] = static_cast<quint16>(12 + 2 * (43 * Mp + Np) + evenOdd);
             }
         }
     }
+}
 
-    // Reset the pointers
-    uF1Data -= 12;
-    uF1Erasures -= 12;
+// The tables are built once and shared by all instances
+const Rspc::Tables &Rspc::tables()
+{
+    static const Tables sharedTables;
+    return sharedTables;
+}
+
+Rspc::Rspc()
+    : m_tables(tables())
+{}
+
+// Single pass of Q parity correction
+void Rspc::qParityEcc(QByteArray &inputData, QByteArray &errorData, bool m_showDebug)
+{
+    qint32 correctedSymbols = 0;
+    const qint32 successfulCorrections = qPass(reinterpret_cast<uchar*>(inputData.data()),
+        reinterpret_cast<uchar*>(errorData.data()), correctedSymbols);
 
     // Show Q-Parity correction result to debug
-    if (successfulCorrections >= 52) {
-        //if (m_showDebug) qDebug() << "Rspc::qParityEcc(): Q-Parity correction successful with" << successfulCorrections << "corrected codewords";
-    } else {
+    if (successfulCorrections < QCodewords) {
         if (m_showDebug) qDebug() << "Rspc::qParityEcc(): Q-Parity correction failed! Got" << successfulCorrections << "correct out of 52 possible codewords";
     }
 }
 
+// Single pass of P parity correction
 void Rspc::pParityEcc(QByteArray &inputData, QByteArray &errorData, bool m_showDebug)
 {
-    // Initialise the RS error corrector
-    PRS<255,255-2> prs; // Up to 251 symbols data load with 2 symbols parity RS(26,24)
-
-    // Keep track of the number of successful corrections
-    qint32 successfulCorrections = 0;
-
-    uchar* uF1Data = reinterpret_cast<uchar*>(inputData.data());
-    uchar* uF1Erasures = reinterpret_cast<uchar*>(errorData.data());
-
-    // RS code is P(26,24)
-    // There are 172 bytes of P-Parity (86 code words)
-    // Each P field covers 12 to 2076 = 2064 bytes (2 * 1032)
-    // 2064 / 24 = 86 P-parity words (= 172 P-parity bytes)
-    //
-    // Calculations are based on ECMA-130 Annex A
-
-    // Ignore the 12 sync bytes
-    uF1Data += 12;
-    uF1Erasures += 12;
+    qint32 correctedSymbols = 0;
+    const qint32 successfulCorrections = pPass(reinterpret_cast<uchar*>(inputData.data()),
+        reinterpret_cast<uchar*>(errorData.data()), correctedSymbols);
 
-    // Store the data and erasures in the form expected by the ezpwd library
-    std::vector<uchar> pField;
-    std::vector<int> pFieldErasures;
-    pField.resize(26); // 24 + 2 parity bytes = 26
+    // Show P-Parity correction result to debug
+    if (successfulCorrections < PCodewords) {
+        if (m_showDebug) qDebug() << "Rspc::pParityEcc(): P-Parity correction failed! Got" << successfulCorrections << "correct out of 86 possible codewords";
+    }
+}
 
-    // evenOdd = 0 = LSBs / evenOdd = 1 = MSBs
-    for (qint32 evenOdd = 0; evenOdd < 2; evenOdd++) {
-        for (qint32 Np = 0; Np < 43; Np++) {
-            pFieldErasures.clear();
-            for (qint32 Mp = 0; Mp < 26; Mp++) {
-                // Get 24 byte codeword location + 2 P-parity bytes
-                qint32 Vp = 2 * (43 * Mp + Np) + evenOdd;
-                pField[static_cast<size_t>(Mp)] = uF1Data[Vp];
+// Alternate Q and P passes (as CD-ROM drives do) until every codeword is
+// correct, a pass corrects nothing or maxPasses Q+P passes have been made.
+// Each pass clears the erasure flags of the codewords it corrects, so a
+// codeword with too many erasures for one code can become correctable once
+// the other code has repaired some of its symbols.  Returns the number of
+// passes made
+qint32 Rspc::iterativeEcc(QByteArray &inputData, QByteArray &errorData, qint32 maxPasses, bool m_showDebug)
+{
+    return iterativeEcc(reinterpret_cast<uchar*>(inputData.data()), reinterpret_cast<uchar*>(errorData.data()),
+        maxPasses, m_showDebug);
+}
 
-                // Get codeword erasures if present
-                if (uF1Erasures[Vp] == 1) pFieldErasures.push_back(Mp);
-            }
+qint32 Rspc::iterativeEcc(uchar *data, uchar *erasures, qint32 maxPasses, bool m_showDebug)
+{
+    qint32 pass = 0;
+    qint32 qSuccessful = 0;
+    qint32 pSuccessful = 0;
+    while (pass < maxPasses) {
+        pass++;
+        qint32 correctedSymbols = 0;
+        qSuccessful = qPass(data, erasures, correctedSymbols);
+        pSuccessful = pPass(data, erasures, correctedSymbols);
+
+        if (qSuccessful == QCodewords && pSuccessful == PCodewords) break;
+        if (correctedSymbols == 0) break;
+    }
 
-            // Perform RS decode/correction
-            if (pFieldErasures.size() > 2) pFieldErasures.clear();
-            std::vector<int> position;
-            int fixed = -1;
+    if (m_showDebug && (qSuccessful < QCodewords || pSuccessful < PCodewords)) {
+        qDebug() << "Rspc::iterativeEcc(): Correction incomplete after" << pass << "passes. Got" << qSuccessful
+                 << "of 52 Q-Parity and" << pSuccessful << "of 86 P-Parity codewords correct";
+    } else if (m_showDebug && pass > 1) {
+        qDebug() << "Rspc::iterativeEcc(): Correction complete after" << pass << "passes";
+    }
 
-            fixed = prs.decode(pField, pFieldErasures, &position);
+    return pass;
+}
 
-            // If correction was successful add to success counter
-            // and copy back the corrected data
-            if (fixed >= 0) {
-                successfulCorrections++;
+// Decode all of the Q codewords, returning the number of codewords that
+// are correct after decoding
+qint32 Rspc::qPass(uchar *data, uchar *erasures, qint32 &correctedSymbols) const
+{
+    qint32 successfulCorrections = 0;
+    for (qint32 codeword = 0; codeword < QCodewords; codeword++) {
+        const qint32 fixed = decodeCodeword(data, erasures, m_tables.qIndex[codeword], QLength);
+        if (fixed >= 0) {
+            successfulCorrections++;
+            correctedSymbols += fixed;
+        }
+    }
+    return successfulCorrections;
+}
 
-                // Here we use the calculation in reverse to put the corrected
-                // data back into it's original position
-                for (qint32 Mp = 0; Mp < 24; Mp++) {
-                    qint32 Vp = 2 * (43 * Mp + Np) + evenOdd;
-                    uF1Data[Vp] = pField[static_cast<size_t>(Mp)];
-                }
-            }
+// Decode all of the P codewords, returning the number of codewords that
+// are correct after decoding
+qint32 Rspc::pPass(uchar *data, uchar *erasures, qint32 &correctedSymbols) const
+{
+    qint32 successfulCorrections = 0;
+    for (qint32 codeword = 0; codeword < PCodewords; codeword++) {
+        const qint32 fixed = decodeCodeword(data, erasures, m_tables.pIndex[codeword], PLength);
+        if (fixed >= 0) {
+            successfulCorrections++;
+            correctedSymbols += fixed;
         }
     }
+    return successfulCorrections;
+}
 
-    // Reset the pointers
-    uF1Data -= 12;
-    uF1Erasures -= 12;
+// Decode a codeword in place, using the erasure flags if there are no more
+// than two (more than that can't be corrected with two parity symbols, so
+// they are ignored and a single error is searched for instead).  On success
+// the erasure flags of the codeword are cleared and the number of corrected
+// symbols is returned, otherwise -1 is returned and nothing is changed
+qint32 Rspc::decodeCodeword(uchar *data, uchar *erasures, const quint16 *index, qint32 length) const
+{
+    const quint8 *exp = m_tables.exp;
+    const quint8 *log = m_tables.log;
+
+    // Syndromes S0 = c(alpha^0) and S1 = c(alpha^1) (by Horner's method)
+    quint32 s0 = 0;
+    quint32 s1 = 0;
+    qint32 erasurePosition[2];
+    qint32 erasureCount = 0;
+    for (qint32 i = 0; i < length; i++) {
+        const quint32 symbol = data[index[i]];
+        s0 ^= symbol;
+        s1 = ((s1 << 1) ^ ((s1 & 0x80) ? 0x11D : 0)) ^ symbol;
+        if (erasures[index[i]] == 1) {
+            if (erasureCount < 2) erasurePosition[erasureCount] = i;
+            erasureCount++;
+        }
+    }
+    if (erasureCount > 2) erasureCount = 0;
+
+    qint32 fixed = 0;
+    if (s0 != 0 || s1 != 0) {
+        if (erasureCount == 2) {
+            // Two erasures with locators X1 and X2:
+            // e1 + e2 = S0, e1.X1 + e2.X2 = S1
+            const qint32 x1 = length - 1 - erasurePosition[0];
+            const qint32 x2 = length - 1 - erasurePosition[1];
+            const quint32 s0x1 = s0 ? exp[log[s0] + x1] : 0;
+            const quint32 numerator = s1 ^ s0x1;
+            const quint32 e2 = numerator ? exp[log[numerator] + 255 - log[exp[x1] ^ exp[x2]]] : 0;
+            const quint32 e1 = s0 ^ e2;
+            data[index[erasurePosition[0]]] ^= static_cast<uchar>(e1);
+            data[index[erasurePosition[1]]] ^= static_cast<uchar>(e2);
+            fixed = (e1 != 0) + (e2 != 0);
+        } else {
+            // A single error (or erasure) with locator X and value e:
+            // S0 = e, S1 = e.X
+            if (s0 == 0 || s1 == 0) return -1;
+            const qint32 x = (log[s1] + 255 - log[s0]) % 255;
+            if (x >= length) return -1;
+            const qint32 position = length - 1 - x;
+            if (erasureCount == 1 && position != erasurePosition[0]) return -1;
+            data[index[position]] ^= static_cast<uchar>(s0);
+            fixed = 1;
+        }
+    }
 
-    // Show P-Parity correction result to debug
-    if (successfulCorrections >= 86) {
-        //if (m_showDebug) qDebug() << "Rspc::pParityEcc(): P-Parity correction successful with" << successfulCorrections << "corrected codewords";
-    } else {
-        if (m_showDebug) qDebug() << "Rspc::pParityEcc(): P-Parity correction failed! Got" << successfulCorrections << "correct out of 86 possible codewords";
+    // The codeword is now correct
+    for (qint32 i = 0; i < length; i++) {
+        erasures[index[i]] = 0;
     }
-}
\ No newline at end of file
+
+    return fixed;
+}
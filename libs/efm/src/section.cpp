@@ -24,6 +24,11 @@
 
 #include "section.h"
 
+#include <QtEndian>
+#include <cstring>
+
+static const char s_f2SectionFileMagic[8] = { 'E', 'F', 'M', 'F', '2', 'S', 'E', 'C' };
+
 F2Section::F2Section()
 {
     m_frames.reserve(98);
@@ -247,6 +252,41 @@ QDataStream& operator>>(QDataStream& stream, F2Section& section)
     return stream;
 }
 
+// F2 section file class
+// ---------------------------------------------------------------------------------------------------
+void F2SectionFile::encodeHeader(quint8 *header)
+{
+    std::memcpy(header, s_f2SectionFileMagic, 8);
+    qToLittleEndian<quint32>(Version, header + 8);
+    qToLittleEndian<quint32>(0, header + 12);
+}
+
+// Returns the version from the header, 1 if there is no header (the original
+// unversioned format) or -1 if the header is incomplete.  size is the number
+// of bytes available at header
+qint32 F2SectionFile::headerVersion(const quint8 *header, qint64 size)
+{
+    if (size < 8 || std::memcmp(header, s_f2SectionFileMagic, 8) != 0) return 1;
+    if (size < HeaderSize) return -1;
+    return static_cast<qint32>(qFromLittleEndian<quint32>(header + 8));
+}
+
+void F2SectionFile::writeQualityFlags(QDataStream &stream, const F2Section &section)
+{
+    for (const auto& frame : section.m_frames) {
+        stream << frame.qualityFlags();
+    }
+}
+
+void F2SectionFile::readQualityFlags(QDataStream &stream, F2Section &section)
+{
+    for (qint32 i = 0; i < section.m_frames.size(); ++i) {
+        quint8 qualityFlags;
+        stream >> qualityFlags;
+        section.m_frames[i].setQualityFlags(qualityFlags);
+    }
+}
+
 QDataStream& operator<<(QDataStream& stream, const Data24Section& section)
 {
     // Write metadata
@@ -24,6 +24,8 @@
 
 #include "sector.h"
 
+#include <cstring>
+
 // Sector address class
 // ---------------------------------------------------------------------------------------------------
 SectorAddress::SectorAddress() : m_address(0)
@@ -89,6 +91,15 @@ QString SectorAddress::toString() const
             .arg(m_address % 75, 2, 10, QChar('0'));
 }
 
+// Write the address as three BCD bytes (minutes, seconds and frames) as used
+// in the sector header
+void SectorAddress::toBcd(quint8 *bcd) const
+{
+    bcd[0] = intToBcd(minutes());
+    bcd[1] = intToBcd(seconds());
+    bcd[2] = intToBcd(frameNumber());
+}
+
 quint8 SectorAddress::intToBcd(quint32 value)
 {
     if (value > 99) {
@@ -111,43 +122,34 @@ quint8 SectorAddress::intToBcd(quint32 value)
 // Raw sector class
 // The raw sector is 2352 bytes (unscrambled) and contains user data and error correction data
 RawSector::RawSector()
-    : m_data(QByteArray(2352, 0)),
-      m_errorData(QByteArray(2352, 0))
-{}
-
-void RawSector::pushData(const QByteArray &inData)
 {
-    m_data = inData;
+    std::memset(m_data, 0, sizeof(m_data));
+    std::memset(m_errorData, 0, sizeof(m_errorData));
+    std::memset(m_paddedData, 0, sizeof(m_paddedData));
 }
 
-void RawSector::pushErrorData(const QByteArray &inData)
+// Copy data into the sector storage (anything beyond the sector size is ignored
+// and anything missing is zero filled)
+static void copyToStorage(quint8 *storage, qint32 size, const QByteArray &inData)
 {
-    m_errorData = inData;
+    const qint32 length = qMin(size, static_cast<qint32>(inData.size()));
+    std::memcpy(storage, inData.constData(), length);
+    std::memset(storage + length, 0, size - length);
 }
 
-void RawSector::pushPaddedData(const QByteArray &inData)
-{
-    m_paddedData = inData;
-}
-
-QByteArray RawSector::data() const
-{
-    return m_data;
-}
-
-QByteArray RawSector::errorData() const
+void RawSector::pushData(const QByteArray &inData)
 {
-    return m_errorData;
+    copyToStorage(m_data, Size, inData);
 }
 
-QByteArray RawSector::paddedData() const
+void RawSector::pushErrorData(const QByteArray &inData)
 {
-    return m_paddedData;
+    copyToStorage(m_errorData, Size, inData);
 }
 
-quint32 RawSector::size() const
+void RawSector::pushPaddedData(const QByteArray &inData)
 {
-    return m_data.size();
+    copyToStorage(m_paddedData, Size, inData);
 }
 
 void RawSector::showData()
@@ -156,19 +158,19 @@ void RawSector::showData()
     bool hasError = false;
 
     // Extract the sector address data (note: this is not verified as correct)
-    qint32 min = bcdToInt(m_data.data()[12]);
-    qint32 sec = bcdToInt(m_data.data()[13]);
-    qint32 frame = bcdToInt(m_data.data()[14]);
+    qint32 min = bcdToInt(m_data[12]);
+    qint32 sec = bcdToInt(m_data[13]);
+    qint32 frame = bcdToInt(m_data[14]);
     SectorAddress address(min, sec, frame);
 
-    for (int offset = 0; offset < m_data.size(); offset += bytesPerLine) {
+    for (int offset = 0; offset < Size; offset += bytesPerLine) {
         // Print offset
         QString line;
         line = "RawSector::showData() - [" + address.toString() + "] ";
         line += QString("%1: ").arg(offset, 6, 16, QChar('0'));
         
         // Print hex values
-        for (int i = 0; i < bytesPerLine && (offset + i) < m_data.size(); ++i) {
+        for (int i = 0; i < bytesPerLine && (offset + i) < Size; ++i) {
             if (static_cast<quint8>(m_errorData[offset + i]) == 0) {
                 line.append(QString("%1 ").arg(static_cast<quint8>(m_data[offset + i]), 2, 16, QChar('0')));
             } else {
@@ -191,45 +193,49 @@ quint8 RawSector::bcdToInt(quint8 bcd)
 }
 
 // Sector class
-// The sector is 2048 bytes and contains user data only (post error correction)
 Sector::Sector()
-    : m_data(QByteArray(2048, 0)),
-      m_errorData(QByteArray(2048, 0))
-{}
+    : m_mode(-1),
+      m_form(0),
+      m_validData(false)
+{
+    std::memset(m_data, 0, sizeof(m_data));
+    std::memset(m_errorData, 0, sizeof(m_errorData));
+    std::memset(m_paddedData, 0, sizeof(m_paddedData));
+}
 
+// Note: the user data position depends on the mode and form, so these should
+// be set before pushing data
 void Sector::pushData(const QByteArray &inData)
 {
-    m_data = inData;
+    copyToStorage(data(), size(), inData);
 }
 
 void Sector::pushErrorData(const QByteArray &inData)
 {
-    m_errorData = inData;
+    copyToStorage(errorData(), size(), inData);
 }
 
 void Sector::pushPaddedData(const QByteArray &inData)
 {
-    m_paddedData = inData;
-}
-
-QByteArray Sector::data() const
-{
-    return m_data;
-}
-
-QByteArray Sector::errorData() const
-{
-    return m_errorData;
+    copyToStorage(paddedData(), size(), inData);
 }
 
-QByteArray Sector::paddedData() const
+// Copy the whole raw sector (data, error and padding flags)
+void Sector::pushRawSector(const RawSector &rawSector)
 {
-    return m_paddedData;
+    std::memcpy(m_data, rawSector.data(), RawSize);
+    std::memcpy(m_errorData, rawSector.errorData(), RawSize);
+    std::memcpy(m_paddedData, rawSector.paddedData(), RawSize);
 }
 
+// Returns the size of the user data in bytes
 quint32 Sector::size() const
 {
-    return m_data.size();
+    if (m_mode == 2) {
+        if (m_form == 2) return 2324;
+        if (m_form == 0) return 2336;
+    }
+    return Size;
 }
 
 void Sector::showData()
@@ -237,16 +243,16 @@ void Sector::showData()
     const int bytesPerLine = 2048/64;
     bool hasError = false;
 
-    for (int offset = 0; offset < m_data.size(); offset += bytesPerLine) {
+    for (int offset = 0; offset < static_cast<qint32>(size()); offset += bytesPerLine) {
         // Print offset
         QString line;
         line = "Sector::showData() - [" + m_address.toString() + "] ";
         line += QString("%1: ").arg(offset, 6, 16, QChar('0'));
         
         // Print hex values
-        for (int i = 0; i < bytesPerLine && (offset + i) < m_data.size(); ++i) {
-            if (static_cast<quint8>(m_errorData[offset + i]) == 0) {
-                line.append(QString("%1 ").arg(static_cast<quint8>(m_data[offset + i]), 2, 16, QChar('0')));
+        for (int i = 0; i < bytesPerLine && (offset + i) < static_cast<qint32>(size()); ++i) {
+            if (static_cast<quint8>(errorData()[offset + i]) == 0) {
+                line.append(QString("%1 ").arg(static_cast<quint8>(data()[offset + i]), 2, 16, QChar('0')));
             } else {
                 line.append("XX ");
                 hasError = true;
@@ -287,4 +293,16 @@ void Sector::setMode(qint32 mode)
 qint32 Sector::mode() const
 {
     return m_mode;
+}
+
+void Sector::setForm(qint32 form)
+{
+    // 0 is no XA subheader (or not Mode 2)
+    // 1 is Mode 2 Form 1
+    // 2 is Mode 2 Form 2
+
+    if (form < 0 || form > 2) {
+        qFatal("Sector::setForm(): Invalid form value of %d", form);
+    }
+    m_form = form;
 }
\ No newline at end of file
@@ -0,0 +1,110 @@
+/************************************************************************
+
+    sector_map.cpp
+
+    EFM-library - Binary sector map (status and error bitmap) format
+    Copyright (C) 2025 Simon Inns
+
+    This file is part of EFM-Tools.
+
+    This is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+************************************************************************/
+
+#include "sector_map.h"
+
+#include <QtEndian>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+static const char s_magic[8] = { 'E', 'F', 'M', 'S', 'M', 'A', 'P', '\0' };
+
+void SectorMap::encodeHeader(quint8 *header)
+{
+    std::memcpy(header, s_magic, 8);
+    qToLittleEndian<quint32>(Version, header + 8);
+    qToLittleEndian<quint32>(RecordSize, header + 12);
+    qToLittleEndian<quint32>(BitmapSize, header + 16);
+    qToLittleEndian<quint32>(0, header + 20);
+}
+
+// Check the header of a sector map (size is the size of the whole file)
+bool SectorMap::isValidHeader(const quint8 *header, qint64 size)
+{
+    if (size < HeaderSize) return false;
+    if (std::memcmp(header, s_magic, 8) != 0) return false;
+    if (qFromLittleEndian<quint32>(header + 8) != Version) return false;
+    if (qFromLittleEndian<quint32>(header + 12) != RecordSize) return false;
+    if (qFromLittleEndian<quint32>(header + 16) != BitmapSize) return false;
+    return (size - HeaderSize) % RecordSize == 0;
+}
+
+void SectorMap::encodeRecord(const Sector &sector, quint8 *record)
+{
+    encodeRecord(sector.address().address(), sector.isDataValid() ? (Present | Valid) : Present,
+        sector.mode(), sector.form(), sector.rawErrorData(), record);
+}
+
+// errorData is one flag byte per raw sector byte
+void SectorMap::encodeRecord(qint32 address, quint8 status, qint32 mode, qint32 form,
+    const quint8 *errorData, quint8 *record)
+{
+    std::memset(record, 0, RecordSize);
+
+    qToLittleEndian<qint32>(address, record);
+    record[4] = status;
+    record[5] = static_cast<quint8>(static_cast<qint8>(mode));
+    record[6] = static_cast<quint8>(form);
+
+    // Pack the error flags into the bitmap
+    quint8 *bitmap = record + 8;
+#if defined(__SSE2__)
+    // 16 flags at a time (2352 is a multiple of 16)
+    const __m128i zero = _mm_setzero_si128();
+    for (qint32 i = 0; i < RawSector::Size; i += 16) {
+        const __m128i flags = _mm_loadu_si128(reinterpret_cast<const __m128i *>(errorData + i));
+        const quint32 mask = ~static_cast<quint32>(_mm_movemask_epi8(_mm_cmpeq_epi8(flags, zero))) & 0xFFFF;
+        bitmap[i / 8] = static_cast<quint8>(mask);
+        bitmap[i / 8 + 1] = static_cast<quint8>(mask >> 8);
+    }
+#else
+    for (qint32 i = 0; i < BitmapSize; i++) {
+        quint8 bits = 0;
+        for (qint32 bit = 0; bit < 8; bit++) {
+            if (errorData[i * 8 + bit]) bits |= 1 << bit;
+        }
+        bitmap[i] = bits;
+    }
+#endif
+}
+
+// Unpack a record's error bitmap to one flag byte (0 or 1) per raw sector byte
+void SectorMap::decodeBitmap(const quint8 *record, quint8 *errorData)
+{
+    const quint8 *bitmap = record + 8;
+    for (qint32 i = 0; i < BitmapSize; i++) {
+        const quint8 bits = bitmap[i];
+        for (qint32 bit = 0; bit < 8; bit++) {
+            errorData[i * 8 + bit] = (bits >> bit) & 1;
+        }
+    }
+}
+
+qint32 SectorMap::recordAddress(const quint8 *record)
+{
+    return qFromLittleEndian<qint32>(record);
+}
@@ -0,0 +1,200 @@
+/************************************************************************
+
+    sector_verifier.cpp
+
+    EFM-library - ECMA-130 sector EDC checking and Q/P correction
+    Copyright (C) 2025 Simon Inns
+
+    This file is part of EFM-Tools.
+
+    This is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+************************************************************************/
+
+#include "sector_verifier.h"
+#include "sector.h"
+
+#include <QtEndian>
+#include <cstring>
+
+SectorVerifier::SectorVerifier()
+{}
+
+// Returns the form given by the XA subheader's submode byte, 0 if the sector
+// has no XA subheader (the two copies are valid but differ) or -1 if neither
+// copy of the subheader is free of errors
+qint32 SectorVerifier::subheaderForm(const quint8 *data, const quint8 *errorData)
+{
+    static const quint8 noErrors[4] = { 0, 0, 0, 0 };
+    const bool firstValid = std::memcmp(errorData + 16, noErrors, 4) == 0;
+    const bool secondValid = std::memcmp(errorData + 20, noErrors, 4) == 0;
+
+    const quint8 *subheader = nullptr;
+    if (firstValid && secondValid) {
+        if (std::memcmp(data + 16, data + 20, 4) != 0) return 0;
+        subheader = data + 16;
+    } else if (firstValid) {
+        subheader = data + 16;
+    } else if (secondValid) {
+        subheader = data + 20;
+    } else {
+        return -1;
+    }
+
+    // Submode bit 5 selects Form 2
+    return (subheader[2] & 0x20) ? 2 : 1;
+}
+
+// Check the EDC of a Mode 1 (form 0) or Mode 2 Form 1/2 sector.  A Form 2 EDC
+// of zero means the EDC isn't used
+bool SectorVerifier::edcValid(const quint8 *data, qint32 form) const
+{
+    switch (form) {
+        case 1:
+            return m_edc.crc32(data + 16, 2056) == qFromLittleEndian<quint32>(data + 2072);
+        case 2: {
+            const quint32 edcWord = qFromLittleEndian<quint32>(data + 2348);
+            return edcWord == 0 || m_edc.crc32(data + 16, 2332) == edcWord;
+        }
+        default:
+            return m_edc.crc32(data, 2064) == qFromLittleEndian<quint32>(data + 2064);
+    }
+}
+
+// Q and P parity error correction of a Mode 1 or Mode 2 Form 1 sector.  For
+// Mode 2 the parity is calculated with the header bytes (12 to 15) set to
+// zero, so the header is cleared during correction and then restored
+void SectorVerifier::correct(quint8 *data, quint8 *errorData, qint32 mode, bool showDebug)
+{
+    quint8 header[4];
+    quint8 headerErrors[4];
+    if (mode == 2) {
+        std::memcpy(header, data + 12, 4);
+        std::memcpy(headerErrors, errorData + 12, 4);
+        std::memset(data + 12, 0, 4);
+        std::memset(errorData + 12, 0, 4);
+    }
+
+    // Alternate Q and P parity correction (in place) until it stops making
+    // progress (up to 8 passes)
+    m_rspc.iterativeEcc(data, errorData, 8, showDebug);
+
+    if (mode == 2) {
+        std::memcpy(data + 12, header, 4);
+        std::memcpy(errorData + 12, headerErrors, 4);
+    }
+}
+
+// Check (and if necessary correct) a sector, using the mode byte to decide how
+// to check it.  If the mode byte is in error the sector is tried as Mode 1 and
+// then Mode 2.  Mode 0 and Mode 2 sectors without an XA subheader have no EDC
+// so they are only valid if no bytes are in error.  Returns true if the sector
+// is valid, mode and form are set to the sector's mode and form
+bool SectorVerifier::verify(quint8 *data, quint8 *errorData, qint32 &mode, qint32 &form,
+    bool &corrected, bool showDebug)
+{
+    corrected = false;
+    form = 0;
+    mode = errorData[15] ? -1 : data[15];
+
+    if (mode == 0) return !hasErrors(errorData, RawSector::Size);
+    if (mode == 1) return verifyMode1(data, errorData, corrected, showDebug);
+    if (mode == 2) return verifyMode2(data, errorData, form, corrected, showDebug);
+
+    // Unknown mode - try Mode 1 then Mode 2 (on the original data)
+    quint8 originalData[RawSector::Size];
+    quint8 originalErrorData[RawSector::Size];
+    std::memcpy(originalData, data, RawSector::Size);
+    std::memcpy(originalErrorData, errorData, RawSector::Size);
+
+    if (verifyMode1(data, errorData, corrected, showDebug) && data[15] == 1) {
+        mode = 1;
+        return true;
+    }
+
+    std::memcpy(data, originalData, RawSector::Size);
+    std::memcpy(errorData, originalErrorData, RawSector::Size);
+    if (subheaderForm(data, errorData) > 0 && verifyMode2(data, errorData, form, corrected, showDebug)) {
+        // The mode byte isn't protected in Mode 2, so set it
+        data[15] = 2;
+        errorData[15] = 0;
+        mode = 2;
+        return true;
+    }
+
+    std::memcpy(data, originalData, RawSector::Size);
+    std::memcpy(errorData, originalErrorData, RawSector::Size);
+    return false;
+}
+
+bool SectorVerifier::verifyMode1(quint8 *data, quint8 *errorData, bool &corrected, bool showDebug)
+{
+    if (edcValid(data, 0)) return true;
+
+    correct(data, errorData, 1, showDebug);
+    corrected = edcValid(data, 0);
+    return corrected;
+}
+
+// Check (and if necessary correct) a Mode 2 sector.  The EDCs are tried
+// first, as they also give the form when the subheader is in error or its two
+// copies differ.  A Form 2 EDC of zero means the EDC is unused, so it only
+// counts if the subheader says Form 2 and no bytes are in error.  Otherwise the sector is taken as having no XA
+// subheader, which has no EDC so it is only valid if no bytes are in error.
+// If the sector is invalid the data and error flags are left unchanged
+bool SectorVerifier::verifyMode2(quint8 *data, quint8 *errorData, qint32 &form, bool &corrected, bool showDebug)
+{
+    corrected = false;
+    const qint32 subheader = subheaderForm(data, errorData);
+    form = subheader;
+
+    if (subheader != 2 && edcValid(data, 1)) {
+        form = 1;
+        return true;
+    }
+    if (subheader != 1 && edcValid(data, 2)) {
+        const bool edcUsed = qFromLittleEndian<quint32>(data + 2348) != 0;
+        if (edcUsed || (subheader == 2 && !hasErrors(errorData + 16, RawSector::Size - 16))) {
+            form = 2;
+            return true;
+        }
+    }
+    if (subheader == 0 && !hasErrors(errorData + 16, RawSector::Size - 16)) return true;
+    if (subheader == 2) return false;
+
+    // Form 1 (or unknown) - attempt Q and P parity error correction (Form 2 has no parity)
+    quint8 originalData[RawSector::Size];
+    quint8 originalErrorData[RawSector::Size];
+    std::memcpy(originalData, data, RawSector::Size);
+    std::memcpy(originalErrorData, errorData, RawSector::Size);
+
+    correct(data, errorData, 2, showDebug);
+    if (edcValid(data, 1) && subheaderForm(data, errorData) == 1) {
+        form = 1;
+        corrected = true;
+        return true;
+    }
+
+    std::memcpy(data, originalData, RawSector::Size);
+    std::memcpy(errorData, originalErrorData, RawSector::Size);
+    return false;
+}
+
+bool SectorVerifier::hasErrors(const quint8 *errorData, qint32 size)
+{
+    for (qint32 i = 0; i < size; i++) {
+        if (errorData[i]) return true;
+    }
+    return false;
+}
@@ -0,0 +1,233 @@
+/************************************************************************
+
+    audio_concealment_kernel.cpp
+
+    efm-decoder-audio - EFM Data24 to Audio decoder
+    Copyright (C) 2025 Simon Inns
+
+    This file is part of ld-decode-tools.
+
+    This application is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+************************************************************************/
+
+#include "audio_concealment_kernel.h"
+
+#include <QtAlgorithms>
+#include <cstring>
+
+AudioConcealmentKernel::AudioConcealmentKernel() :
+    m_maxRunLength(0)
+{
+    std::memset(m_samples, 0, sizeof(m_samples));
+    std::memset(m_errors, 0, sizeof(m_errors));
+    std::memset(m_originalErrors, 0, sizeof(m_originalErrors));
+    std::memset(m_concealed, 0, sizeof(m_concealed));
+
+    // Lagrange weights for a cubic through the valid samples at positions
+    // -2, -1, L and L+1 (in samples of one channel) evaluated at each of the
+    // run positions 0 to L-1
+    std::memset(m_cubicWeights, 0, sizeof(m_cubicWeights));
+    for (qint32 length = 1; length <= MaxRunLimit; ++length) {
+        const double nodes[4] = { -2.0, -1.0, static_cast<double>(length), static_cast<double>(length + 1) };
+        for (qint32 position = 0; position < length; ++position) {
+            for (qint32 n = 0; n < 4; ++n) {
+                double weight = 1.0;
+                for (qint32 m = 0; m < 4; ++m) {
+                    if (m != n) weight *= (position - nodes[m]) / (nodes[n] - nodes[m]);
+                }
+                m_cubicWeights[length][n][position] = static_cast<float>(weight);
+            }
+        }
+    }
+}
+
+void AudioConcealmentKernel::setMaxRunLength(qint32 maxRunLength)
+{
+    if (maxRunLength < 0 || maxRunLength > MaxRunLimit) {
+        qFatal("AudioConcealmentKernel::setMaxRunLength(): Run length of %d is out of range", maxRunLength);
+    }
+    m_maxRunLength = maxRunLength;
+}
+
+// Load the 12 interleaved samples of a frame (or halo frame) into the section buffer
+void AudioConcealmentKernel::loadFrame(qint32 frameIndex, const qint16 *samples, const bool *errors)
+{
+    const qint32 first = Halo + frameIndex * FrameSamples;
+    std::memcpy(m_samples + first, samples, FrameSamples * sizeof(qint16));
+    for (qint32 i = 0; i < FrameSamples; ++i) {
+        setBit(m_errors, first + i, errors[i]);
+        setBit(m_concealed, first + i, false);
+    }
+}
+
+// Returns true if any sample in the section (excluding the halo) is in error
+bool AudioConcealmentKernel::hasErrors() const
+{
+    for (qint32 bit = Halo; bit < Halo + SectionSamples; bit += 32) {
+        if (maskBits(m_errors, bit, qMin(32, Halo + SectionSamples - bit))) return true;
+    }
+    return false;
+}
+
+void AudioConcealmentKernel::conceal(quint32 &concealedSamples, quint32 &silencedSamples)
+{
+    // Decisions are based on the errors before any concealment
+    std::memcpy(m_originalErrors, m_errors, sizeof(m_errors));
+
+    if (m_maxRunLength > 0)
+        concealRuns(concealedSamples, silencedSamples);
+    else
+        concealSamples(concealedSamples, silencedSamples);
+}
+
+// Conceal each sample in error by averaging the preceding and following
+// samples of the same channel (two samples either side in the interleaved
+// data).  If either neighbour was also in error, the sample is silenced
+// (and remains flagged as an error)
+void AudioConcealmentKernel::concealSamples(quint32 &concealedSamples, quint32 &silencedSamples)
+{
+    for (qint32 word = 0; word < MaskWords; ++word) {
+        quint32 errors = m_originalErrors[word];
+        while (errors) {
+            const qint32 bit = word * 32 + static_cast<qint32>(qCountTrailingZeroBits(errors));
+            errors &= errors - 1;
+
+            // Skip the halo samples
+            if (bit < Halo || bit >= Halo + SectionSamples) continue;
+
+            if (testBit(m_originalErrors, bit - Channels) || testBit(m_originalErrors, bit + Channels)) {
+                // Silence the sample
+                m_samples[bit] = 0;
+                ++silencedSamples;
+            } else {
+                // Conceal the sample
+                m_samples[bit] = static_cast<qint16>((m_samples[bit - Channels] + m_samples[bit + Channels]) / 2);
+                setBit(m_errors, bit, false);
+                setBit(m_concealed, bit, true);
+                ++concealedSamples;
+            }
+        }
+    }
+}
+
+// Conceal runs of consecutive samples in error (per channel).  Each run is
+// found once, from its first sample in the section, and extended backwards
+// into the leading halo and forwards into the trailing halo so that runs
+// crossing a section boundary are interpolated over their full length (the
+// caller loads both halos with uncorrected samples, so both sections see the
+// same run and the same valid samples either side of it).
+// Runs longer than the maximum, or without a valid neighbour either side,
+// are silenced
+void AudioConcealmentKernel::concealRuns(quint32 &concealedSamples, quint32 &silencedSamples)
+{
+    for (qint32 word = 0; word < MaskWords; ++word) {
+        quint32 errors = m_originalErrors[word];
+        while (errors) {
+            const qint32 bit = word * 32 + static_cast<qint32>(qCountTrailingZeroBits(errors));
+            errors &= errors - 1;
+
+            // Skip the halo samples and samples already handled as part of a run
+            if (bit < Halo || bit >= Halo + SectionSamples) continue;
+            if (bit - Channels >= Halo && testBit(m_originalErrors, bit - Channels)) continue;
+
+            // Find the full extent of the run in this channel
+            qint32 first = bit;
+            while (first - Channels >= 0 && testBit(m_originalErrors, first - Channels)) first -= Channels;
+            qint32 last = bit;
+            while (last + Channels < BufferSamples && testBit(m_originalErrors, last + Channels)) last += Channels;
+            const qint32 length = (last - first) / Channels + 1;
+
+            // Only the part of the run within the section is written
+            const qint32 sectionFirst = qMax(first, bit);
+            const qint32 sectionLast = qMin(last, static_cast<qint32>(Halo + SectionSamples - 1));
+            const quint32 sectionLength = static_cast<quint32>((sectionLast - sectionFirst) / Channels + 1);
+
+            float interpolated[MaxRunLimit];
+            const bool haveNeighbours = isValidAt(first - Channels) && isValidAt(last + Channels);
+            if (length > m_maxRunLength || !haveNeighbours) {
+                for (qint32 i = sectionFirst; i <= sectionLast; i += Channels) m_samples[i] = 0;
+                silencedSamples += sectionLength;
+                continue;
+            }
+
+            const float p1 = m_samples[first - Channels];
+            const float p2 = m_samples[last + Channels];
+            if (isValidAt(first - 2 * Channels) && isValidAt(last + 2 * Channels)) {
+                // Cubic through the two valid samples either side
+                const float p0 = m_samples[first - 2 * Channels];
+                const float p3 = m_samples[last + 2 * Channels];
+                const float *w0 = m_cubicWeights[length][0];
+                const float *w1 = m_cubicWeights[length][1];
+                const float *w2 = m_cubicWeights[length][2];
+                const float *w3 = m_cubicWeights[length][3];
+                for (qint32 i = 0; i < length; ++i) {
+                    interpolated[i] = w0[i] * p0 + w1[i] * p1 + w2[i] * p2 + w3[i] * p3;
+                }
+            } else {
+                // Linear between the immediate neighbours
+                const float step = (p2 - p1) / static_cast<float>(length + 1);
+                for (qint32 i = 0; i < length; ++i) {
+                    interpolated[i] = p1 + step * static_cast<float>(i + 1);
+                }
+            }
+
+            for (qint32 i = sectionFirst; i <= sectionLast; i += Channels) {
+                const float value = qBound(-32768.0f, interpolated[(i - first) / Channels], 32767.0f);
+                m_samples[i] = static_cast<qint16>(value < 0 ? value - 0.5f : value + 0.5f);
+                setBit(m_errors, i, false);
+                setBit(m_concealed, i, true);
+            }
+            concealedSamples += sectionLength;
+        }
+    }
+}
+
+// Returns true if the sample at the buffer position exists and was not in error
+bool AudioConcealmentKernel::isValidAt(qint32 bit) const
+{
+    return bit >= 0 && bit < BufferSamples && !testBit(m_originalErrors, bit);
+}
+
+// Copy the 12 interleaved samples of a frame out of the section buffer
+void AudioConcealmentKernel::storeFrame(qint32 frameIndex, qint16 *samples, bool *errors, bool *concealed) const
+{
+    const qint32 first = Halo + frameIndex * FrameSamples;
+    std::memcpy(samples, m_samples + first, FrameSamples * sizeof(qint16));
+    for (qint32 i = 0; i < FrameSamples; ++i) {
+        errors[i] = testBit(m_errors, first + i);
+        concealed[i] = testBit(m_concealed, first + i);
+    }
+}
+
+void AudioConcealmentKernel::setBit(quint32 *mask, qint32 bit, bool value)
+{
+    if (value)
+        mask[bit >> 5] |= 1u << (bit & 31);
+    else
+        mask[bit >> 5] &= ~(1u << (bit & 31));
+}
+
+// Extract up to 32 bits from a mask starting at any bit position
+quint32 AudioConcealmentKernel::maskBits(const quint32 *mask, qint32 firstBit, qint32 count) const
+{
+    const qint32 word = firstBit >> 5;
+    const qint32 shift = firstBit & 31;
+    quint64 bits = mask[word] >> shift;
+    if (shift + count > 32 && word + 1 < MaskWords) {
+        bits |= static_cast<quint64>(mask[word + 1]) << (32 - shift);
+    }
+    if (count < 32) bits &= (1ull << count) - 1;
+    return static_cast<quint32>(bits);
+}
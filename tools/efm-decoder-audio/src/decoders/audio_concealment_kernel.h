@@ -0,0 +1,97 @@
+/************************************************************************
+
+    audio_concealment_kernel.h
+
+    efm-decoder-audio - EFM Data24 to Audio decoder
+    Copyright (C) 2025 Simon Inns
+
+    This file is part of ld-decode-tools.
+
+    This application is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+************************************************************************/
+
+#ifndef AUDIO_CONCEALMENT_KERNEL_H
+#define AUDIO_CONCEALMENT_KERNEL_H
+
+#include <QtGlobal>
+
+// Concealment kernel for a section of interleaved audio samples
+//
+// The 1176 interleaved samples of a section are held in one contiguous array
+// along with error and concealment bitmasks.  A halo of three frames either
+// side of the section holds the neighbouring samples from the previous and
+// next sections so that samples near the section boundaries can be concealed
+// without any special cases.  Nothing is allocated on the heap.
+//
+// By default a single sample in error is replaced by the average of its
+// neighbours.  If a maximum run length is set, runs of up to that many
+// consecutive bad samples per channel are bridged with a cubic interpolation
+// through the two valid samples either side of the run (or a linear one if
+// only the immediate neighbours are valid).
+class AudioConcealmentKernel
+{
+public:
+    enum {
+        FrameSamples = 12,
+        SectionSamples = 98 * FrameSamples,
+        Channels = 2,
+        MaxRunLimit = 16,
+        HaloFrames = 3,
+        Halo = HaloFrames * FrameSamples,
+        BufferSamples = Halo + SectionSamples + Halo,
+        MaskWords = (BufferSamples + 31) / 32
+    };
+
+    AudioConcealmentKernel();
+
+    // Frame and sample indexes are relative to the start of the section; the
+    // halo frames are -3 to -1 (previous section) and 98 to 100 (next section)
+    void loadFrame(qint32 frameIndex, const qint16 *samples, const bool *errors);
+
+    // 0 (the default) disables run concealment
+    void setMaxRunLength(qint32 maxRunLength);
+    qint32 maxRunLength() const { return m_maxRunLength; }
+
+    bool hasErrors() const;
+    void conceal(quint32 &concealedSamples, quint32 &silencedSamples);
+
+    void storeFrame(qint32 frameIndex, qint16 *samples, bool *errors, bool *concealed) const;
+
+    qint16 sample(qint32 index) const { return m_samples[index + Halo]; }
+    bool isError(qint32 index) const { return testBit(m_errors, index + Halo); }
+    bool wasError(qint32 index) const { return testBit(m_originalErrors, index + Halo); }
+    bool isConcealed(qint32 index) const { return testBit(m_concealed, index + Halo); }
+
+private:
+    static bool testBit(const quint32 *mask, qint32 bit) { return (mask[bit >> 5] >> (bit & 31)) & 1; }
+    static void setBit(quint32 *mask, qint32 bit, bool value);
+    quint32 maskBits(const quint32 *mask, qint32 firstBit, qint32 count) const;
+    void concealSamples(quint32 &concealedSamples, quint32 &silencedSamples);
+    void concealRuns(quint32 &concealedSamples, quint32 &silencedSamples);
+    bool isValidAt(qint32 bit) const;
+
+    qint32 m_maxRunLength;
+
+    // Cubic interpolation weights per run length for each of the four
+    // valid samples (two before and two after the run) and run position
+    float m_cubicWeights[MaxRunLimit + 1][4][MaxRunLimit];
+
+    qint16 m_samples[BufferSamples];
+    quint32 m_errors[MaskWords];
+    quint32 m_originalErrors[MaskWords];
+    quint32 m_concealed[MaskWords];
+};
+
+#endif // AUDIO_CONCEALMENT_KERNEL_H
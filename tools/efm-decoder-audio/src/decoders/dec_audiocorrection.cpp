@@ -28,7 +28,9 @@ AudioCorrection::AudioCorrection() :
     m_silencedSamplesCount(0),
     m_validSamplesCount(0),
     m_concealedSamplesCount(0),
-    m_firstSectionFlag(true)
+    m_firstSectionFlag(true),
+    m_haveOriginalHalo(false),
+    m_recordEvents(false)
 {}
 
 void AudioCorrection::pushSection(const AudioSection &audioSection)
@@ -61,180 +63,79 @@ void AudioCorrection::processQueue()
 
     // Perform correction on the section in the middle of the correction buffer
     if (m_correctionBuffer.size() == 3) {
-        AudioSection correctedSection;
+        AudioSection &section = m_correctionBuffer[1];
 
-        // Process all 98 frames in the section
+        // Load the section's samples into the concealment buffer
+        bool frameErrors[98];
+        bool sectionErrors = false;
         for (int subSection = 0; subSection < 98; ++subSection) {
-            Audio correctedFrame;
-
-            // Get the preceding, correcting and following frames
-            Audio precedingFrame, correctingFrame, followingFrame;
-            if (subSection == 0) {
-                // If this is the first frame, use the first frame in the section as the preceding frame
-                precedingFrame = m_correctionBuffer.at(0).frame(97);
-            } else {
-                precedingFrame = m_correctionBuffer.at(1).frame(subSection - 1);
-            }
-
-            correctingFrame = m_correctionBuffer.at(1).frame(subSection);
-
-            if (correctingFrame.countErrors() == 0) {
-                // No errors in this frame - just copy it
-                correctedSection.pushFrame(correctingFrame);
-                continue;
-            }
+            const Audio frame = section.frame(subSection);
+            const QVector<qint16> data = frame.data();
+            const QVector<bool> errorData = frame.errorData();
+            m_kernel.loadFrame(subSection, data.constData(), errorData.constData());
+            frameErrors[subSection] = errorData.contains(true);
+            sectionErrors |= frameErrors[subSection];
+        }
 
-            if (subSection == 97) {
-                // If this is the last frame, use the last frame in the section as the following frame
-                followingFrame = m_correctionBuffer.at(2).frame(0);
-            } else {
-                followingFrame = m_correctionBuffer.at(1).frame(subSection + 1);
-            }
+        // Keep the uncorrected end of this section for the leading halo of the
+        // next section
+        Audio originalHalo[AudioConcealmentKernel::HaloFrames];
+        for (int haloFrame = 0; haloFrame < AudioConcealmentKernel::HaloFrames; ++haloFrame) {
+            originalHalo[haloFrame] = section.frame(98 - AudioConcealmentKernel::HaloFrames + haloFrame);
+        }
 
-            // Sample correction
-            QVector<qint16> correctedLeftSamples;
-            QVector<bool> correctedLeftErrorSamples;
-            QVector<bool> correctedLeftPaddedSamples;
-            QVector<qint16> correctedRightSamples;
-            QVector<bool> correctedRightErrorSamples;
-            QVector<bool> correctedRightPaddedSamples;
-
-            for (int sampleOffset = 0; sampleOffset < 6; ++sampleOffset) {
-                // Left channel
-                // Get the preceding, correcting and following left samples
-                qint16 precedingLeftSample, correctingLeftSample, followingLeftSample;
-                qint16 precedingLeftSampleError, correctingLeftSampleError, followingLeftSampleError;
-
-                if (sampleOffset == 0) {
-                    precedingLeftSample = precedingFrame.dataLeft().at(5);
-                    precedingLeftSampleError = precedingFrame.errorDataLeft().at(5);
-                } else {
-                    precedingLeftSample = correctingFrame.dataLeft().at(sampleOffset - 1);
-                    precedingLeftSampleError = correctingFrame.errorDataLeft().at(sampleOffset - 1);
-                }
-
-                correctingLeftSample = correctingFrame.dataLeft().at(sampleOffset);
-                correctingLeftSampleError = correctingFrame.errorDataLeft().at(sampleOffset);
-
-                if (sampleOffset == 5) {
-                    followingLeftSample = followingFrame.dataLeft().at(0);
-                    followingLeftSampleError = followingFrame.errorDataLeft().at(0);
-                } else {
-                    followingLeftSample = correctingFrame.dataLeft().at(sampleOffset + 1);
-                    followingLeftSampleError = correctingFrame.errorDataLeft().at(sampleOffset + 1);
-                }
-
-                if (correctingLeftSampleError != 0) {
-                    // Do we have a valid preceding and following sample?
-                    if (precedingLeftSampleError || followingLeftSampleError) {
-                        // Silence the sample
-                        qDebug().noquote().nospace() << "AudioCorrection::processQueue() -  Left  Silencing: "
-                            << "Section address " << m_correctionBuffer.at(1).metadata.absoluteSectionTime().toString()
-                            << " - Frame " << subSection << ", sample " << sampleOffset;
-                        correctedLeftSamples.append(0);
-                        correctedLeftErrorSamples.append(true);
-                        correctedLeftPaddedSamples.append(false);
-                        ++m_silencedSamplesCount;
-                    } else {
-                        // Conceal the sample
-                        qDebug().noquote().nospace() << "AudioCorrection::processQueue() -  Left Concealing: "
-                            << "Section address " << m_correctionBuffer.at(1).metadata.absoluteSectionTime().toString()
-                            << " - Frame " << subSection << ", sample " << sampleOffset
-                            << " - Preceding = " << precedingLeftSample << ", Following = " << followingLeftSample
-                            << ", Average = " << (precedingLeftSample + followingLeftSample) / 2;
-                        correctedLeftSamples.append((precedingLeftSample + followingLeftSample) / 2);
-                        correctedLeftErrorSamples.append(false);
-                        correctedLeftPaddedSamples.append(true);
-                        ++m_concealedSamplesCount;
-                    }
-                } else {
-                    // The sample is valid - just copy it
-                    correctedLeftSamples.append(correctingLeftSample);
-                    correctedLeftErrorSamples.append(false);
-                    correctedLeftPaddedSamples.append(false);
-                    ++m_validSamplesCount;
-                }
-
-                // Right channel
-                // Get the preceding, correcting and following right samples
-                qint16 precedingRightSample, correctingRightSample, followingRightSample;
-                qint16 precedingRightSampleError, correctingRightSampleError, followingRightSampleError;
-
-                if (sampleOffset == 0) {
-                    precedingRightSample = precedingFrame.dataRight().at(5);
-                    precedingRightSampleError = precedingFrame.errorDataRight().at(5);
-                } else {
-                    precedingRightSample = correctingFrame.dataRight().at(sampleOffset - 1);
-                    precedingRightSampleError = correctingFrame.errorDataRight().at(sampleOffset - 1);
-                }
-
-                correctingRightSample = correctingFrame.dataRight().at(sampleOffset);
-                correctingRightSampleError = correctingFrame.errorDataRight().at(sampleOffset);
-
-                if (sampleOffset == 5) {
-                    followingRightSample = followingFrame.dataRight().at(0);
-                    followingRightSampleError = followingFrame.errorDataRight().at(0);
-                } else {
-                    followingRightSample = correctingFrame.dataRight().at(sampleOffset + 1);
-                    followingRightSampleError = correctingFrame.errorDataRight().at(sampleOffset + 1);
-                }
-
-                if (correctingRightSampleError != 0) {
-                    // Do we have a valid preceding and following sample?
-                    if (precedingRightSampleError || followingRightSampleError) {
-                        // Silence the sample
-                        qDebug().noquote().nospace() << "AudioCorrection::processQueue() - Right  Silencing: "
-                            << "Section address " << m_correctionBuffer.at(1).metadata.absoluteSectionTime().toString()
-                            << " - Frame " << subSection << ", sample " << sampleOffset;
-                        correctedRightSamples.append(0);
-                        correctedRightErrorSamples.append(true);
-                        correctedRightPaddedSamples.append(false);
-                        ++m_silencedSamplesCount;
-                    } else {
-                        // Conceal the sample
-                        qDebug().noquote().nospace() << "AudioCorrection::processQueue() - Right Concealing: "
-                            << "Section address " << m_correctionBuffer.at(1).metadata.absoluteSectionTime().toString()
-                            << " - Frame " << subSection << ", sample " << sampleOffset
-                            << " - Preceding = " << precedingRightSample << ", Following = " << followingRightSample
-                            << ", Average = " << (precedingRightSample + followingRightSample) / 2;
-                        correctedRightSamples.append((precedingRightSample + followingRightSample) / 2);
-                        correctedRightErrorSamples.append(false);
-                        correctedRightPaddedSamples.append(true);
-                        ++m_concealedSamplesCount;
-                    }
-                } else {
-                    // The sample is valid - just copy it
-                    correctedRightSamples.append(correctingRightSample);
-                    correctedRightErrorSamples.append(false);
-                    correctedRightPaddedSamples.append(false);
-                    ++m_validSamplesCount;
-                }
+        if (!sectionErrors) {
+            // No errors in this section - nothing to do
+            m_validSamplesCount += AudioConcealmentKernel::SectionSamples;
+        } else {
+            // The halo is the last frames of the preceding section (as they were
+            // before it was corrected) and the first frames of the following
+            // section, so a run crossing a section boundary is interpolated
+            // from the same valid samples on both sides of the boundary
+            for (int haloFrame = 0; haloFrame < AudioConcealmentKernel::HaloFrames; ++haloFrame) {
+                const Audio precedingFrame = m_haveOriginalHalo ? m_originalHalo[haloFrame]
+                    : m_correctionBuffer.at(0).frame(98 - AudioConcealmentKernel::HaloFrames + haloFrame);
+                const Audio followingFrame = m_correctionBuffer.at(2).frame(haloFrame);
+                m_kernel.loadFrame(haloFrame - AudioConcealmentKernel::HaloFrames, precedingFrame.data().constData(),
+                    precedingFrame.errorData().constData());
+                m_kernel.loadFrame(98 + haloFrame, followingFrame.data().constData(),
+                    followingFrame.errorData().constData());
             }
 
-            // Combine the left and right channel data (and error data)
-            QVector<qint16> correctedSamples;
-            QVector<bool> correctedErrorSamples;
-            QVector<bool> correctedPaddedSamples;
-
-            for (int i = 0; i < 6; ++i) {
-                correctedSamples.append(correctedLeftSamples.at(i));
-                correctedSamples.append(correctedRightSamples.at(i));
-                correctedErrorSamples.append(correctedLeftErrorSamples.at(i));
-                correctedErrorSamples.append(correctedRightErrorSamples.at(i));
-                correctedPaddedSamples.append(correctedLeftPaddedSamples.at(i));
-                correctedPaddedSamples.append(correctedRightPaddedSamples.at(i));
+            quint32 concealedSamples = 0;
+            quint32 silencedSamples = 0;
+            m_kernel.conceal(concealedSamples, silencedSamples);
+            m_concealedSamplesCount += concealedSamples;
+            m_silencedSamplesCount += silencedSamples;
+            m_validSamplesCount += AudioConcealmentKernel::SectionSamples - concealedSamples - silencedSamples;
+
+            // Write the frames that had errors back to the section
+            QVector<qint16> correctedSamples(AudioConcealmentKernel::FrameSamples);
+            QVector<bool> correctedErrorSamples(AudioConcealmentKernel::FrameSamples);
+            QVector<bool> correctedConcealedSamples(AudioConcealmentKernel::FrameSamples);
+            const qint32 sectionTime = section.metadata.absoluteSectionTime().frames();
+            for (int subSection = 0; subSection < 98; ++subSection) {
+                if (!frameErrors[subSection]) continue;
+
+                // Per-sample reporting is only done if something is listening
+                if (m_showDebug) showCorrectionDebug(subSection);
+                if (m_recordEvents) recordEvents(subSection, sectionTime);
+
+                m_kernel.storeFrame(subSection, correctedSamples.data(), correctedErrorSamples.data(),
+                    correctedConcealedSamples.data());
+
+                Audio correctedFrame;
+                correctedFrame.setData(correctedSamples);
+                correctedFrame.setErrorData(correctedErrorSamples);
+                correctedFrame.setConcealedData(correctedConcealedSamples);
+                section.setFrame(subSection, correctedFrame);
             }
-
-            // Write the channel data back to the correction buffer's frame
-            correctedFrame.setData(correctedSamples);
-            correctedFrame.setErrorData(correctedErrorSamples);
-            correctedFrame.setConcealedData(correctedPaddedSamples);
-
-            correctedSection.pushFrame(correctedFrame);
         }
 
-        correctedSection.metadata = m_correctionBuffer.at(1).metadata;
-        m_correctionBuffer[1] = correctedSection;
+        for (int haloFrame = 0; haloFrame < AudioConcealmentKernel::HaloFrames; ++haloFrame) {
+            m_originalHalo[haloFrame] = originalHalo[haloFrame];
+        }
+        m_haveOriginalHalo = true;
 
         // Write the first section in the correction buffer to the output buffer
         m_outputBuffer.enqueue(m_correctionBuffer.at(0));
@@ -242,6 +143,70 @@ void AudioCorrection::processQueue()
     }
 }
 
+// Show the concealment or silencing of each sample in error in a frame
+void AudioCorrection::showCorrectionDebug(qint32 subSection)
+{
+    for (int sampleOffset = 0; sampleOffset < AudioConcealmentKernel::FrameSamples; ++sampleOffset) {
+        const qint32 index = subSection * AudioConcealmentKernel::FrameSamples + sampleOffset;
+        if (!m_kernel.wasError(index)) continue;
+
+        const QString channel = (sampleOffset % 2 == 0) ? " Left " : "Right ";
+        if (m_kernel.isConcealed(index)) {
+            qDebug().noquote().nospace() << "AudioCorrection::processQueue() - " << channel << "Concealing: "
+                << "Section address " << m_correctionBuffer.at(1).metadata.absoluteSectionTime().toString()
+                << " - Frame " << subSection << ", sample " << sampleOffset / 2
+                << " - Preceding = " << m_kernel.sample(index - 2) << ", Following = " << m_kernel.sample(index + 2)
+                << (m_kernel.maxRunLength() > 0 ? ", Interpolated = " : ", Average = ") << m_kernel.sample(index);
+        } else {
+            qDebug().noquote().nospace() << "AudioCorrection::processQueue() - " << channel << " Silencing: "
+                << "Section address " << m_correctionBuffer.at(1).metadata.absoluteSectionTime().toString()
+                << " - Frame " << subSection << ", sample " << sampleOffset / 2;
+        }
+    }
+}
+
+// Record a concealment event for each sample in error in a frame
+void AudioCorrection::recordEvents(qint32 subSection, qint32 sectionTime)
+{
+    for (int sampleOffset = 0; sampleOffset < AudioConcealmentKernel::FrameSamples; ++sampleOffset) {
+        const qint32 index = subSection * AudioConcealmentKernel::FrameSamples + sampleOffset;
+        if (!m_kernel.wasError(index)) continue;
+
+        ConcealmentEvent event;
+        event.sectionTime = sectionTime;
+        event.frame = static_cast<quint8>(subSection);
+        event.sample = static_cast<quint8>(sampleOffset / 2);
+        event.channel = static_cast<quint8>(sampleOffset % 2);
+        event.action = m_kernel.isConcealed(index) ? ConcealmentEvent::Concealed : ConcealmentEvent::Silenced;
+        m_events.append(event);
+    }
+}
+
+// Set the longest run of bad samples (per channel) that will be bridged by
+// interpolation; 0 conceals only single samples between two valid neighbours
+void AudioCorrection::setMaxRunLength(qint32 maxRunLength)
+{
+    m_kernel.setMaxRunLength(maxRunLength);
+}
+
+void AudioCorrection::setRecordEvents(bool recordEvents)
+{
+    m_recordEvents = recordEvents;
+}
+
+bool AudioCorrection::hasEvents() const
+{
+    return !m_events.isEmpty();
+}
+
+// Return the recorded events and clear the event buffer
+QVector<ConcealmentEvent> AudioCorrection::takeEvents()
+{
+    QVector<ConcealmentEvent> events;
+    events.swap(m_events);
+    return events;
+}
+
 void AudioCorrection::showStatistics()
 {
     qInfo().nospace() << "Audio correction statistics:";
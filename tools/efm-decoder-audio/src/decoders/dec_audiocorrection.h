@@ -27,6 +27,23 @@
 
 #include "decoders.h"
 #include "section.h"
+#include "audio_concealment_kernel.h"
+
+// A single concealment event - one mono sample that was in error and was
+// either concealed (interpolated) or silenced.  Kept small so that a badly
+// damaged disc can be logged without formatting millions of text lines
+struct ConcealmentEvent {
+    enum Action : quint8 {
+        Concealed = 0,
+        Silenced = 1
+    };
+
+    qint32 sectionTime; // Absolute section time in frames (75 per second)
+    quint8 frame;       // Frame within the section (0-97)
+    quint8 sample;      // Stereo sample within the frame (0-5)
+    quint8 channel;     // 0 = Left, 1 = Right
+    quint8 action;      // ConcealmentEvent::Action
+};
 
 class AudioCorrection : public Decoder
 {
@@ -38,17 +55,34 @@ public:
 
     void showStatistics();
 
+    void setMaxRunLength(qint32 maxRunLength);
+
+    // Concealment event recording (off by default)
+    void setRecordEvents(bool recordEvents);
+    bool hasEvents() const;
+    QVector<ConcealmentEvent> takeEvents();
+
 private:
     void processQueue();
+    void showCorrectionDebug(qint32 subSection);
+    void recordEvents(qint32 subSection, qint32 sectionTime);
     QString convertToAudacityTimestamp(qint32 minutes, qint32 seconds, qint32 frames, qint32 subsection, qint32 sample);
 
     QQueue<AudioSection> m_inputBuffer;
     QQueue<AudioSection> m_outputBuffer;
 
     QVector<AudioSection> m_correctionBuffer;
+    AudioConcealmentKernel m_kernel;
 
     bool m_firstSectionFlag;
 
+    // The last frames of the preceding section before it was corrected
+    bool m_haveOriginalHalo;
+    Audio m_originalHalo[AudioConcealmentKernel::HaloFrames];
+
+    bool m_recordEvents;
+    QVector<ConcealmentEvent> m_events;
+
     // Statistics
     quint32 m_concealedSamplesCount;
     quint32 m_silencedSamplesCount;
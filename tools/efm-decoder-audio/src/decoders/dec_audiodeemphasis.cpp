@@ -0,0 +1,195 @@
+/************************************************************************
+
+    dec_audiodeemphasis.cpp
+
+    efm-decoder-audio - EFM Data24 to Audio decoder
+    Copyright (C) 2025 Simon Inns
+
+    This file is part of ld-decode-tools.
+
+    This application is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+************************************************************************/
+
+#include "dec_audiodeemphasis.h"
+
+#include <cmath>
+
+AudioDeemphasis::AudioDeemphasis() :
+    m_enabled(true),
+    m_highResolution(false),
+    m_active(false),
+    m_deemphasisedSections(0),
+    m_flatSections(0),
+    m_switchCount(0)
+{
+    // The analogue response is (1 + s.t2) / (1 + s.t1) with t1 = 50us and
+    // t2 = 15us.  A bilinear transform of this is up to 1dB out near 20kHz,
+    // so the pole and zero at 44.1kHz are instead fitted to the analogue
+    // response (within 0.1dB from 20Hz to 20kHz) with unity gain at DC
+    const double pole = 0.62767;
+    const double zero = 0.19197;
+    const double gain = (1.0 - pole) / (1.0 - zero);
+    m_b0 = static_cast<float>(gain);
+    m_b1 = static_cast<float>(-gain * zero);
+    m_a1 = static_cast<float>(-pole);
+
+    m_x1[0] = m_x1[1] = 0.0f;
+    m_y1[0] = m_y1[1] = 0.0f;
+}
+
+// If not enabled, sections are passed through (or converted to 24-bit) unfiltered
+void AudioDeemphasis::setEnabled(bool enabled)
+{
+    m_enabled = enabled;
+}
+
+// If set, a 24-bit copy of each section is queued alongside the 16-bit output
+void AudioDeemphasis::setHighResolution(bool highResolution)
+{
+    m_highResolution = highResolution;
+}
+
+void AudioDeemphasis::pushSection(const AudioSection &audioSection)
+{
+    // Add the data to the input buffer
+    m_inputBuffer.enqueue(audioSection);
+
+    // Process the queue
+    processQueue();
+}
+
+AudioSection AudioDeemphasis::popSection()
+{
+    // Return the first item in the output buffer
+    return m_outputBuffer.dequeue();
+}
+
+// The 24-bit samples of the section last returned by popSection()
+QVector<qint32> AudioDeemphasis::popHighResolutionSection()
+{
+    return m_highResolutionBuffer.dequeue();
+}
+
+bool AudioDeemphasis::isReady() const
+{
+    // Return true if the output buffer is not empty
+    return !m_outputBuffer.isEmpty();
+}
+
+void AudioDeemphasis::processQueue()
+{
+    while (!m_inputBuffer.isEmpty()) {
+        AudioSection section = m_inputBuffer.dequeue();
+
+        // Follow the pre-emphasis flag (if the metadata can be trusted)
+        if (m_enabled && section.metadata.isValid() && section.metadata.hasPreemphasis() != m_active) {
+            m_active = section.metadata.hasPreemphasis();
+            ++m_switchCount;
+            if (m_showDebug) {
+                qDebug().noquote() << "AudioDeemphasis::processQueue(): De-emphasis switched" << (m_active ? "on" : "off")
+                                   << "at" << section.metadata.absoluteSectionTime().toString();
+            }
+
+            // Start the filter from the first sample to avoid a transient
+            if (m_active) {
+                const QVector<qint16> first = section.frame(0).data();
+                for (int channel = 0; channel < 2; ++channel) {
+                    m_x1[channel] = first.at(channel);
+                    m_y1[channel] = first.at(channel);
+                }
+            }
+        }
+
+        if (!m_active) {
+            ++m_flatSections;
+            if (m_highResolution) {
+                QVector<qint32> highResolution(SectionSamples);
+                for (int index = 0; index < 98; ++index) {
+                    const QVector<qint16> data = section.frame(index).data();
+                    for (int i = 0; i < 12; ++i) highResolution[index * 12 + i] = static_cast<qint32>(data.at(i)) * 256;
+                }
+                m_highResolutionBuffer.enqueue(highResolution);
+            }
+            m_outputBuffer.enqueue(section);
+            continue;
+        }
+
+        ++m_deemphasisedSections;
+
+        float samples[SectionSamples];
+        for (int index = 0; index < 98; ++index) {
+            const QVector<qint16> data = section.frame(index).data();
+            for (int i = 0; i < 12; ++i) samples[index * 12 + i] = data.at(i);
+        }
+
+        filterSection(samples);
+
+        QVector<qint32> highResolution;
+        if (m_highResolution) highResolution.resize(SectionSamples);
+        for (int index = 0; index < 98; ++index) {
+            Audio audio = section.frame(index);
+            QVector<qint16> data(12);
+            for (int i = 0; i < 12; ++i) {
+                const float value = samples[index * 12 + i];
+                data[i] = static_cast<qint16>(qBound(-32768L, std::lround(value), 32767L));
+                if (m_highResolution) {
+                    highResolution[index * 12 + i] =
+                        static_cast<qint32>(qBound(-8388608L, std::lround(value * 256.0f), 8388607L));
+                }
+            }
+            audio.setData(data);
+            section.setFrame(index, audio);
+        }
+
+        if (m_highResolution) m_highResolutionBuffer.enqueue(highResolution);
+        m_outputBuffer.enqueue(section);
+    }
+}
+
+// Filter the interleaved samples of a section in place.  Both channels are
+// computed together in each step so the compiler can pair the operations
+void AudioDeemphasis::filterSection(float *samples)
+{
+    const float b0 = m_b0;
+    const float b1 = m_b1;
+    const float a1 = m_a1;
+    float x1[2] = { m_x1[0], m_x1[1] };
+    float y1[2] = { m_y1[0], m_y1[1] };
+
+    for (int i = 0; i < SectionSamples; i += 2) {
+        float x[2] = { samples[i], samples[i + 1] };
+        float y[2];
+        for (int channel = 0; channel < 2; ++channel) {
+            y[channel] = b0 * x[channel] + b1 * x1[channel] - a1 * y1[channel];
+            x1[channel] = x[channel];
+            y1[channel] = y[channel];
+        }
+        samples[i] = y[0];
+        samples[i + 1] = y[1];
+    }
+
+    m_x1[0] = x1[0];
+    m_x1[1] = x1[1];
+    m_y1[0] = y1[0];
+    m_y1[1] = y1[1];
+}
+
+void AudioDeemphasis::showStatistics()
+{
+    qInfo().nospace() << "Audio de-emphasis statistics:";
+    qInfo().nospace() << "  De-emphasised sections: " << m_deemphasisedSections;
+    qInfo().nospace() << "  Unfiltered sections: " << m_flatSections;
+    qInfo().nospace() << "  Pre-emphasis changes: " << m_switchCount;
+}
@@ -0,0 +1,79 @@
+/************************************************************************
+
+    dec_audiodeemphasis.h
+
+    efm-decoder-audio - EFM Data24 to Audio decoder
+    Copyright (C) 2025 Simon Inns
+
+    This file is part of ld-decode-tools.
+
+    This application is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+************************************************************************/
+
+#ifndef DEC_AUDIODEEMPHASIS_H
+#define DEC_AUDIODEEMPHASIS_H
+
+#include "decoders.h"
+#include "section.h"
+
+// De-emphasis of audio recorded with 50/15us pre-emphasis (IEC 60908)
+//
+// The filter is switched on and off per section following the pre-emphasis
+// flag of the Q-channel control field (sections with invalid metadata keep
+// the previous state).  Optionally the filtered samples are also made
+// available at 24-bit resolution to avoid requantising the output to 16 bits
+class AudioDeemphasis : public Decoder
+{
+public:
+    enum {
+        SectionSamples = 98 * 12
+    };
+
+    AudioDeemphasis();
+    void setEnabled(bool enabled);
+    void setHighResolution(bool highResolution);
+    void pushSection(const AudioSection &audioSection);
+    AudioSection popSection();
+    QVector<qint32> popHighResolutionSection();
+    bool isReady() const;
+
+    void showStatistics();
+
+private:
+    void processQueue();
+    void filterSection(float *samples);
+
+    QQueue<AudioSection> m_inputBuffer;
+    QQueue<AudioSection> m_outputBuffer;
+    QQueue<QVector<qint32>> m_highResolutionBuffer;
+
+    bool m_enabled;
+    bool m_highResolution;
+    bool m_active;
+
+    // First order shelving filter coefficients and per-channel state
+    float m_b0;
+    float m_b1;
+    float m_a1;
+    float m_x1[2];
+    float m_y1[2];
+
+    // Statistics
+    quint32 m_deemphasisedSections;
+    quint32 m_flatSections;
+    quint32 m_switchCount;
+};
+
+#endif // DEC_AUDIODEEMPHASIS_H
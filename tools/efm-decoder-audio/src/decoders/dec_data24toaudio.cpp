@@ -24,6 +24,10 @@
 
 #include "dec_data24toaudio.h"
 
+#include <QtEndian>
+#include <QtAlgorithms>
+#include <cstring>
+
 Data24ToAudio::Data24ToAudio() :
     m_startTime(SectionTime(59, 59, 74)),
     m_endTime(SectionTime(0, 0, 0)),
@@ -31,7 +35,8 @@ Data24ToAudio::Data24ToAudio() :
     m_validData24FramesCount(0),
     m_invalidSamplesCount(0),
     m_validSamplesCount(0),
-    m_invalidByteCount(0)
+    m_invalidByteCount(0),
+    m_clearFlags(12, false)
 {}
 
 void Data24ToAudio::pushSection(const Data24Section &data24Section)
@@ -68,46 +73,39 @@ void Data24ToAudio::processQueue()
         }
 
         for (int index = 0; index < 98; ++index) {
-            QVector<quint8> data24Data = data24Section.frame(index).data();
-            QVector<bool> data24ErrorData = data24Section.frame(index).errorData();
+            const Data24 data24 = data24Section.frame(index);
+            const QVector<quint8> data24Data = data24.data();
+            const QVector<bool> data24ErrorData = data24.errorData();
+
+            // The 24 bytes are 12 little-endian 16-bit samples
+            QVector<qint16> audioData(12);
+            qFromLittleEndian<qint16>(data24Data.constData(), 12, audioData.data());
 
-            if (data24Section.frame(index).countErrors() != 0) {
+            // A sample is in error if either of its bytes is in error
+            const quint32 byteErrors = byteErrorMask(data24ErrorData.constData());
+            const quint32 sampleErrors = sampleErrorMask(byteErrors);
+            const qint32 invalidSamples = qPopulationCount(sampleErrors);
+
+            if (byteErrors != 0) {
                 ++m_invalidData24FramesCount;
             } else {
                 ++m_validData24FramesCount;
             }
-
-            // Convert the 24 bytes of data into 12 16-bit audio samples
-            QVector<qint16> audioData;
-            QVector<bool> audioErrorData;
-            QVector<bool> audioConcealedData;
-            for (int i = 0; i < 24; i += 2) {
-                qint16 sample = static_cast<qint16>(static_cast<quint16>(data24Data[i + 1] << 8) | static_cast<quint16>(data24Data[i]));
-
-                if (data24ErrorData[i]) m_invalidByteCount++;
-                if (data24ErrorData[i + 1]) m_invalidByteCount++;  
-
-                // Set an error flag if either byte of the sample is an error
-                if (data24ErrorData[i + 1] || data24ErrorData[i]) {
-                    // Error in the sample
-                    audioData.append(sample);
-                    audioErrorData.append(true);
-                    audioConcealedData.append(false);
-                    ++m_invalidSamplesCount;
-                } else {
-                    // No error in the sample
-                    audioData.append(sample);
-                    audioErrorData.append(false);
-                    audioConcealedData.append(false);
-                    ++m_validSamplesCount;
-                }
-            }
+            m_invalidByteCount += qPopulationCount(byteErrors);
+            m_invalidSamplesCount += invalidSamples;
+            m_validSamplesCount += 12 - invalidSamples;
 
             // Put the resulting data into an Audio frame and push it to the output buffer
             Audio audio;
             audio.setData(audioData);
-            audio.setErrorData(audioErrorData);
-            audio.setConcealedData(audioConcealedData);
+            if (sampleErrors == 0) {
+                audio.setErrorData(m_clearFlags);
+            } else {
+                QVector<bool> audioErrorData(12);
+                for (int i = 0; i < 12; ++i) audioErrorData[i] = (sampleErrors >> i) & 1;
+                audio.setErrorData(audioErrorData);
+            }
+            audio.setConcealedData(m_clearFlags);
 
             audioSection.pushFrame(audio);
         }
@@ -127,6 +125,32 @@ void Data24ToAudio::processQueue()
     }
 }
 
+// Gather 24 byte error flags into a mask (bit n set if byte n is in error)
+// by packing each group of 8 flags with a single multiply
+quint32 Data24ToAudio::byteErrorMask(const bool *errors)
+{
+    Q_STATIC_ASSERT(sizeof(bool) == 1);
+    quint32 mask = 0;
+    for (int group = 0; group < 3; ++group) {
+        quint64 flags;
+        std::memcpy(&flags, errors + group * 8, sizeof(flags));
+        flags = qFromLittleEndian(flags);
+        mask |= static_cast<quint32>(((flags * 0x0102040810204080ull) >> 56) & 0xFF) << (group * 8);
+    }
+    return mask;
+}
+
+// Combine the error bits of each pair of bytes into a 12-bit sample error mask
+quint32 Data24ToAudio::sampleErrorMask(quint32 byteErrors)
+{
+    quint32 mask = (byteErrors | (byteErrors >> 1)) & 0x555555;
+    mask = (mask | (mask >> 1)) & 0x333333;
+    mask = (mask | (mask >> 2)) & 0x0F0F0F;
+    mask = (mask | (mask >> 4)) & 0xFF00FF;
+    mask = (mask | (mask >> 8)) & 0x000FFF;
+    return mask;
+}
+
 void Data24ToAudio::showStatistics()
 {
     qInfo() << "Data24 to Audio statistics:";
@@ -40,10 +40,15 @@ public:
 
 private:
     void processQueue();
+    static quint32 byteErrorMask(const bool *errors);
+    static quint32 sampleErrorMask(quint32 byteErrors);
 
     QQueue<Data24Section> m_inputBuffer;
     QQueue<AudioSection> m_outputBuffer;
 
+    // Shared all-clear flags for error-free frames and the concealed data
+    QVector<bool> m_clearFlags;
+
     // Statistics
     qint64 m_invalidData24FramesCount;
     qint64 m_validData24FramesCount;
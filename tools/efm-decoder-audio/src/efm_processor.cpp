@@ -27,13 +27,33 @@
 EfmProcessor::EfmProcessor() : 
     m_showAudio(false),
     m_outputWavMetadata(false),
-    m_noAudioConcealment(false)
+    m_noAudioConcealment(false),
+    m_zeroPad(false),
+    m_concealmentEventsText(false),
+    m_outputFlac(false),
+    m_splitTracks(false),
+    m_deemphasis(false),
+    m_highResolution(false),
+    m_currentTrack(0),
+    m_trackSections(0),
+    m_trackIndex01(-1),
+    m_lastRelativeTime(-1)
 {}
 
 bool EfmProcessor::process(const QString &inputFilename, const QString &outputFilename)
 {
+    // Output files ending in .flac are FLAC encoded, anything else is WAV (or RF64)
+    m_outputFlac = outputFilename.endsWith(".flac", Qt::CaseInsensitive);
+    if (m_outputFlac && m_highResolution) {
+        qCritical() << "EfmProcessor::process(): 24-bit output is only supported for WAV files";
+        return false;
+    }
+    m_writerWav.setHighResolution(m_highResolution);
+    m_audioDeemphasis.setHighResolution(m_highResolution);
+    m_audioDeemphasis.setEnabled(m_deemphasis);
+
     qDebug() << "EfmProcessor::process(): Decoding Data24 Sections from file:" << inputFilename
-             << "to wav file:" << outputFilename;
+             << "to" << (m_outputFlac ? "flac" : "wav") << "file:" << outputFilename;
 
     // Prepare the input file reader
     if (!m_readerData24Section.open(inputFilename)) {
@@ -41,50 +61,54 @@ bool EfmProcessor::process(const QString &inputFilename, const QString &outputFi
         return false;
     }
 
-    // Prepare the output writers
-    m_writerWav.open(outputFilename);
+    // Prepare the output writers (when splitting tracks the audio files are
+    // opened as each track starts)
+    m_outputFilename = outputFilename;
+    if (m_splitTracks) {
+        if (!m_writerCue.open(trackFilename(0))) {
+            return false;
+        }
+    } else if (!openAudio(outputFilename)) {
+        return false;
+    }
     if (m_outputWavMetadata) {
         QString metadataFilename = outputFilename;
         if (metadataFilename.endsWith(".wav")) {
             metadataFilename.replace(".wav", ".txt");
+        } else if (metadataFilename.endsWith(".flac", Qt::CaseInsensitive)) {
+            metadataFilename.chop(5);
+            metadataFilename.append(".txt");
         } else {
             metadataFilename.append(".txt");
         }
         m_writerWavMetadata.open(metadataFilename, m_noAudioConcealment);
     }
+    if (!m_concealmentEventsFilename.isEmpty() && !m_noAudioConcealment) {
+        if (!m_writerConcealmentEvents.open(m_concealmentEventsFilename, m_concealmentEventsText)) {
+            return false;
+        }
+        m_audioCorrection.setRecordEvents(true);
+    }
+    if (!m_metricsFilename.isEmpty()) {
+        if (!m_writerAudioMetrics.open(m_metricsFilename, m_noAudioConcealment)) {
+            return false;
+        }
+    }
 
     // Get the first section
     Data24Section currentSection = m_readerData24Section.read();
 
-    // If zero padding is required, perform it
+    // If zero padding is required the output follows the disc timeline from
+    // 00:00:00, with silence written directly to the output for the time
+    // before the first section and for any gaps between sections
     if (m_zeroPad) {
-        qint32 requiredPadding = currentSection.metadata.absoluteSectionTime().frames();
-        if (requiredPadding > 0) {
-            qInfo() << "Zero padding enabled, start time is" << currentSection.metadata.absoluteSectionTime().toString() << 
+        const qint32 requiredPadding = currentSection.metadata.absoluteSectionTime().frames();
+        if (requiredPadding > 0 && currentSection.metadata.isValid()) {
+            qInfo() << "Zero padding enabled, start time is" << currentSection.metadata.absoluteSectionTime().toString() <<
                 "and requires" << requiredPadding << "frames of padding";
-
-            SectionTime currentTime = SectionTime(0, 0, 0);
-            Data24Section zeroSection;
-            zeroSection.metadata = currentSection.metadata;
-            zeroSection.metadata.setAbsoluteSectionTime(currentTime);
-            zeroSection.metadata.setSectionTime(currentTime);
-
-            for (int j = 0; j < 98; ++j) {
-                Data24 data24Zero;
-                data24Zero.setData(QVector<quint8>(24, 0));
-                data24Zero.setErrorData(QVector<bool>(24, false));
-                data24Zero.setPaddedData(QVector<bool>(24, true));
-                zeroSection.pushFrame(data24Zero);
-            }
-
-            for (int i = 0; i < requiredPadding; ++i) {
-                zeroSection.metadata.setAbsoluteSectionTime(currentTime);
-                zeroSection.metadata.setSectionTime(currentTime);
-                m_data24ToAudio.pushSection(zeroSection);
-                processAudioPipeline();
-                currentTime++;
-            }
         }
+        m_nextOutputTime = SectionTime(0, 0, 0);
+        if (m_outputWavMetadata) m_writerWavMetadata.setStartTime(m_nextOutputTime);
     }
 
     // Process the Data24 Section data
@@ -93,7 +117,12 @@ bool EfmProcessor::process(const QString &inputFilename, const QString &outputFi
         audioPipelineTimer.restart();
         m_data24ToAudio.pushSection(currentSection);
         m_audioPipelineStats.data24ToAudioTime += audioPipelineTimer.nsecsElapsed();
-        processAudioPipeline();
+        if (!processAudioPipeline()) {
+            qCritical() << "EfmProcessor::process(): Failed to write the audio output - aborting";
+            m_readerData24Section.close();
+            closeOutput();
+            return false;
+        }
 
         // Every 500 sections show progress
         if (index % 500 == 0) {
@@ -110,7 +139,12 @@ bool EfmProcessor::process(const QString &inputFilename, const QString &outputFi
     // Nothing to do here at the moment...
 
     qInfo() << "Processing final pipeline data";
-    processAudioPipeline();
+    if (!processAudioPipeline()) {
+        qCritical() << "EfmProcessor::process(): Failed to write the audio output - aborting";
+        m_readerData24Section.close();
+        closeOutput();
+        return false;
+    }
 
     // Show summary
     qInfo() << "Decoding complete";
@@ -124,30 +158,41 @@ bool EfmProcessor::process(const QString &inputFilename, const QString &outputFi
         qInfo() << "";
     }
 
+    if (m_deemphasis) {
+        m_audioDeemphasis.showStatistics();
+        qInfo() << "";
+    }
+
     showAudioPipelineStatistics();
 
     // Close the input file
     m_readerData24Section.close();
 
     // Close the output files
-    if (m_writerWav.isOpen()) m_writerWav.close();
-    if (m_writerWavMetadata.isOpen()) m_writerWavMetadata.close();
+    closeOutput();
 
     qInfo() << "Encoding complete";
     return true;
 }
 
-void EfmProcessor::processAudioPipeline()
+void EfmProcessor::closeOutput()
+{
+    closeAudio();
+    if (m_writerCue.isOpen()) m_writerCue.close();
+    if (m_writerWavMetadata.isOpen()) m_writerWavMetadata.close();
+    if (m_writerConcealmentEvents.isOpen()) m_writerConcealmentEvents.close();
+    if (m_writerAudioMetrics.isOpen()) m_writerAudioMetrics.close();
+}
+
+// Returns false if an output file could not be opened
+bool EfmProcessor::processAudioPipeline()
 {
     QElapsedTimer audioPipelineTimer;
 
     // Audio processing
     if (m_noAudioConcealment) {
         while (m_data24ToAudio.isReady()) {
-            AudioSection audioSection = m_data24ToAudio.popSection();
-            m_writerWav.write(audioSection);
-            if (m_outputWavMetadata)
-                m_writerWavMetadata.write(audioSection);
+            if (!outputSection(m_data24ToAudio.popSection())) return false;
         }
     } else {
         audioPipelineTimer.restart();
@@ -158,12 +203,178 @@ void EfmProcessor::processAudioPipeline()
         m_audioPipelineStats.audioCorrectionTime += audioPipelineTimer.nsecsElapsed();
 
         while (m_audioCorrection.isReady()) {
-            AudioSection audioSection = m_audioCorrection.popSection();
-            m_writerWav.write(audioSection);
-            if (m_outputWavMetadata)
-                m_writerWavMetadata.write(audioSection);
+            if (!outputSection(m_audioCorrection.popSection())) return false;
+        }
+
+        writeConcealmentEvents();
+    }
+    return true;
+}
+
+// Pass a decoded section through the optional de-emphasis stage to the writers
+bool EfmProcessor::outputSection(const AudioSection &audioSection)
+{
+    if (!m_deemphasis && !m_highResolution) {
+        return writeAudio(audioSection, QVector<qint32>());
+    }
+
+    // (with 24-bit output only, the stage converts the samples unfiltered)
+    m_audioDeemphasis.pushSection(audioSection);
+
+    while (m_audioDeemphasis.isReady()) {
+        const AudioSection section = m_audioDeemphasis.popSection();
+        const QVector<qint32> highResolution = m_highResolution ? m_audioDeemphasis.popHighResolutionSection()
+                                                                : QVector<qint32>();
+        if (!writeAudio(section, highResolution)) return false;
+    }
+    return true;
+}
+
+bool EfmProcessor::writeAudio(const AudioSection &audioSection, const QVector<qint32> &highResolution)
+{
+    if (m_splitTracks && !splitTracks(audioSection.metadata)) return false;
+    if (m_zeroPad) fillTimelineGap(audioSection.metadata);
+    if (m_splitTracks) findTrackIndex(audioSection.metadata);
+    m_trackSections++;
+
+    if (m_outputFlac)
+        m_writerFlac.write(audioSection);
+    else if (m_highResolution)
+        m_writerWav.write(highResolution);
+    else
+        m_writerWav.write(audioSection);
+
+    if (m_outputWavMetadata)
+        m_writerWavMetadata.write(audioSection);
+    if (m_writerAudioMetrics.isOpen())
+        m_writerAudioMetrics.write(audioSection);
+    return true;
+}
+
+// Start a new output file when a new track starts.  Sections before the
+// first track go into the first file and lead-out, invalid or out of order
+// track numbers stay in the current file.  Returns false if the new file
+// could not be opened
+bool EfmProcessor::splitTracks(const SectionMetadata &metadata)
+{
+    const quint8 trackNumber = metadata.trackNumber();
+    const bool validTrack = metadata.isValid() && trackNumber >= 1 && trackNumber <= 99;
+    const bool haveFile = m_writerWav.isOpen() || m_writerFlac.isOpen();
+
+    if (haveFile && (!validTrack || trackNumber <= m_currentTrack)) return true;
+
+    closeAudio();
+    m_currentTrack = validTrack ? trackNumber : qMax(m_currentTrack + 1, 1);
+    m_trackSections = 0;
+    m_trackIndex01 = -1;
+    m_lastRelativeTime = -1;
+    const QString filename = trackFilename(m_currentTrack);
+    qInfo().noquote() << "Starting track" << m_currentTrack << "at" << metadata.absoluteSectionTime().toString()
+                      << "in" << filename;
+
+    if (!openAudio(filename)) return false;
+    m_writerCue.addTrack(static_cast<quint8>(m_currentTrack), filename, metadata.hasPreemphasis());
+    return true;
+}
+
+// The track number changes at the start of the pregap (index 00), where the
+// track-relative time counts down to 00:00:00.  Index 01 starts where the
+// relative time counts up again, so it is placed at the first section seen
+// counting up, less its relative time.  Track files start at the pregap
+void EfmProcessor::findTrackIndex(const SectionMetadata &metadata)
+{
+    if (m_trackIndex01 != -1) return;
+    if (!metadata.isValid() || metadata.trackNumber() != m_currentTrack) return;
+
+    const qint32 relativeTime = metadata.sectionTime().frames();
+    if (m_lastRelativeTime != -1 && relativeTime > m_lastRelativeTime) {
+        m_trackIndex01 = qMax(0, m_trackSections - relativeTime);
+        if (m_trackIndex01 > 0) {
+            qInfo().noquote() << "Track" << m_currentTrack << "has a pregap of" << SectionTime(m_trackIndex01).toString();
+        }
+    }
+    m_lastRelativeTime = relativeTime;
+}
+
+// Returns the output filename for a track, or the CUE sheet for track 0
+// (e.g. disc.wav becomes disc_01.wav, disc_02.wav ... and disc.cue)
+QString EfmProcessor::trackFilename(qint32 trackNumber) const
+{
+    QString base = m_outputFilename;
+    QString extension = m_outputFlac ? ".flac" : ".wav";
+    const qint32 dot = base.lastIndexOf(".");
+    if (dot > 0 && dot > base.lastIndexOf("/")) {
+        extension = base.mid(dot);
+        base = base.left(dot);
+    }
+
+    if (trackNumber == 0) return base + ".cue";
+    return QString("%1_%2%3").arg(base).arg(trackNumber, 2, 10, QChar('0')).arg(extension);
+}
+
+bool EfmProcessor::openAudio(const QString &filename)
+{
+    return m_outputFlac ? m_writerFlac.open(filename) : m_writerWav.open(filename);
+}
+
+void EfmProcessor::closeAudio()
+{
+    // Complete the track's CUE sheet entry (if index 01 was never found, the
+    // whole file is treated as the track)
+    if (m_writerCue.isOpen() && (m_writerWav.isOpen() || m_writerFlac.isOpen())) {
+        if (m_trackIndex01 > 0) {
+            m_writerCue.addIndex(0, 0);
+            m_writerCue.addIndex(1, m_trackIndex01);
+        } else {
+            m_writerCue.addIndex(1, 0);
+        }
+    }
+
+    if (m_writerWav.isOpen()) m_writerWav.close();
+    if (m_writerFlac.isOpen()) m_writerFlac.close();
+}
+
+// Write silence for any sections missing between the last section written
+// and the next one (without passing anything through the decoders).  Only
+// sections with valid metadata are used to place the output; a section with
+// invalid metadata is taken to be at the expected time
+void EfmProcessor::fillTimelineGap(const SectionMetadata &metadata)
+{
+    if (!metadata.isValid()) {
+        m_nextOutputTime = m_nextOutputTime + 1;
+        return;
+    }
+
+    const SectionTime sectionTime = metadata.absoluteSectionTime();
+    const qint32 gap = sectionTime.frames() - m_nextOutputTime.frames();
+    if (gap > 0) {
+        if (m_nextOutputTime.frames() > 0) {
+            qDebug() << "EfmProcessor::fillTimelineGap(): Filling gap of" << gap << "sections from"
+                     << m_nextOutputTime.toString() << "to" << sectionTime.toString();
         }
+
+        const qint64 stereoSamples = static_cast<qint64>(gap) * 98 * 6;
+        if (m_outputFlac)
+            m_writerFlac.writeSilence(stereoSamples);
+        else
+            m_writerWav.writeSilence(stereoSamples);
+        m_audioPipelineStats.paddedSections += gap;
+        m_trackSections += gap;
+    } else if (gap < 0) {
+        // The output can't go back, so the timeline follows the section time
+        // from here on (and the output drifts by the size of the jump once)
+        qWarning() << "EfmProcessor::fillTimelineGap(): Section time" << sectionTime.toString()
+                   << "is before the expected time" << m_nextOutputTime.toString() << "- output timeline will drift by"
+                   << -gap << "sections";
     }
+
+    m_nextOutputTime = sectionTime + 1;
+}
+
+void EfmProcessor::writeConcealmentEvents()
+{
+    if (m_audioCorrection.hasEvents())
+        m_writerConcealmentEvents.write(m_audioCorrection.takeEvents());
 }
 
 void EfmProcessor::showAudioPipelineStatistics()
@@ -172,6 +383,9 @@ void EfmProcessor::showAudioPipelineStatistics()
     qInfo() << "  Data24 to Audio processing time:" << m_audioPipelineStats.data24ToAudioTime / 1000000 << "ms";
     qInfo() << "  Audio correction processing time:" << m_audioPipelineStats.audioCorrectionTime / 1000000 << "ms";
 
+    if (m_zeroPad)
+        qInfo() << "  Zero padded sections:" << m_audioPipelineStats.paddedSections;
+
     qint64 totalProcessingTime = m_audioPipelineStats.data24ToAudioTime + m_audioPipelineStats.audioCorrectionTime;
     float totalProcessingTimeSeconds = totalProcessingTime / 1000000000.0;
     qInfo().nospace() << "  Total processing time: " << totalProcessingTime / 1000000 << " ms ("
@@ -191,9 +405,41 @@ void EfmProcessor::setOutputType(bool outputWavMetadata, bool noAudioConcealment
     m_zeroPad = zeroPad;
 }
 
+// Bridge runs of up to maxRunLength bad samples per channel by interpolation
+void EfmProcessor::setMaxConcealmentRun(qint32 maxRunLength)
+{
+    m_audioCorrection.setMaxRunLength(maxRunLength);
+}
+
+// De-emphasise sections flagged as pre-emphasised and/or write 24-bit samples
+void EfmProcessor::setDeemphasis(bool deemphasis, bool highResolution)
+{
+    m_deemphasis = deemphasis;
+    m_highResolution = highResolution;
+}
+
+// Write one audio file per track and a CUE sheet
+void EfmProcessor::setSplitTracks(bool splitTracks)
+{
+    m_splitTracks = splitTracks;
+}
+
+// Record audio concealment events to a file (binary records, or text if renderText is set)
+void EfmProcessor::setConcealmentEvents(const QString &filename, bool renderText)
+{
+    m_concealmentEventsFilename = filename;
+    m_concealmentEventsText = renderText;
+}
+
+void EfmProcessor::setMetrics(const QString &filename)
+{
+    m_metricsFilename = filename;
+}
+
 void EfmProcessor::setDebug(bool audio, bool audioCorrection)
 {
     // Set the debug flags
     m_data24ToAudio.setShowDebug(audio);
     m_audioCorrection.setShowDebug(audioCorrection);
+    m_audioDeemphasis.setShowDebug(audio);
 }
\ No newline at end of file
@@ -33,9 +33,14 @@
 #include "decoders.h"
 #include "dec_data24toaudio.h"
 #include "dec_audiocorrection.h"
+#include "dec_audiodeemphasis.h"
 
 #include "writer_wav.h"
+#include "writer_flac.h"
 #include "writer_wav_metadata.h"
+#include "writer_concealment_events.h"
+#include "writer_cue.h"
+#include "writer_audio_metrics.h"
 
 #include "reader_data24section.h"
 
@@ -48,6 +53,11 @@ public:
     void setShowData(bool showAudio);
     void setOutputType(bool outputWavMetadata, bool noAudioConcealment, bool zeroPad);
     void setDebug(bool audio, bool audioCorrection);
+    void setMaxConcealmentRun(qint32 maxRunLength);
+    void setSplitTracks(bool splitTracks);
+    void setDeemphasis(bool deemphasis, bool highResolution);
+    void setConcealmentEvents(const QString &filename, bool renderText);
+    void setMetrics(const QString &filename);
     void showStatistics() const;
 
 private:
@@ -58,25 +68,54 @@ private:
     bool m_outputWavMetadata;
     bool m_noAudioConcealment;
     bool m_zeroPad;
+    SectionTime m_nextOutputTime;
+    QString m_concealmentEventsFilename;
+    bool m_concealmentEventsText;
+    QString m_metricsFilename;
+    bool m_splitTracks;
+    bool m_deemphasis;
+    bool m_highResolution;
+    qint32 m_currentTrack;
+    qint32 m_trackSections;     // Sections written to the current track file
+    qint32 m_trackIndex01;      // Offset of index 01 in the current track file (-1 if not found yet)
+    qint32 m_lastRelativeTime;  // Track-relative time of the last valid section in the track (-1 if none)
+    QString m_outputFilename;
 
     // IEC 60909-1999 Decoders
     Data24ToAudio m_data24ToAudio;
     AudioCorrection m_audioCorrection;
+    AudioDeemphasis m_audioDeemphasis;
 
     // Input file readers
     ReaderData24Section m_readerData24Section;
 
     // Output file writers
     WriterWav m_writerWav;
+    WriterFlac m_writerFlac;
+    bool m_outputFlac;
     WriterWavMetadata m_writerWavMetadata;
+    WriterConcealmentEvents m_writerConcealmentEvents;
+    WriterCue m_writerCue;
+    WriterAudioMetrics m_writerAudioMetrics;
 
     // Processing statistics
     struct AudioPipelineStatistics {
         qint64 data24ToAudioTime{0};
         qint64 audioCorrectionTime{0};
+        qint64 paddedSections{0};
     } m_audioPipelineStats;
 
-    void processAudioPipeline();
+    bool processAudioPipeline();
+    void writeConcealmentEvents();
+    bool outputSection(const AudioSection &audioSection);
+    bool writeAudio(const AudioSection &audioSection, const QVector<qint32> &highResolution);
+    void fillTimelineGap(const SectionMetadata &metadata);
+    bool splitTracks(const SectionMetadata &metadata);
+    void findTrackIndex(const SectionMetadata &metadata);
+    QString trackFilename(qint32 trackNumber) const;
+    bool openAudio(const QString &filename);
+    void closeAudio();
+    void closeOutput();
     void showAudioPipelineStatistics();
 };
 
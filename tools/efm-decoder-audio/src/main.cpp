@@ -70,10 +70,42 @@ int main(int argc, char *argv[])
                 QCoreApplication::translate("main", "Do not conceal errors in the audio data")),
         QCommandLineOption(
                 "zero-pad",
-                QCoreApplication::translate("main", "Zero pad the audio data from 00:00:00")),
+                QCoreApplication::translate("main", "Zero pad the audio data from 00:00:00 and fill any gaps so the output follows the disc time")),
+        QCommandLineOption(
+                "split-tracks",
+                QCoreApplication::translate("main", "Write one audio file per track (output_NN.wav) and a CUE sheet (output.cue)")),
     };
     parser.addOptions(outputTypeOptions);
 
+    // Options for de-emphasis and output resolution
+    QCommandLineOption deemphasisOption("deemphasis",
+                                        QCoreApplication::translate("main", "Apply de-emphasis to sections flagged as pre-emphasised in the Q-channel"));
+    parser.addOption(deemphasisOption);
+    QCommandLineOption output24BitOption("output-24bit",
+                                         QCoreApplication::translate("main", "Write 24-bit WAV samples (avoids requantising de-emphasised audio)"));
+    parser.addOption(output24BitOption);
+
+    // Option to bridge runs of bad samples by interpolation
+    QCommandLineOption concealRunsOption("conceal-runs",
+                                         QCoreApplication::translate("main", "Conceal runs of up to <length> consecutive bad samples per channel using cubic interpolation (1-16, default is single samples only)"),
+                                         QCoreApplication::translate("main", "length"));
+    parser.addOption(concealRunsOption);
+
+    // Options for recording audio concealment events
+    QCommandLineOption concealmentEventsOption("concealment-events",
+                                               QCoreApplication::translate("main", "Record each concealed or silenced sample to a compact binary event file"),
+                                               QCoreApplication::translate("main", "filename"));
+    parser.addOption(concealmentEventsOption);
+    QCommandLineOption concealmentEventsTextOption("concealment-events-text",
+                                                   QCoreApplication::translate("main", "Render the concealment events as text rather than binary records"));
+    parser.addOption(concealmentEventsTextOption);
+
+    // Option to write per-track and per-minute audio quality metrics
+    QCommandLineOption metricsJsonOption("metrics-json",
+                                         QCoreApplication::translate("main", "Write per-track and per-minute error and concealment metrics to a JSON file"),
+                                         QCoreApplication::translate("main", "filename"));
+    parser.addOption(metricsJsonOption);
+
     // Group of options for showing frame data
     QList<QCommandLineOption> displayFrameDataOptions = {
         QCommandLineOption("show-audio",
@@ -97,7 +129,7 @@ int main(int argc, char *argv[])
     parser.addPositionalArgument("input",
                                  QCoreApplication::translate("main", "Specify input Data24 Section file"));
     parser.addPositionalArgument("output",
-                                 QCoreApplication::translate("main", "Specify output wav file"));
+                                 QCoreApplication::translate("main", "Specify output wav file (use a .flac extension for FLAC output)"));
 
     // Process the command line options and arguments given by the user
     parser.process(app);
@@ -109,6 +141,21 @@ int main(int argc, char *argv[])
     bool outputWavMetadata = parser.isSet("audacity-labels");
     bool noAudioConcealment = parser.isSet("no-audio-concealment");
     bool zeroPad = parser.isSet("zero-pad");
+    bool splitTracks = parser.isSet("split-tracks");
+    bool deemphasis = parser.isSet(deemphasisOption);
+    bool output24Bit = parser.isSet(output24BitOption);
+    qint32 maxConcealmentRun = 0;
+    if (parser.isSet(concealRunsOption)) {
+        maxConcealmentRun = parser.value(concealRunsOption).toInt();
+        if (maxConcealmentRun < 1 || maxConcealmentRun > AudioConcealmentKernel::MaxRunLimit) {
+            // Quit with error
+            qCritical("Concealment run length must be between 1 and %d", AudioConcealmentKernel::MaxRunLimit);
+            return 1;
+        }
+    }
+    QString concealmentEventsFilename = parser.value(concealmentEventsOption);
+    bool concealmentEventsText = parser.isSet(concealmentEventsTextOption);
+    QString metricsFilename = parser.value(metricsJsonOption);
 
     // Check for frame data options
     bool showAudio = parser.isSet("show-audio");
@@ -142,6 +189,11 @@ int main(int argc, char *argv[])
     efmProcessor.setShowData(showAudio);
     efmProcessor.setOutputType(outputWavMetadata, noAudioConcealment, zeroPad);
     efmProcessor.setDebug(showAudioDebug, showAudioCorrectionDebug);
+    efmProcessor.setSplitTracks(splitTracks);
+    efmProcessor.setDeemphasis(deemphasis, output24Bit);
+    efmProcessor.setMaxConcealmentRun(maxConcealmentRun);
+    efmProcessor.setConcealmentEvents(concealmentEventsFilename, concealmentEventsText);
+    efmProcessor.setMetrics(metricsFilename);
 
     if (!efmProcessor.process(inputFilename, outputFilename)) {
         return 1;
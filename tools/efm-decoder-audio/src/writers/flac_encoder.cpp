@@ -0,0 +1,371 @@
+/************************************************************************
+
+    flac_encoder.cpp
+
+    efm-decoder-audio - EFM Data24 to Audio decoder
+    Copyright (C) 2025 Simon Inns
+
+    This file is part of ld-decode-tools.
+
+    This application is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+************************************************************************/
+
+#include "flac_encoder.h"
+
+#include <cstdlib>
+
+FlacBitWriter::FlacBitWriter(QByteArray &output) :
+    m_output(output),
+    m_accumulator(0),
+    m_bitCount(0)
+{}
+
+// Write the lower 'bits' bits of value (up to 32)
+void FlacBitWriter::writeBits(quint32 value, qint32 bits)
+{
+    if (bits == 0) return;
+    const quint64 mask = (bits == 32) ? 0xFFFFFFFFull : ((1ull << bits) - 1);
+    m_accumulator = (m_accumulator << bits) | (value & mask);
+    m_bitCount += bits;
+    while (m_bitCount >= 8) {
+        m_bitCount -= 8;
+        m_output.append(static_cast<char>((m_accumulator >> m_bitCount) & 0xFF));
+    }
+}
+
+void FlacBitWriter::writeSigned(qint32 value, qint32 bits)
+{
+    writeBits(static_cast<quint32>(value), bits);
+}
+
+// Write 'zeros' zero bits followed by a one bit
+void FlacBitWriter::writeUnary(quint32 zeros)
+{
+    while (zeros >= 32) {
+        writeBits(0, 32);
+        zeros -= 32;
+    }
+    writeBits(1, static_cast<qint32>(zeros) + 1);
+}
+
+void FlacBitWriter::writeRice(qint32 value, qint32 parameter)
+{
+    const quint32 folded = (static_cast<quint32>(value) << 1) ^ static_cast<quint32>(value >> 31);
+    writeUnary(folded >> parameter);
+    writeBits(folded, parameter);
+}
+
+void FlacBitWriter::alignToByte()
+{
+    if (m_bitCount > 0) writeBits(0, 8 - m_bitCount);
+}
+
+FlacEncoder::FlacEncoder()
+{
+    // CRC-8 (polynomial x^8 + x^2 + x + 1) and CRC-16 (x^16 + x^15 + x^2 + 1)
+    for (qint32 i = 0; i < 256; ++i) {
+        quint8 crc8 = static_cast<quint8>(i);
+        quint16 crc16 = static_cast<quint16>(i << 8);
+        for (qint32 bit = 0; bit < 8; ++bit) {
+            crc8 = static_cast<quint8>((crc8 & 0x80) ? (crc8 << 1) ^ 0x07 : (crc8 << 1));
+            crc16 = static_cast<quint16>((crc16 & 0x8000) ? (crc16 << 1) ^ 0x8005 : (crc16 << 1));
+        }
+        m_crc8Table[i] = crc8;
+        m_crc16Table[i] = crc16;
+    }
+}
+
+QByteArray FlacEncoder::streamHeader(quint32 minFrameSize, quint32 maxFrameSize, quint64 totalSamples,
+    const QByteArray &md5)
+{
+    QByteArray header;
+    header.reserve(StreamHeaderSize);
+    header.append("fLaC", 4);
+
+    FlacBitWriter writer(header);
+
+    // Metadata block header - last block, type 0 (STREAMINFO), 34 bytes
+    writer.writeBits(1, 1);
+    writer.writeBits(0, 7);
+    writer.writeBits(34, 24);
+
+    writer.writeBits(BlockSize, 16);
+    writer.writeBits(BlockSize, 16);
+    writer.writeBits(minFrameSize, 24);
+    writer.writeBits(maxFrameSize, 24);
+    writer.writeBits(SampleRate, 20);
+    writer.writeBits(Channels - 1, 3);
+    writer.writeBits(BitsPerSample - 1, 5);
+    writer.writeBits(static_cast<quint32>(totalSamples >> 32), 4);
+    writer.writeBits(static_cast<quint32>(totalSamples & 0xFFFFFFFF), 32);
+
+    QByteArray signature = md5.left(16);
+    if (signature.size() < 16) signature = QByteArray(16, 0);
+    header.append(signature);
+
+    return header;
+}
+
+void FlacEncoder::encodeFrame(const qint16 *samples, qint32 blockSize, quint32 frameNumber, QByteArray &output)
+{
+    if (blockSize < 1 || blockSize > BlockSize) {
+        qFatal("FlacEncoder::encodeFrame(): Block size of %d is out of range", blockSize);
+    }
+
+    // Split the interleaved samples into the candidate signals
+    for (qint32 i = 0; i < blockSize; ++i) {
+        const qint32 left = samples[i * 2];
+        const qint32 right = samples[i * 2 + 1];
+        m_signals[Left][i] = left;
+        m_signals[Right][i] = right;
+        m_signals[Mid][i] = (left + right) >> 1;
+        m_signals[Side][i] = left - right;
+    }
+
+    planSubframe(Left, blockSize, BitsPerSample);
+    planSubframe(Right, blockSize, BitsPerSample);
+    planSubframe(Mid, blockSize, BitsPerSample);
+    planSubframe(Side, blockSize, BitsPerSample + 1);
+
+    // Pick the channel assignment with the smallest estimated size
+    const quint64 independent = m_plans[Left].bits + m_plans[Right].bits;
+    const quint64 leftSide = m_plans[Left].bits + m_plans[Side].bits;
+    const quint64 sideRight = m_plans[Side].bits + m_plans[Right].bits;
+    const quint64 midSide = m_plans[Mid].bits + m_plans[Side].bits;
+
+    quint8 channelAssignment = 1; // Independent
+    qint32 first = Left;
+    qint32 second = Right;
+    quint64 best = independent;
+    if (leftSide < best) {
+        best = leftSide;
+        channelAssignment = 8;
+        first = Left;
+        second = Side;
+    }
+    if (sideRight < best) {
+        best = sideRight;
+        channelAssignment = 9;
+        first = Side;
+        second = Right;
+    }
+    if (midSide < best) {
+        channelAssignment = 10;
+        first = Mid;
+        second = Side;
+    }
+
+    // Frame header
+    const qint32 frameStart = output.size();
+    const bool standardBlockSize = (blockSize == BlockSize);
+    output.append(static_cast<char>(0xFF));
+    output.append(static_cast<char>(0xF8)); // Sync code, fixed block size
+    output.append(static_cast<char>((standardBlockSize ? 0xC0 : 0x70) | 0x09)); // Block size, 44.1kHz
+    output.append(static_cast<char>((channelAssignment << 4) | (4 << 1))); // Channels, 16 bits per sample
+    writeUtf8(output, frameNumber);
+    if (!standardBlockSize) {
+        output.append(static_cast<char>(((blockSize - 1) >> 8) & 0xFF));
+        output.append(static_cast<char>((blockSize - 1) & 0xFF));
+    }
+
+    quint8 crc8 = 0;
+    for (qint32 i = frameStart; i < output.size(); ++i) {
+        crc8 = m_crc8Table[crc8 ^ static_cast<quint8>(output.at(i))];
+    }
+    output.append(static_cast<char>(crc8));
+
+    // Subframes
+    FlacBitWriter writer(output);
+    writeSubframe(writer, first, blockSize, first == Side ? BitsPerSample + 1 : BitsPerSample);
+    writeSubframe(writer, second, blockSize, second == Side ? BitsPerSample + 1 : BitsPerSample);
+    writer.alignToByte();
+
+    // Frame footer
+    quint16 crc16 = 0;
+    for (qint32 i = frameStart; i < output.size(); ++i) {
+        crc16 = static_cast<quint16>((crc16 << 8) ^ m_crc16Table[(crc16 >> 8) ^ static_cast<quint8>(output.at(i))]);
+    }
+    output.append(static_cast<char>(crc16 >> 8));
+    output.append(static_cast<char>(crc16 & 0xFF));
+}
+
+// Choose the subframe type (and predictor order) for a signal and estimate its size
+void FlacEncoder::planSubframe(qint32 signal, qint32 blockSize, qint32 bitsPerSample)
+{
+    SubframePlan &plan = m_plans[signal];
+    const qint32 *x = m_signals[signal];
+
+    bool constant = true;
+    for (qint32 i = 1; i < blockSize && constant; ++i) constant = (x[i] == x[0]);
+    if (constant) {
+        plan.type = Constant;
+        plan.bits = 8 + bitsPerSample;
+        return;
+    }
+
+    plan.type = Verbatim;
+    plan.bits = 8 + static_cast<quint64>(blockSize) * bitsPerSample;
+    if (blockSize <= 4) return;
+
+    // Choose the fixed predictor order with the smallest total absolute residual
+    quint64 totals[5] = { 0, 0, 0, 0, 0 };
+    for (qint32 i = 4; i < blockSize; ++i) {
+        const qint32 e0 = x[i];
+        const qint32 e1 = e0 - x[i - 1];
+        const qint32 e2 = e1 - (x[i - 1] - x[i - 2]);
+        const qint32 e3 = e2 - (x[i - 1] - 2 * x[i - 2] + x[i - 3]);
+        const qint32 e4 = e3 - (x[i - 1] - 3 * x[i - 2] + 3 * x[i - 3] - x[i - 4]);
+        totals[0] += std::abs(e0);
+        totals[1] += std::abs(e1);
+        totals[2] += std::abs(e2);
+        totals[3] += std::abs(e3);
+        totals[4] += std::abs(e4);
+    }
+    qint32 order = 0;
+    for (qint32 i = 1; i < 5; ++i) {
+        if (totals[i] < totals[order]) order = i;
+    }
+
+    // Compute the residual for the chosen order
+    qint32 *residual = m_residuals[signal];
+    for (qint32 i = order; i < blockSize; ++i) {
+        switch (order) {
+        case 0: residual[i] = x[i]; break;
+        case 1: residual[i] = x[i] - x[i - 1]; break;
+        case 2: residual[i] = x[i] - 2 * x[i - 1] + x[i - 2]; break;
+        case 3: residual[i] = x[i] - 3 * x[i - 1] + 3 * x[i - 2] - x[i - 3]; break;
+        default: residual[i] = x[i] - 4 * x[i - 1] + 6 * x[i - 2] - 4 * x[i - 3] + x[i - 4]; break;
+        }
+    }
+
+    const quint64 verbatimBits = plan.bits;
+    planResidual(signal, blockSize, order);
+    const quint64 fixedBits = 8 + static_cast<quint64>(order) * bitsPerSample + plan.bits;
+    if (fixedBits < verbatimBits) {
+        plan.type = Fixed;
+        plan.order = order;
+        plan.bits = fixedBits;
+    } else {
+        plan.type = Verbatim;
+        plan.bits = verbatimBits;
+    }
+}
+
+// Choose the Rice partition order and parameters for a residual; the
+// estimated residual size in bits is left in the plan
+void FlacEncoder::planResidual(qint32 signal, qint32 blockSize, qint32 order)
+{
+    SubframePlan &plan = m_plans[signal];
+    const qint32 *residual = m_residuals[signal];
+
+    // The block must divide evenly into partitions, each larger than the order
+    qint32 maxPartitionOrder = 0;
+    while (maxPartitionOrder < MaxPartitionOrder && (blockSize % (2 << maxPartitionOrder)) == 0
+           && (blockSize >> (maxPartitionOrder + 1)) > order) {
+        ++maxPartitionOrder;
+    }
+
+    // Sum the folded residuals for the finest partitioning, then merge
+    // neighbouring partitions for each coarser order
+    quint64 sums[1 << MaxPartitionOrder];
+    const qint32 partitions = 1 << maxPartitionOrder;
+    const qint32 partitionSize = blockSize >> maxPartitionOrder;
+    for (qint32 p = 0; p < partitions; ++p) {
+        quint64 sum = 0;
+        const qint32 start = (p == 0) ? order : p * partitionSize;
+        for (qint32 i = start; i < (p + 1) * partitionSize; ++i) {
+            sum += (static_cast<quint32>(residual[i]) << 1) ^ static_cast<quint32>(residual[i] >> 31);
+        }
+        sums[p] = sum;
+    }
+
+    plan.bits = ~0ull;
+    for (qint32 partitionOrder = maxPartitionOrder; partitionOrder >= 0; --partitionOrder) {
+        const qint32 count = 1 << partitionOrder;
+        quint64 bits = 6; // Coding method and partition order
+        qint32 parameters[1 << MaxPartitionOrder];
+        for (qint32 p = 0; p < count; ++p) {
+            const quint64 samples = static_cast<quint64>(blockSize >> partitionOrder) - (p == 0 ? order : 0);
+            qint32 parameter = 0;
+            while (parameter < MaxRiceParameter && (samples << (parameter + 1)) < sums[p]) ++parameter;
+            parameters[p] = parameter;
+            bits += 4 + samples * (parameter + 1) + (sums[p] >> parameter);
+        }
+        if (bits < plan.bits) {
+            plan.bits = bits;
+            plan.partitionOrder = partitionOrder;
+            for (qint32 p = 0; p < count; ++p) plan.parameters[p] = parameters[p];
+        }
+
+        // Merge pairs of partitions for the next (coarser) order
+        for (qint32 p = 0; p < count / 2; ++p) sums[p] = sums[2 * p] + sums[2 * p + 1];
+    }
+}
+
+void FlacEncoder::writeSubframe(FlacBitWriter &writer, qint32 signal, qint32 blockSize, qint32 bitsPerSample) const
+{
+    const SubframePlan &plan = m_plans[signal];
+    const qint32 *x = m_signals[signal];
+
+    switch (plan.type) {
+    case Constant:
+        writer.writeBits(0x00, 8);
+        writer.writeSigned(x[0], bitsPerSample);
+        break;
+
+    case Verbatim:
+        writer.writeBits(0x02, 8);
+        for (qint32 i = 0; i < blockSize; ++i) writer.writeSigned(x[i], bitsPerSample);
+        break;
+
+    case Fixed: {
+        writer.writeBits(static_cast<quint32>(0x10 | (plan.order << 1)), 8);
+        for (qint32 i = 0; i < plan.order; ++i) writer.writeSigned(x[i], bitsPerSample);
+
+        // Residual using Rice coding with 4-bit parameters
+        const qint32 *residual = m_residuals[signal];
+        writer.writeBits(0, 2);
+        writer.writeBits(static_cast<quint32>(plan.partitionOrder), 4);
+        const qint32 partitionSize = blockSize >> plan.partitionOrder;
+        for (qint32 p = 0; p < (1 << plan.partitionOrder); ++p) {
+            const qint32 parameter = plan.parameters[p];
+            writer.writeBits(static_cast<quint32>(parameter), 4);
+            const qint32 start = (p == 0) ? plan.order : p * partitionSize;
+            for (qint32 i = start; i < (p + 1) * partitionSize; ++i) writer.writeRice(residual[i], parameter);
+        }
+        break;
+    }
+    }
+}
+
+// Frame numbers are coded using the extended UTF-8 scheme
+void FlacEncoder::writeUtf8(QByteArray &output, quint32 value)
+{
+    if (value < 0x80) {
+        output.append(static_cast<char>(value));
+        return;
+    }
+
+    qint32 continuationBytes = 1;
+    while (continuationBytes < 5 && value >= (1u << (6 * continuationBytes + 6 - continuationBytes))) {
+        ++continuationBytes;
+    }
+
+    const quint8 prefix = static_cast<quint8>(0xFF00 >> (continuationBytes + 1));
+    output.append(static_cast<char>(prefix | (value >> (6 * continuationBytes))));
+    for (qint32 i = continuationBytes - 1; i >= 0; --i) {
+        output.append(static_cast<char>(0x80 | ((value >> (6 * i)) & 0x3F)));
+    }
+}
@@ -0,0 +1,114 @@
+/************************************************************************
+
+    flac_encoder.h
+
+    efm-decoder-audio - EFM Data24 to Audio decoder
+    Copyright (C) 2025 Simon Inns
+
+    This file is part of ld-decode-tools.
+
+    This application is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+************************************************************************/
+
+#ifndef FLAC_ENCODER_H
+#define FLAC_ENCODER_H
+
+#include <QtGlobal>
+#include <QByteArray>
+
+// Appends an MSB-first bit stream to a byte array
+class FlacBitWriter
+{
+public:
+    FlacBitWriter(QByteArray &output);
+
+    void writeBits(quint32 value, qint32 bits);
+    void writeSigned(qint32 value, qint32 bits);
+    void writeUnary(quint32 zeros);
+    void writeRice(qint32 value, qint32 parameter);
+    void alignToByte();
+
+private:
+    QByteArray &m_output;
+    quint64 m_accumulator;
+    qint32 m_bitCount;
+};
+
+// Minimal FLAC encoder for 44.1kHz 16-bit stereo audio
+//
+// Each block is encoded with the best of the fixed (order 0 to 4) predictors
+// or verbatim, using partitioned Rice coding of the residual.  The channel
+// assignment (independent, left/side, side/right or mid/side) is chosen per
+// frame from the estimated encoded size.  All working storage is held in the
+// encoder so nothing is allocated per frame.
+class FlacEncoder
+{
+public:
+    enum {
+        BlockSize = 4096,
+        Channels = 2,
+        BitsPerSample = 16,
+        SampleRate = 44100,
+        StreamHeaderSize = 42,
+        MaxPartitionOrder = 6,
+        MaxRiceParameter = 14
+    };
+
+    FlacEncoder();
+
+    // The stream header is the "fLaC" marker and a STREAMINFO block
+    static QByteArray streamHeader(quint32 minFrameSize, quint32 maxFrameSize, quint64 totalSamples,
+        const QByteArray &md5);
+
+    // Encode blockSize (up to BlockSize) interleaved stereo samples as a frame
+    // and append it to output
+    void encodeFrame(const qint16 *samples, qint32 blockSize, quint32 frameNumber, QByteArray &output);
+
+private:
+    enum SubframeType {
+        Constant,
+        Verbatim,
+        Fixed
+    };
+
+    struct SubframePlan {
+        SubframeType type;
+        qint32 order;
+        qint32 partitionOrder;
+        qint32 parameters[1 << MaxPartitionOrder];
+        quint64 bits;
+    };
+
+    // Candidate signals: left, right, mid and side
+    enum {
+        Left = 0,
+        Right = 1,
+        Mid = 2,
+        Side = 3
+    };
+
+    qint32 m_signals[4][BlockSize];
+    qint32 m_residuals[4][BlockSize];
+    SubframePlan m_plans[4];
+    quint8 m_crc8Table[256];
+    quint16 m_crc16Table[256];
+
+    void planSubframe(qint32 signal, qint32 blockSize, qint32 bitsPerSample);
+    void planResidual(qint32 signal, qint32 blockSize, qint32 order);
+    void writeSubframe(FlacBitWriter &writer, qint32 signal, qint32 blockSize, qint32 bitsPerSample) const;
+    static void writeUtf8(QByteArray &output, quint32 value);
+};
+
+#endif // FLAC_ENCODER_H
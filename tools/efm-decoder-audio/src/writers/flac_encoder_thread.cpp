@@ -0,0 +1,89 @@
+/************************************************************************
+
+    flac_encoder_thread.cpp
+
+    efm-decoder-audio - EFM Data24 to Audio decoder
+    Copyright (C) 2025 Simon Inns
+
+    This file is part of ld-decode-tools.
+
+    This application is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+************************************************************************/
+
+#include "flac_encoder_thread.h"
+
+FlacEncoderThread::FlacEncoderThread(QFile &file) :
+    m_file(file),
+    m_md5(QCryptographicHash::Md5),
+    m_finished(false),
+    m_frameNumber(0),
+    m_minFrameSize(0),
+    m_maxFrameSize(0),
+    m_totalSamples(0)
+{}
+
+// Queue a block of up to FlacEncoder::BlockSize interleaved stereo samples
+void FlacEncoderThread::pushBlock(const QVector<qint16> &samples)
+{
+    QMutexLocker locker(&m_mutex);
+    while (m_blocks.size() >= MaxQueuedBlocks) m_spaceAvailable.wait(&m_mutex);
+    m_blocks.enqueue(samples);
+    m_blockAvailable.wakeOne();
+}
+
+// Signal that no more blocks will be queued; the thread exits once the
+// queue has been encoded
+void FlacEncoderThread::finish()
+{
+    QMutexLocker locker(&m_mutex);
+    m_finished = true;
+    m_blockAvailable.wakeOne();
+}
+
+void FlacEncoderThread::run()
+{
+    QByteArray buffer;
+    buffer.reserve(BufferSize + 64 * 1024);
+
+    while (true) {
+        QVector<qint16> samples;
+        {
+            QMutexLocker locker(&m_mutex);
+            while (m_blocks.isEmpty() && !m_finished) m_blockAvailable.wait(&m_mutex);
+            if (m_blocks.isEmpty()) break;
+            samples = m_blocks.dequeue();
+            m_spaceAvailable.wakeOne();
+        }
+
+        // The MD5 signature is of the little-endian interleaved samples
+        m_md5.addData(reinterpret_cast<const char *>(samples.constData()), samples.size() * sizeof(qint16));
+
+        const qint32 blockSize = samples.size() / FlacEncoder::Channels;
+        const qint32 frameStart = buffer.size();
+        m_encoder.encodeFrame(samples.constData(), blockSize, m_frameNumber++, buffer);
+
+        const quint32 frameSize = static_cast<quint32>(buffer.size() - frameStart);
+        if (m_minFrameSize == 0 || frameSize < m_minFrameSize) m_minFrameSize = frameSize;
+        if (frameSize > m_maxFrameSize) m_maxFrameSize = frameSize;
+        m_totalSamples += blockSize;
+
+        if (buffer.size() >= BufferSize) {
+            m_file.write(buffer);
+            buffer.resize(0); // Keeps the reserved capacity
+        }
+    }
+
+    if (!buffer.isEmpty()) m_file.write(buffer);
+}
@@ -0,0 +1,81 @@
+/************************************************************************
+
+    flac_encoder_thread.h
+
+    efm-decoder-audio - EFM Data24 to Audio decoder
+    Copyright (C) 2025 Simon Inns
+
+    This file is part of ld-decode-tools.
+
+    This application is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+************************************************************************/
+
+#ifndef FLAC_ENCODER_THREAD_H
+#define FLAC_ENCODER_THREAD_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+#include <QVector>
+#include <QByteArray>
+#include <QFile>
+#include <QCryptographicHash>
+
+#include "flac_encoder.h"
+
+// Worker thread that FLAC encodes blocks of interleaved samples and writes
+// the frames to an already open file.  Blocks are queued by the producer
+// (which waits if the encoder falls too far behind) and the encoded frames
+// are gathered in a write-behind buffer
+class FlacEncoderThread : public QThread
+{
+public:
+    enum {
+        MaxQueuedBlocks = 32,
+        BufferSize = 4 * 1024 * 1024
+    };
+
+    FlacEncoderThread(QFile &file);
+
+    void pushBlock(const QVector<qint16> &samples);
+    void finish();
+
+    quint32 minFrameSize() const { return m_minFrameSize; }
+    quint32 maxFrameSize() const { return m_maxFrameSize; }
+    quint64 totalSamples() const { return m_totalSamples; }
+    QByteArray md5() const { return m_md5.result(); }
+
+protected:
+    void run() override;
+
+private:
+    QFile &m_file;
+    FlacEncoder m_encoder;
+    QCryptographicHash m_md5;
+
+    QMutex m_mutex;
+    QWaitCondition m_blockAvailable;
+    QWaitCondition m_spaceAvailable;
+    QQueue<QVector<qint16>> m_blocks;
+    bool m_finished;
+
+    quint32 m_frameNumber;
+    quint32 m_minFrameSize;
+    quint32 m_maxFrameSize;
+    quint64 m_totalSamples;
+};
+
+#endif // FLAC_ENCODER_THREAD_H
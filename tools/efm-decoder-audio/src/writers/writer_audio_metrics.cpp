@@ -0,0 +1,175 @@
+/************************************************************************
+
+    writer_audio_metrics.cpp
+
+    efm-decoder-audio - EFM Data24 to Audio decoder
+    Copyright (C) 2025 Simon Inns
+
+    This file is part of ld-decode-tools.
+
+    This application is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+************************************************************************/
+
+#include "writer_audio_metrics.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QtAlgorithms>
+#include <cstring>
+
+// This writer class writes audio quality metrics to a JSON file
+//
+// Sample counts are of mono samples.  Invalid samples are those in error
+// before concealment (i.e. concealed plus silenced), and a C2 failed frame
+// is a 12 sample frame with at least one invalid sample
+
+WriterAudioMetrics::WriterAudioMetrics() :
+    m_noAudioConcealment(false)
+{
+    std::memset(&m_total, 0, sizeof(m_total));
+    std::memset(m_minutes, 0, sizeof(m_minutes));
+    std::memset(m_tracks, 0, sizeof(m_tracks));
+    std::memset(m_invalidSampleHistogram, 0, sizeof(m_invalidSampleHistogram));
+}
+
+WriterAudioMetrics::~WriterAudioMetrics()
+{
+    if (m_file.isOpen()) {
+        close();
+    }
+}
+
+bool WriterAudioMetrics::open(const QString &filename, bool noAudioConcealment)
+{
+    m_file.setFileName(filename);
+    if (!m_file.open(QIODevice::WriteOnly)) {
+        qCritical() << "WriterAudioMetrics::open() - Could not open file" << filename << "for writing";
+        return false;
+    }
+    qDebug() << "WriterAudioMetrics::open() - Opened file" << filename << "for metrics writing";
+
+    // Without concealment, errors are passed through rather than silenced
+    m_noAudioConcealment = noAudioConcealment;
+
+    return true;
+}
+
+void WriterAudioMetrics::write(const AudioSection &audioSection)
+{
+    if (!m_file.isOpen()) {
+        qCritical() << "WriterAudioMetrics::write() - File is not open for writing";
+        return;
+    }
+
+    Counts section;
+    std::memset(&section, 0, sizeof(section));
+    section.sections = 1;
+    section.samples = 98 * 12;
+
+    qint64 errorSamples = 0;
+    for (int index = 0; index < 98; ++index) {
+        const Audio audio = audioSection.frame(index);
+        const QVector<bool> errors = audio.errorData();
+        const QVector<bool> concealed = audio.concealedData();
+
+        qint32 frameErrors = 0;
+        qint32 frameConcealed = 0;
+        for (int i = 0; i < 12; ++i) {
+            frameErrors += errors.at(i);
+            frameConcealed += concealed.at(i);
+        }
+        errorSamples += frameErrors;
+        section.concealedSamples += frameConcealed;
+        if (frameErrors + frameConcealed) ++section.c2FailedFrames;
+    }
+    section.invalidSamples = errorSamples + section.concealedSamples;
+    if (!m_noAudioConcealment) section.silencedSamples = errorSamples;
+
+    const qint32 minute = qBound(0, audioSection.metadata.absoluteSectionTime().minutes(),
+        static_cast<qint32>(MaxMinutes - 1));
+    add(m_total, section);
+    add(m_minutes[minute], section);
+    add(m_tracks[audioSection.metadata.trackNumber()], section);
+
+    // Bucket 0 is error-free sections, bucket n covers 2^(n-1) to 2^n - 1
+    // invalid samples (the last bucket is open ended)
+    qint32 bucket = 0;
+    for (qint64 invalid = section.invalidSamples; invalid > 0 && bucket < HistogramBuckets - 1; invalid >>= 1) ++bucket;
+    ++m_invalidSampleHistogram[bucket];
+}
+
+void WriterAudioMetrics::close()
+{
+    if (!m_file.isOpen()) {
+        return;
+    }
+
+    QJsonObject root;
+    root.insert("totals", toJson(m_total));
+
+    QJsonArray tracks;
+    for (int track = 0; track < MaxTracks; ++track) {
+        if (m_tracks[track].sections == 0) continue;
+        QJsonObject entry = toJson(m_tracks[track]);
+        entry.insert("track", track);
+        tracks.append(entry);
+    }
+    root.insert("tracks", tracks);
+
+    QJsonArray minutes;
+    for (int minute = 0; minute < MaxMinutes; ++minute) {
+        if (m_minutes[minute].sections == 0) continue;
+        QJsonObject entry = toJson(m_minutes[minute]);
+        entry.insert("minute", minute);
+        minutes.append(entry);
+    }
+    root.insert("minutes", minutes);
+
+    QJsonArray histogram;
+    for (int bucket = 0; bucket < HistogramBuckets; ++bucket) {
+        QJsonObject entry;
+        entry.insert("minInvalidSamples", bucket == 0 ? 0 : (1 << (bucket - 1)));
+        if (bucket < HistogramBuckets - 1) entry.insert("maxInvalidSamples", (1 << bucket) - 1);
+        entry.insert("sections", m_invalidSampleHistogram[bucket]);
+        histogram.append(entry);
+    }
+    root.insert("sectionInvalidSampleHistogram", histogram);
+
+    m_file.write(QJsonDocument(root).toJson(QJsonDocument::Indented));
+    m_file.close();
+    qDebug() << "WriterAudioMetrics::close(): Closed the metrics file" << m_file.fileName();
+}
+
+void WriterAudioMetrics::add(Counts &counts, const Counts &section)
+{
+    counts.sections += section.sections;
+    counts.samples += section.samples;
+    counts.invalidSamples += section.invalidSamples;
+    counts.concealedSamples += section.concealedSamples;
+    counts.silencedSamples += section.silencedSamples;
+    counts.c2FailedFrames += section.c2FailedFrames;
+}
+
+QJsonObject WriterAudioMetrics::toJson(const Counts &counts)
+{
+    QJsonObject object;
+    object.insert("sections", counts.sections);
+    object.insert("samples", counts.samples);
+    object.insert("invalidSamples", counts.invalidSamples);
+    object.insert("concealedSamples", counts.concealedSamples);
+    object.insert("silencedSamples", counts.silencedSamples);
+    object.insert("c2FailedFrames", counts.c2FailedFrames);
+    return object;
+}
@@ -0,0 +1,77 @@
+/************************************************************************
+
+    writer_audio_metrics.h
+
+    efm-decoder-audio - EFM Data24 to Audio decoder
+    Copyright (C) 2025 Simon Inns
+
+    This file is part of ld-decode-tools.
+
+    This application is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+************************************************************************/
+
+#ifndef WRITER_AUDIO_METRICS_H
+#define WRITER_AUDIO_METRICS_H
+
+#include <QString>
+#include <QDebug>
+#include <QFile>
+#include <QJsonObject>
+
+#include "section.h"
+
+// Collects audio quality metrics per track and per minute of disc time (and
+// a histogram of invalid samples per section) into fixed-size tables, and
+// writes them as JSON when closed
+class WriterAudioMetrics
+{
+public:
+    WriterAudioMetrics();
+    ~WriterAudioMetrics();
+
+    bool open(const QString &filename, bool noAudioConcealment);
+    void write(const AudioSection &audioSection);
+    void close();
+    bool isOpen() const { return m_file.isOpen(); };
+
+private:
+    enum {
+        MaxMinutes = 100,
+        MaxTracks = 256,
+        HistogramBuckets = 12
+    };
+
+    struct Counts {
+        qint64 sections;
+        qint64 samples;
+        qint64 invalidSamples;
+        qint64 concealedSamples;
+        qint64 silencedSamples;
+        qint64 c2FailedFrames;
+    };
+
+    QFile m_file;
+    bool m_noAudioConcealment;
+
+    Counts m_total;
+    Counts m_minutes[MaxMinutes];
+    Counts m_tracks[MaxTracks];
+    qint64 m_invalidSampleHistogram[HistogramBuckets];
+
+    static void add(Counts &counts, const Counts &section);
+    static QJsonObject toJson(const Counts &counts);
+};
+
+#endif // WRITER_AUDIO_METRICS_H
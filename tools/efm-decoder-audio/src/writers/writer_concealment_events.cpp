@@ -0,0 +1,129 @@
+/************************************************************************
+
+    writer_concealment_events.cpp
+
+    efm-decoder-audio - EFM Data24 to Audio decoder
+    Copyright (C) 2025 Simon Inns
+
+    This file is part of ld-decode-tools.
+
+    This application is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+************************************************************************/
+
+#include "writer_concealment_events.h"
+
+// This writer class writes audio concealment events to a file.  Events are
+// gathered in a memory buffer and written to disc in large blocks
+
+static const qint32 bufferFlushSize = 256 * 1024;
+
+WriterConcealmentEvents::WriterConcealmentEvents() :
+    m_renderText(false),
+    m_eventCount(0)
+{}
+
+WriterConcealmentEvents::~WriterConcealmentEvents()
+{
+    if (m_file.isOpen()) {
+        close();
+    }
+}
+
+bool WriterConcealmentEvents::open(const QString &filename, bool renderText)
+{
+    m_renderText = renderText;
+    m_eventCount = 0;
+    m_buffer.clear();
+    m_buffer.reserve(bufferFlushSize + 1024);
+
+    m_file.setFileName(filename);
+    if (!m_file.open(QIODevice::WriteOnly)) {
+        qCritical() << "WriterConcealmentEvents::open() - Could not open file" << filename << "for writing";
+        return false;
+    }
+    qDebug() << "WriterConcealmentEvents::open() - Opened file" << filename << "for concealment event writing";
+
+    if (m_renderText) {
+        m_buffer.append("# time frame sample channel action\n");
+    } else {
+        m_buffer.append("ECEV", 4);
+    }
+
+    return true;
+}
+
+void WriterConcealmentEvents::write(const QVector<ConcealmentEvent> &events)
+{
+    if (!m_file.isOpen()) {
+        qCritical() << "WriterConcealmentEvents::write() - File is not open for writing";
+        return;
+    }
+
+    for (const ConcealmentEvent &event : events) {
+        if (m_renderText) appendText(event);
+        else appendBinary(event);
+    }
+    m_eventCount += events.size();
+
+    if (m_buffer.size() >= bufferFlushSize) flush();
+}
+
+void WriterConcealmentEvents::close()
+{
+    if (!m_file.isOpen()) {
+        return;
+    }
+
+    flush();
+    m_file.close();
+    qDebug() << "WriterConcealmentEvents::close(): Closed the concealment event file after writing"
+             << m_eventCount << "events";
+}
+
+void WriterConcealmentEvents::appendBinary(const ConcealmentEvent &event)
+{
+    const quint32 sectionTime = static_cast<quint32>(event.sectionTime);
+    const char record[8] = {
+        static_cast<char>(sectionTime & 0xFF),
+        static_cast<char>((sectionTime >> 8) & 0xFF),
+        static_cast<char>((sectionTime >> 16) & 0xFF),
+        static_cast<char>((sectionTime >> 24) & 0xFF),
+        static_cast<char>(event.frame),
+        static_cast<char>(event.sample),
+        static_cast<char>(event.channel),
+        static_cast<char>(event.action)
+    };
+    m_buffer.append(record, 8);
+}
+
+// Render an event as text, e.g. "12:34:56 12 3 Left Concealed"
+void WriterConcealmentEvents::appendText(const ConcealmentEvent &event)
+{
+    SectionTime time(event.sectionTime);
+    QString line = QString("%1 %2 %3 %4 %5\n")
+        .arg(time.toString())
+        .arg(event.frame)
+        .arg(event.sample)
+        .arg(event.channel == 0 ? "Left" : "Right")
+        .arg(event.action == ConcealmentEvent::Concealed ? "Concealed" : "Silenced");
+    m_buffer.append(line.toLatin1());
+}
+
+void WriterConcealmentEvents::flush()
+{
+    if (m_buffer.isEmpty()) return;
+    m_file.write(m_buffer);
+    m_buffer.resize(0); // Keeps the reserved capacity
+}
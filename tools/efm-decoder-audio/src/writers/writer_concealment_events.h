@@ -0,0 +1,64 @@
+/************************************************************************
+
+    writer_concealment_events.h
+
+    efm-decoder-audio - EFM Data24 to Audio decoder
+    Copyright (C) 2025 Simon Inns
+
+    This file is part of ld-decode-tools.
+
+    This application is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+************************************************************************/
+
+#ifndef WRITER_CONCEALMENT_EVENTS_H
+#define WRITER_CONCEALMENT_EVENTS_H
+
+#include <QString>
+#include <QDebug>
+#include <QFile>
+#include <QByteArray>
+
+#include "dec_audiocorrection.h"
+
+// Writes audio concealment events either as compact binary records or,
+// optionally, rendered as one line of text per event.
+//
+// Binary format: a 4 byte "ECEV" magic followed by 8 byte records of
+// absolute section time (qint32 frames, little-endian), frame, sample,
+// channel and action (one byte each)
+class WriterConcealmentEvents
+{
+public:
+    WriterConcealmentEvents();
+    ~WriterConcealmentEvents();
+
+    bool open(const QString &filename, bool renderText);
+    void write(const QVector<ConcealmentEvent> &events);
+    void close();
+    qint64 eventCount() const { return m_eventCount; }
+    bool isOpen() const { return m_file.isOpen(); };
+
+private:
+    QFile m_file;
+    bool m_renderText;
+    qint64 m_eventCount;
+    QByteArray m_buffer;
+
+    void appendBinary(const ConcealmentEvent &event);
+    void appendText(const ConcealmentEvent &event);
+    void flush();
+};
+
+#endif // WRITER_CONCEALMENT_EVENTS_H
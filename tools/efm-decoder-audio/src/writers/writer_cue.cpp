@@ -0,0 +1,92 @@
+/************************************************************************
+
+    writer_cue.cpp
+
+    efm-decoder-audio - EFM Data24 to Audio decoder
+    Copyright (C) 2025 Simon Inns
+
+    This file is part of ld-decode-tools.
+
+    This application is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+************************************************************************/
+
+#include "writer_cue.h"
+
+#include <QFileInfo>
+
+#include "section_metadata.h"
+
+// This writer class writes a CUE sheet for track split audio output
+
+WriterCue::WriterCue() { }
+
+WriterCue::~WriterCue()
+{
+    if (m_file.isOpen()) {
+        m_file.close();
+    }
+}
+
+bool WriterCue::open(const QString &filename)
+{
+    m_file.setFileName(filename);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        qCritical() << "WriterCue::open() - Could not open file" << filename << "for writing";
+        return false;
+    }
+    qDebug() << "WriterCue::open() - Opened file" << filename << "for CUE sheet writing";
+
+    m_file.write("REM COMMENT \"efm-decoder-audio\"\n");
+
+    return true;
+}
+
+// Each track is in its own file.  The file is referenced relative to the CUE
+// sheet and the track's indexes are added with addIndex()
+void WriterCue::addTrack(quint8 trackNumber, const QString &audioFilename, bool preemphasis)
+{
+    if (!m_file.isOpen()) {
+        qCritical() << "WriterCue::addTrack() - File is not open for writing";
+        return;
+    }
+
+    QString entry = QString("FILE \"%1\" WAVE\n").arg(QFileInfo(audioFilename).fileName());
+    entry += QString("  TRACK %1 AUDIO\n").arg(trackNumber, 2, 10, QChar('0'));
+    if (preemphasis) entry += "    FLAGS PRE\n";
+    m_file.write(entry.toUtf8());
+}
+
+// Add an index to the last track, the position is in sections (frames) from
+// the start of the track's file
+void WriterCue::addIndex(quint8 index, qint32 position)
+{
+    if (!m_file.isOpen()) {
+        qCritical() << "WriterCue::addIndex() - File is not open for writing";
+        return;
+    }
+
+    const QString entry = QString("    INDEX %1 %2\n").arg(index, 2, 10, QChar('0')).arg(SectionTime(position).toString());
+    m_file.write(entry.toUtf8());
+}
+
+void WriterCue::close()
+{
+    if (!m_file.isOpen()) {
+        return;
+    }
+
+    m_file.close();
+    qDebug() << "WriterCue::close(): Closed the CUE sheet" << m_file.fileName();
+}
@@ -0,0 +1,138 @@
+/************************************************************************
+
+    writer_flac.cpp
+
+    efm-decoder-audio - EFM Data24 to Audio decoder
+    Copyright (C) 2025 Simon Inns
+
+    This file is part of ld-decode-tools.
+
+    This application is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+************************************************************************/
+
+#include "writer_flac.h"
+
+// This writer class writes audio data to a file in FLAC format
+// The encoding is performed on a separate thread so that it overlaps
+// with the decoding
+
+WriterFlac::WriterFlac() :
+    m_encoderThread(nullptr)
+{}
+
+WriterFlac::~WriterFlac()
+{
+    if (m_file.isOpen()) {
+        close();
+    }
+}
+
+bool WriterFlac::open(const QString &filename)
+{
+    m_file.setFileName(filename);
+    if (!m_file.open(QIODevice::WriteOnly)) {
+        qCritical() << "WriterFlac::open() - Could not open file" << filename << "for writing";
+        return false;
+    }
+    qDebug() << "WriterFlac::open() - Opened file" << filename << "for data writing";
+
+    // Write a placeholder stream header (we will fill this in later once we
+    // know the number of samples and the frame sizes)
+    m_file.write(FlacEncoder::streamHeader(0, 0, 0, QByteArray()));
+
+    m_block.clear();
+    m_block.reserve(FlacEncoder::BlockSize * FlacEncoder::Channels);
+
+    m_encoderThread = new FlacEncoderThread(m_file);
+    m_encoderThread->start();
+
+    return true;
+}
+
+void WriterFlac::write(const AudioSection &audioSection)
+{
+    if (!m_file.isOpen()) {
+        qCritical() << "WriterFlac::write() - File is not open for writing";
+        return;
+    }
+
+    // Gather the 98 frames of the section into encoder blocks
+    for (int index = 0; index < 98; ++index) {
+        const Audio audio = audioSection.frame(index);
+        const QVector<qint16> data = audio.data();
+        const qint32 blockSamples = FlacEncoder::BlockSize * FlacEncoder::Channels;
+
+        for (qint32 i = 0; i < data.size();) {
+            const qint32 count = qMin(data.size() - i, blockSamples - m_block.size());
+            m_block.append(data.mid(i, count));
+            i += count;
+
+            if (m_block.size() == blockSamples) {
+                m_encoderThread->pushBlock(m_block);
+                m_block.clear();
+                m_block.reserve(blockSamples);
+            }
+        }
+    }
+}
+
+// Append silence (which encodes as constant subframes)
+void WriterFlac::writeSilence(qint64 stereoSamples)
+{
+    if (!m_file.isOpen()) {
+        qCritical() << "WriterFlac::writeSilence() - File is not open for writing";
+        return;
+    }
+
+    const qint32 blockSamples = FlacEncoder::BlockSize * FlacEncoder::Channels;
+    qint64 remaining = stereoSamples * FlacEncoder::Channels;
+    while (remaining > 0) {
+        const qint32 count = static_cast<qint32>(qMin(remaining, static_cast<qint64>(blockSamples - m_block.size())));
+        m_block.insert(m_block.size(), count, 0);
+        remaining -= count;
+
+        if (m_block.size() == blockSamples) {
+            m_encoderThread->pushBlock(m_block);
+            m_block.clear();
+            m_block.reserve(blockSamples);
+        }
+    }
+}
+
+void WriterFlac::close()
+{
+    if (!m_file.isOpen()) {
+        return;
+    }
+
+    // Encode any remaining samples and wait for the encoder to finish
+    if (!m_block.isEmpty()) m_encoderThread->pushBlock(m_block);
+    m_block.clear();
+    m_encoderThread->finish();
+    m_encoderThread->wait();
+
+    // Fill out the stream header
+    qDebug() << "WriterFlac::close(): Filling out the FLAC stream header before closing the file";
+    m_file.seek(0);
+    m_file.write(FlacEncoder::streamHeader(m_encoderThread->minFrameSize(), m_encoderThread->maxFrameSize(),
+        m_encoderThread->totalSamples(), m_encoderThread->md5()));
+
+    delete m_encoderThread;
+    m_encoderThread = nullptr;
+
+    // Now close the file
+    m_file.close();
+    qDebug() << "WriterFlac::close(): Closed the FLAC file" << m_file.fileName();
+}
@@ -0,0 +1,54 @@
+/************************************************************************
+
+    writer_flac.h
+
+    efm-decoder-audio - EFM Data24 to Audio decoder
+    Copyright (C) 2025 Simon Inns
+
+    This file is part of ld-decode-tools.
+
+    This application is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+************************************************************************/
+
+#ifndef WRITER_FLAC_H
+#define WRITER_FLAC_H
+
+#include <QString>
+#include <QDebug>
+#include <QFile>
+#include <QVector>
+
+#include "section.h"
+#include "flac_encoder_thread.h"
+
+class WriterFlac
+{
+public:
+    WriterFlac();
+    ~WriterFlac();
+
+    bool open(const QString &filename);
+    void write(const AudioSection &audioSection);
+    void writeSilence(qint64 stereoSamples);
+    void close();
+    bool isOpen() const { return m_file.isOpen(); };
+
+private:
+    QFile m_file;
+    FlacEncoderThread *m_encoderThread;
+    QVector<qint16> m_block;
+};
+
+#endif // WRITER_FLAC_H
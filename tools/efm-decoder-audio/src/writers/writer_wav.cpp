@@ -24,18 +24,55 @@
 
 #include "writer_wav.h"
 
+#include <cstring>
+
 // This writer class writes audio data to a file in WAV format
 // This is used when the output is stereo audio data
+//
+// The header reserves space (as a JUNK chunk) for an RF64 ds64 chunk so that,
+// if more than 4GiB of audio is written, the file can be converted to RF64
+// (EBU Tech 3306) when it is closed without moving the audio data
+
+// Header layout: RIFF (12) + JUNK/ds64 (8 + 28) + fmt (8 + 16) + data (8)
+static const qint32 wavHeaderSize = 80;
+static const qint32 ds64ChunkSize = 28;
 
-WriterWav::WriterWav() { }
+static void putLe16(char *p, quint16 value)
+{
+    p[0] = static_cast<char>(value & 0xFF);
+    p[1] = static_cast<char>(value >> 8);
+}
+
+static void putLe32(char *p, quint32 value)
+{
+    putLe16(p, static_cast<quint16>(value & 0xFFFF));
+    putLe16(p + 2, static_cast<quint16>(value >> 16));
+}
+
+static void putLe64(char *p, quint64 value)
+{
+    putLe32(p, static_cast<quint32>(value & 0xFFFFFFFF));
+    putLe32(p + 4, static_cast<quint32>(value >> 32));
+}
+
+WriterWav::WriterWav() :
+    m_dataSize(0),
+    m_highResolution(false)
+{}
 
 WriterWav::~WriterWav()
 {
     if (m_file.isOpen()) {
-        m_file.close();
+        close();
     }
 }
 
+// Write 24-bit rather than 16-bit samples (must be set before the file is opened)
+void WriterWav::setHighResolution(bool highResolution)
+{
+    m_highResolution = highResolution;
+}
+
 bool WriterWav::open(const QString &filename)
 {
     m_file.setFileName(filename);
@@ -45,10 +82,13 @@ bool WriterWav::open(const QString &filename)
     }
     qDebug() << "WriterWav::open() - Opened file" << filename << "for data writing";
 
-    // Add 44 bytes of blank header data to the file
-    // (we will fill this in later once we know the size of the data)
-    QByteArray header(44, 0);
-    m_file.write(header);
+    m_dataSize = 0;
+    m_buffer.clear();
+    m_buffer.reserve(BufferSize);
+
+    // Write a placeholder header (we will fill this in later once we know
+    // the size of the data)
+    writeHeader(false);
 
     return true;
 }
@@ -62,10 +102,64 @@ void WriterWav::write(const AudioSection &audioSection)
 
     // Each Audio section contains 98 frames that we need to write to the output file
     for (int index = 0; index < 98; ++index) {
-        Audio audio = audioSection.frame(index);
-        m_file.write(reinterpret_cast<const char *>(audio.data().data()),
-                     audio.frameSize() * sizeof(qint16));
+        const Audio audio = audioSection.frame(index);
+        const QVector<qint16> data = audio.data();
+        m_buffer.append(reinterpret_cast<const char *>(data.constData()), data.size() * sizeof(qint16));
+    }
+
+    if (m_buffer.size() >= BufferSize - 98 * 12 * static_cast<qint32>(sizeof(qint16))) flush();
+}
+
+// Append silence without buffering it.  The file is extended in one step,
+// which leaves a hole on filesystems that support sparse files (and is
+// zero-filled by the filesystem otherwise); if that fails the zeros are
+// written in large blocks
+void WriterWav::writeSilence(qint64 stereoSamples)
+{
+    if (!m_file.isOpen()) {
+        qCritical() << "WriterWav::writeSilence() - File is not open for writing";
+        return;
+    }
+    if (stereoSamples <= 0) return;
+
+    flush();
+
+    const qint64 bytes = stereoSamples * 2 * (m_highResolution ? 3 : 2);
+    const qint64 end = wavHeaderSize + m_dataSize + bytes;
+    if (m_file.resize(end) && m_file.seek(end)) {
+        m_dataSize += bytes;
+        return;
+    }
+
+    qDebug() << "WriterWav::writeSilence() - Could not extend the file, writing zeros instead";
+    m_file.seek(wavHeaderSize + m_dataSize);
+    const QByteArray zeros(BufferSize, 0);
+    for (qint64 remaining = bytes; remaining > 0; remaining -= zeros.size()) {
+        const qint64 count = qMin(remaining, static_cast<qint64>(zeros.size()));
+        m_file.write(zeros.constData(), count);
     }
+    m_dataSize += bytes;
+}
+
+// Write a section of 24-bit samples (held in the lower 24 bits of each value)
+void WriterWav::write(const QVector<qint32> &samples)
+{
+    if (!m_file.isOpen()) {
+        qCritical() << "WriterWav::write() - File is not open for writing";
+        return;
+    }
+
+    const qint32 start = m_buffer.size();
+    m_buffer.resize(start + samples.size() * 3);
+    char *output = m_buffer.data() + start;
+    for (qint32 i = 0; i < samples.size(); ++i) {
+        const quint32 sample = static_cast<quint32>(samples.at(i));
+        output[i * 3] = static_cast<char>(sample & 0xFF);
+        output[i * 3 + 1] = static_cast<char>((sample >> 8) & 0xFF);
+        output[i * 3 + 2] = static_cast<char>((sample >> 16) & 0xFF);
+    }
+
+    if (m_buffer.size() >= BufferSize - 98 * 12 * 3) flush();
 }
 
 void WriterWav::close()
@@ -74,36 +168,14 @@ void WriterWav::close()
         return;
     }
 
-    // Fill out the WAV header
-    qDebug() << "WriterWav::close(): Filling out the WAV header before closing the wav file";
-
-    // WAV file header
-    struct WAVHeader
-    {
-        char riff[4] = { 'R', 'I', 'F', 'F' };
-        quint32 chunkSize;
-        char wave[4] = { 'W', 'A', 'V', 'E' };
-        char fmt[4] = { 'f', 'm', 't', ' ' };
-        quint32 subchunk1Size = 16; // PCM
-        quint16 audioFormat = 1; // PCM
-        quint16 numChannels = 2; // Stereo
-        quint32 sampleRate = 44100; // 44.1kHz
-        quint32 byteRate;
-        quint16 blockAlign;
-        quint16 bitsPerSample = 16; // 16 bits
-        char data[4] = { 'd', 'a', 't', 'a' };
-        quint32 subchunk2Size;
-    };
-
-    WAVHeader header;
-    header.chunkSize = 36 + m_file.size();
-    header.byteRate = header.sampleRate * header.numChannels * header.bitsPerSample / 8;
-    header.blockAlign = header.numChannels * header.bitsPerSample / 8;
-    header.subchunk2Size = m_file.size();
-
-    // Move to the beginning of the file to write the header
+    flush();
+
+    // Fill out the WAV header, using RF64 if the sizes do not fit in 32 bits
+    const bool rf64 = m_dataSize + wavHeaderSize - 8 > 0xFFFFFFFFll;
+    qDebug() << "WriterWav::close(): Filling out the" << (rf64 ? "RF64" : "WAV")
+             << "header before closing the wav file";
     m_file.seek(0);
-    m_file.write(reinterpret_cast<const char *>(&header), sizeof(WAVHeader));
+    writeHeader(rf64);
 
     // Now close the file
     m_file.close();
@@ -113,8 +185,62 @@ void WriterWav::close()
 qint64 WriterWav::size() const
 {
     if (m_file.isOpen()) {
-        return m_file.size();
+        return wavHeaderSize + m_dataSize;
     }
 
     return 0;
-}
\ No newline at end of file
+}
+
+void WriterWav::flush()
+{
+    if (m_buffer.isEmpty()) return;
+
+    if (m_file.write(m_buffer) != m_buffer.size()) {
+        qCritical() << "WriterWav::flush() - Failed to write to" << m_file.fileName();
+    }
+    m_dataSize += m_buffer.size();
+    m_buffer.resize(0); // Keeps the reserved capacity
+}
+
+// Write the 80 byte header at the current file position
+void WriterWav::writeHeader(bool rf64)
+{
+    const quint16 numChannels = 2;
+    const quint32 sampleRate = 44100;
+    const quint16 bitsPerSample = m_highResolution ? 24 : 16;
+    const quint16 blockAlign = numChannels * bitsPerSample / 8;
+
+    char header[wavHeaderSize];
+    std::memset(header, 0, sizeof(header));
+
+    const quint64 riffSize = static_cast<quint64>(m_dataSize) + wavHeaderSize - 8;
+    std::memcpy(header, rf64 ? "RF64" : "RIFF", 4);
+    putLe32(header + 4, rf64 ? 0xFFFFFFFF : static_cast<quint32>(riffSize));
+    std::memcpy(header + 8, "WAVE", 4);
+
+    // ds64 chunk (RF64) or a JUNK chunk of the same size reserving the space
+    std::memcpy(header + 12, rf64 ? "ds64" : "JUNK", 4);
+    putLe32(header + 16, ds64ChunkSize);
+    if (rf64) {
+        putLe64(header + 20, riffSize);
+        putLe64(header + 28, static_cast<quint64>(m_dataSize));
+        putLe64(header + 36, static_cast<quint64>(m_dataSize) / blockAlign);
+        putLe32(header + 44, 0); // No table entries
+    }
+
+    // PCM format chunk
+    std::memcpy(header + 48, "fmt ", 4);
+    putLe32(header + 52, 16);
+    putLe16(header + 56, 1); // PCM
+    putLe16(header + 58, numChannels);
+    putLe32(header + 60, sampleRate);
+    putLe32(header + 64, sampleRate * blockAlign);
+    putLe16(header + 68, blockAlign);
+    putLe16(header + 70, bitsPerSample);
+
+    // Data chunk
+    std::memcpy(header + 72, "data", 4);
+    putLe32(header + 76, rf64 ? 0xFFFFFFFF : static_cast<quint32>(m_dataSize));
+
+    m_file.write(header, wavHeaderSize);
+}
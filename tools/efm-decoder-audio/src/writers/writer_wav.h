@@ -28,23 +28,39 @@
 #include <QString>
 #include <QDebug>
 #include <QFile>
+#include <QByteArray>
 
 #include "section.h"
 
 class WriterWav
 {
 public:
+    // Samples are gathered in a write-behind buffer and written to disc in
+    // blocks of this size
+    enum {
+        BufferSize = 4 * 1024 * 1024
+    };
+
     WriterWav();
     ~WriterWav();
 
+    void setHighResolution(bool highResolution);
     bool open(const QString &filename);
     void write(const AudioSection &audioSection);
+    void write(const QVector<qint32> &samples);
+    void writeSilence(qint64 stereoSamples);
     void close();
     qint64 size() const;
     bool isOpen() const { return m_file.isOpen(); };
 
 private:
     QFile m_file;
+    QByteArray m_buffer;
+    qint64 m_dataSize;
+    bool m_highResolution;
+
+    void flush();
+    void writeHeader(bool rf64);
 };
 
 #endif // WRITER_WAV_H
\ No newline at end of file
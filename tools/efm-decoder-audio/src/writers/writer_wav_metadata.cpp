@@ -24,19 +24,25 @@
 
 #include "writer_wav_metadata.h"
 
+#include <QtAlgorithms>
+#include <cstdio>
+#include <cstring>
+
 // This writer class writes metadata about audio data to a file
 // This is used when the output is stereo audio data
 
 WriterWavMetadata::WriterWavMetadata() :
-    m_inErrorRange(false),
-    m_inConcealedRange(false),
-    m_haveStartTime(false),
     m_noAudioConcealment(false),
     m_absoluteSectionTime(0, 0, 0),
     m_sectionTime(0, 0, 0),
     m_prevAbsoluteSectionTime(0, 0, 0),
-    m_prevSectionTime(0, 0, 0)
-{}
+    m_prevSectionTime(0, 0, 0),
+    m_haveStartTime(false)
+{
+    m_errorRange.active = false;
+    m_concealedRange.active = false;
+    std::memset(m_trackSeen, 0, sizeof(m_trackSeen));
+}
 
 WriterWavMetadata::~WriterWavMetadata()
 {
@@ -60,6 +66,14 @@ bool WriterWavMetadata::open(const QString &filename, bool noAudioConcealment)
     return true;
 }
 
+// Set the time of the first audio sample (by default the time of the first
+// section written) from which the label times are measured
+void WriterWavMetadata::setStartTime(const SectionTime &startTime)
+{
+    m_startTime = startTime;
+    m_haveStartTime = true;
+}
+
 void WriterWavMetadata::write(const AudioSection &audioSection)
 {
     if (!m_file.isOpen()) {
@@ -81,7 +95,7 @@ void WriterWavMetadata::write(const AudioSection &audioSection)
     SectionTime relativeSectionTime = m_absoluteSectionTime - m_startTime;
 
     // Do we have a new track?
-    if (!m_trackNumbers.contains(metadata.trackNumber())) {
+    if (!m_trackSeen[metadata.trackNumber()]) {
         // Check that the new track number is greater than the previous track numbers
         if (!m_trackNumbers.isEmpty() && metadata.trackNumber() < m_trackNumbers.last()) {
             qWarning() << "WriterWavMetadata::write() - Track number decreased from" << m_trackNumbers.last() << "to" << metadata.trackNumber() << "- ignoring";
@@ -89,6 +103,7 @@ void WriterWavMetadata::write(const AudioSection &audioSection)
             // Append the new track to the statistics
             if (metadata.trackNumber() != 0 && metadata.trackNumber() != 0xAA) {
                 m_trackNumbers.append(metadata.trackNumber());
+                m_trackSeen[metadata.trackNumber()] = true;
                 
                 m_trackAbsStartTimes.append(m_absoluteSectionTime);
                 m_trackStartTimes.append(m_sectionTime);
@@ -107,78 +122,41 @@ void WriterWavMetadata::write(const AudioSection &audioSection)
         }
     }
 
-    // Output metadata about errors
+    // Build bitmasks of the stereo samples with errors and concealment
+    quint32 errorMask[MaskWords];
+    quint32 concealedMask[MaskWords];
+    std::memset(errorMask, 0, sizeof(errorMask));
+    std::memset(concealedMask, 0, sizeof(concealedMask));
+    quint32 anyFlags = 0;
     for (int subSection = 0; subSection < 98; ++subSection) {
-        Audio audio = audioSection.frame(subSection);
-        QVector<qint16> audioData = audio.data();
-        QVector<bool> errors = audio.errorData();
-        QVector<bool> concealed = audio.concealedData();
-        
-        for (int sampleOffset = 0; sampleOffset < 12; sampleOffset += 2) {
-            // Errors/Silenced
-            bool hasError = errors.at(sampleOffset) || errors.at(sampleOffset+1);
-            
-            if (hasError && !m_inErrorRange) {
-                // Start of new error range
-                m_errorRangeStart = convertToAudacityTimestamp(relativeSectionTime.minutes(), relativeSectionTime.seconds(),
-                    relativeSectionTime.frameNumber(), subSection, sampleOffset);
-                m_inErrorRange = true;
-            } else if (!hasError && m_inErrorRange) {
-                // End of error range
-                QString rangeEnd;
-                if (sampleOffset == 0) {
-                    // Handle wrap to previous subsection
-                    if (subSection > 0) {
-                        rangeEnd = convertToAudacityTimestamp(relativeSectionTime.minutes(), relativeSectionTime.seconds(),
-                            relativeSectionTime.frameNumber(), subSection - 1, 11);
-                    } else {
-                        // If we're at the first subsection, just use the current position
-                        rangeEnd = convertToAudacityTimestamp(relativeSectionTime.minutes(), relativeSectionTime.seconds(),
-                            relativeSectionTime.frameNumber(), subSection, sampleOffset);
-                    }
-                } else {
-                    rangeEnd = convertToAudacityTimestamp(relativeSectionTime.minutes(), relativeSectionTime.seconds(),
-                        relativeSectionTime.frameNumber(), subSection, sampleOffset - 1);
-                }
-
-                QString sampleTimeStamp = QString("%1").arg(m_absoluteSectionTime.toString());
-                QString outputString = m_errorRangeStart + "\t" + rangeEnd + "\tError: " + sampleTimeStamp + "\n";
-                if (!m_noAudioConcealment) outputString = m_errorRangeStart + "\t" + rangeEnd + "\tSilenced: " + sampleTimeStamp + "\n";
-
-                m_file.write(outputString.toUtf8());
-                m_inErrorRange = false;
-            }
-
-            // Concealed
-            bool hasConcealed = concealed.at(sampleOffset) || concealed.at(sampleOffset+1);
-            
-            if (hasConcealed && !m_inConcealedRange) {
-                // Start of new error range
-                m_concealedRangeStart = convertToAudacityTimestamp(relativeSectionTime.minutes(), relativeSectionTime.seconds(),
-                    relativeSectionTime.frameNumber(), subSection, sampleOffset);
-                    m_inConcealedRange = true;
-            } else if (!hasConcealed && m_inConcealedRange) {
-                // End of error range
-                QString rangeEnd;
-                if (sampleOffset == 0) {
-                    // Handle wrap to previous subsection
-                    if (subSection > 0) {
-                        rangeEnd = convertToAudacityTimestamp(relativeSectionTime.minutes(), relativeSectionTime.seconds(),
-                            relativeSectionTime.frameNumber(), subSection - 1, 11);
-                    } else {
-                        // If we're at the first subsection, just use the current position
-                        rangeEnd = convertToAudacityTimestamp(relativeSectionTime.minutes(), relativeSectionTime.seconds(),
-                            relativeSectionTime.frameNumber(), subSection, sampleOffset);
-                    }
-                } else {
-                    rangeEnd = convertToAudacityTimestamp(relativeSectionTime.minutes(), relativeSectionTime.seconds(),
-                        relativeSectionTime.frameNumber(), subSection, sampleOffset - 1);
-                }
-
-                QString sampleTimeStamp = QString("%1").arg(m_absoluteSectionTime.toString());
-                QString outputString = m_concealedRangeStart + "\t" + rangeEnd + "\tConcealed: " + sampleTimeStamp + "\n";
-                m_file.write(outputString.toUtf8());
-                m_inConcealedRange = false;
+        const Audio audio = audioSection.frame(subSection);
+        const QVector<bool> errors = audio.errorData();
+        const QVector<bool> concealed = audio.concealedData();
+
+        for (int sample = 0; sample < 6; ++sample) {
+            const qint32 position = subSection * 6 + sample;
+            const quint32 bit = 1u << (position & 31);
+            if (errors.at(sample * 2) || errors.at(sample * 2 + 1)) errorMask[position >> 5] |= bit;
+            if (concealed.at(sample * 2) || concealed.at(sample * 2 + 1)) concealedMask[position >> 5] |= bit;
+        }
+    }
+    for (int word = 0; word < MaskWords; ++word) anyFlags |= errorMask[word] | concealedMask[word];
+
+    // Output metadata about errors/silenced and concealed ranges (only the
+    // transitions are visited, so clean sections outside a range cost nothing)
+    if (anyFlags || m_errorRange.active || m_concealedRange.active) {
+        const char *errorLabel = m_noAudioConcealment ? "Error" : "Silenced";
+        qint32 errorPosition = findNextPosition(errorMask, 0, !m_errorRange.active);
+        qint32 concealedPosition = findNextPosition(concealedMask, 0, !m_concealedRange.active);
+
+        // Labels are written in sample order (errors first at the same sample)
+        while (errorPosition < SectionPositions || concealedPosition < SectionPositions) {
+            if (errorPosition <= concealedPosition) {
+                rangeTransition(m_errorRange, errorPosition, relativeSectionTime, errorLabel);
+                errorPosition = findNextPosition(errorMask, errorPosition, !m_errorRange.active);
+            } else {
+                rangeTransition(m_concealedRange, concealedPosition, relativeSectionTime, "Concealed");
+                concealedPosition = findNextPosition(concealedMask, concealedPosition, !m_concealedRange.active);
             }
         }
     }
@@ -241,9 +219,12 @@ void WriterWavMetadata::close()
     flush();
 
     // If we're still in an error range when closing, write the final range
-    if (m_inErrorRange) {
-        QString outputString = m_errorRangeStart + "\t" + m_errorRangeStart + "\tError: Incomplete range\n";
-        m_file.write(outputString.toUtf8());
+    if (m_errorRange.active) {
+        char start[32];
+        formatTimestamp(start, sizeof(start), m_errorRange.start);
+        char line[96];
+        const qint32 length = std::snprintf(line, sizeof(line), "%s\t%s\tError: Incomplete range\n", start, start);
+        m_file.write(line, length);
     }
 
     m_file.close();
@@ -259,6 +240,69 @@ qint64 WriterWavMetadata::size() const
     return 0;
 }
 
+// Open or close a range at a transition.  A range is labelled from its first
+// flagged sample to the sample before the first unflagged one, with the
+// (absolute) time of the section in which it closed
+void WriterWavMetadata::rangeTransition(LabelRange &range, qint32 position, const SectionTime &relativeSectionTime,
+    const char *label)
+{
+    if (!range.active) {
+        range.start = labelPosition(relativeSectionTime, position);
+        range.active = true;
+        return;
+    }
+
+    // The range ended at the previous sample (a range closing at the very
+    // start of a section is labelled as ending at that position)
+    const LabelPosition end = labelPosition(relativeSectionTime, qMax(position - 1, 0));
+
+    char start[32];
+    char stop[32];
+    formatTimestamp(start, sizeof(start), range.start);
+    formatTimestamp(stop, sizeof(stop), end);
+
+    char line[128];
+    const qint32 length = std::snprintf(line, sizeof(line), "%s\t%s\t%s: %02d:%02d:%02d\n", start, stop, label,
+        m_absoluteSectionTime.frames() / (75 * 60), (m_absoluteSectionTime.frames() / 75) % 60,
+        m_absoluteSectionTime.frames() % 75);
+    m_file.write(line, length);
+    range.active = false;
+}
+
+// Returns the first position at or after 'from' whose bit matches 'set', or
+// SectionPositions if there is none
+qint32 WriterWavMetadata::findNextPosition(const quint32 *mask, qint32 from, bool set)
+{
+    for (qint32 word = from >> 5; word < MaskWords; ++word) {
+        quint32 bits = set ? mask[word] : ~mask[word];
+        if (word == (from >> 5)) bits &= ~0u << (from & 31);
+        if (bits) return qMin(word * 32 + static_cast<qint32>(qCountTrailingZeroBits(bits)),
+            static_cast<qint32>(SectionPositions));
+    }
+    return SectionPositions;
+}
+
+WriterWavMetadata::LabelPosition WriterWavMetadata::labelPosition(const SectionTime &time, qint32 position)
+{
+    LabelPosition labelPosition;
+    labelPosition.minutes = time.minutes();
+    labelPosition.seconds = time.seconds();
+    labelPosition.frames = time.frameNumber();
+    labelPosition.subSection = position / 6;
+    labelPosition.sample = position % 6;
+    return labelPosition;
+}
+
+// Format a position as an Audacity timestamp (seconds with 6 decimal places)
+qint32 WriterWavMetadata::formatTimestamp(char *buffer, qint32 size, const LabelPosition &position)
+{
+    double totalSeconds = (position.minutes * 60.0) + position.seconds;
+    totalSeconds += position.frames / 75.0;
+    totalSeconds += position.subSection / (75.0 * 98.0);
+    totalSeconds += position.sample / (75.0 * 98.0 * 6.0);
+    return std::snprintf(buffer, size, "%.6f", totalSeconds);
+}
+
 QString WriterWavMetadata::convertToAudacityTimestamp(qint32 minutes, qint32 seconds, qint32 frames,
     qint32 subsection, qint32 sample)
 {
@@ -38,20 +38,40 @@ public:
     ~WriterWavMetadata();
 
     bool open(const QString &filename, bool noAudioConcealment);
+    void setStartTime(const SectionTime &startTime);
     void write(const AudioSection &audioSection);
     void close();
     qint64 size() const;
     bool isOpen() const { return m_file.isOpen(); };
 
 private:
+    // Stereo sample positions in a section and the words needed to hold a
+    // bitmask of them (bit n is frame n / 6, stereo sample n % 6)
+    enum {
+        SectionPositions = 98 * 6,
+        MaskWords = (SectionPositions + 31) / 32
+    };
+
+    // A position expressed in the terms used for the Audacity timestamps
+    struct LabelPosition {
+        qint32 minutes;
+        qint32 seconds;
+        qint32 frames;
+        qint32 subSection;
+        qint32 sample; // Stereo sample within the subsection (0-5)
+    };
+
+    // An open range of flagged samples (which may span several sections)
+    struct LabelRange {
+        bool active;
+        LabelPosition start;
+    };
+
     QFile m_file;
     bool m_noAudioConcealment;
 
-    bool m_inErrorRange;
-    QString m_errorRangeStart;
-
-    bool m_inConcealedRange;
-    QString m_concealedRangeStart;
+    LabelRange m_errorRange;
+    LabelRange m_concealedRange;
 
     SectionTime m_absoluteSectionTime;
     SectionTime m_sectionTime;
@@ -61,6 +81,7 @@ private:
     bool m_haveStartTime;
     SectionTime m_startTime;
 
+    bool m_trackSeen[256];
     QVector<quint8> m_trackNumbers;
     QVector<SectionTime> m_trackAbsStartTimes;
     QVector<SectionTime> m_trackAbsEndTimes;
@@ -68,6 +89,11 @@ private:
     QVector<SectionTime> m_trackEndTimes;
 
     void flush();
+    void rangeTransition(LabelRange &range, qint32 position, const SectionTime &relativeSectionTime,
+        const char *label);
+    static qint32 findNextPosition(const quint32 *mask, qint32 from, bool set);
+    static LabelPosition labelPosition(const SectionTime &time, qint32 position);
+    static qint32 formatTimestamp(char *buffer, qint32 size, const LabelPosition &position);
     QString convertToAudacityTimestamp(qint32 minutes, qint32 seconds, qint32 frames,
         qint32 subsection, qint32 sample);
 };
@@ -46,6 +46,8 @@ private:
     QFile m_file;
     QDataStream* m_dataStream;
     qint64 m_fileSizeInSections;
+    qint32 m_version;
+    qint64 m_dataOffset;
 };
 
 #endif // READER_F2SECTION_H
\ No newline at end of file
@@ -24,6 +24,13 @@
 
 #include "dec_data24torawsector.h"
 
+#include <QtAlgorithms>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 Data24ToRawSector::Data24ToRawSector()
     : m_validSectorCount(0),
       m_discardedBytes(0),
@@ -32,8 +39,21 @@ Data24ToRawSector::Data24ToRawSector()
       m_goodSyncPatternCount(0),
       m_syncLostCount(0),
       m_badSyncPatternCount(0),
-      m_currentState(WaitingForSync)
-{}
+      m_falseSyncPatternCount(0),
+      m_currentState(WaitingForSync),
+      m_readPosition(0),
+      m_writePosition(0)
+{
+    // Horspool skip table - a window whose last byte isn't in the first 11
+    // bytes of the sync pattern can't overlap a sync pattern at all
+    for (qint32 i = 0; i < 256; i++) m_syncSkipTable[i] = SyncSize;
+    for (qint32 i = 0; i < SyncSize - 1; i++) {
+        m_syncSkipTable[static_cast<quint8>(m_syncPattern[i])] = SyncSize - 1 - i;
+    }
+
+    std::memcpy(&m_syncWords[0], m_syncPattern.constData(), sizeof(quint64));
+    std::memcpy(&m_syncWords[1], m_syncPattern.constData() + SyncSize - sizeof(quint64), sizeof(quint64));
+}
 
 void Data24ToRawSector::pushSection(const Data24Section &data24Section)
 {
@@ -44,10 +64,16 @@ void Data24ToRawSector::pushSection(const Data24Section &data24Section)
     processStateMachine();
 }
 
-RawSector Data24ToRawSector::popSector()
+// The sector is read in place from the output queue, call popSector() once
+// it has been used
+RawSector &Data24ToRawSector::headSector()
+{
+    return m_outputBuffer.head();
+}
+
+void Data24ToRawSector::popSector()
 {
-    // Return the first item in the output buffer
-    return m_outputBuffer.dequeue();
+    m_outputBuffer.pop();
 }
 
 bool Data24ToRawSector::isReady() const
@@ -59,42 +85,156 @@ bool Data24ToRawSector::isReady() const
 void Data24ToRawSector::processStateMachine()
 {
     while (!m_inputBuffer.isEmpty()) {
-        Data24Section data24Section = m_inputBuffer.dequeue();
-
         // Add the data24 section's data to the sector data buffer
-        m_sectorData.reserve(m_sectorData.size() + 2352);
-        m_sectorErrorData.reserve(m_sectorErrorData.size() + 2352);
-        m_sectorPaddedData.reserve(m_sectorPaddedData.size() + 2352);
-
-        for (int i = 0; i < 98; i++) {
-            // Data
-            const QVector<quint8>& frameData = data24Section.frame(i).data();
-            QByteArray frameBytes = QByteArray(reinterpret_cast<const char*>(frameData.constData()), frameData.size());
-            m_sectorData.append(frameBytes);
-
-            // Add the error data
-            const QVector<bool>& frameErrorData = data24Section.frame(i).errorData();
-            QByteArray frameErrorBytes = QByteArray(reinterpret_cast<const char*>(frameErrorData.constData()), frameErrorData.size());
-            m_sectorErrorData.append(frameErrorBytes);
-
-            // Add the padding data
-            const QVector<bool>& framePaddedData = data24Section.frame(i).paddedData();
-            QByteArray framePaddedBytes = QByteArray(reinterpret_cast<const char*>(framePaddedData.constData()), framePaddedData.size());
-            m_sectorPaddedData.append(framePaddedBytes);
+        appendSection(m_inputBuffer.dequeue());
+
+        // Run the state machine until it stops making progress (i.e. it needs
+        // more data).  Every state either consumes buffered data or changes
+        // state while a full sector is buffered, so this always leaves less
+        // than a sector in the buffer
+        for (;;) {
+            const State previousState = m_currentState;
+            const qint32 previousBufferedBytes = bufferedBytes();
+
+            switch (m_currentState) {
+                case WaitingForSync:
+                    m_currentState = waitingForSync();
+                    break;
+                case InSync:
+                    m_currentState = inSync();
+                    break;
+                case LostSync:
+                    m_currentState = lostSync();
+                    break;
+            }
+
+            if (m_currentState == previousState && bufferedBytes() == previousBufferedBytes) break;
         }
+    }
+}
 
-        switch (m_currentState) {
-            case WaitingForSync:
-                m_currentState = waitingForSync();
-                break;
-            case InSync:
-                m_currentState = inSync();
-                break;
-            case LostSync:
-                m_currentState = lostSync();
-                break;
+// Copy the 98 frames of a section (2352 bytes) into the sector data buffer.
+// The buffered bytes are moved back to the start of the buffer only when
+// there isn't room left at the end for another section
+void Data24ToRawSector::appendSection(const Data24Section &data24Section)
+{
+    if (m_writePosition + SectorSize > BufferSize) {
+        // The state machine is run until less than a sector is buffered, so
+        // there is always room for another section once the data is moved back
+        if (bufferedBytes() + SectorSize > BufferSize) {
+            qFatal("Data24ToRawSector::appendSection(): Sector data buffer overflow with %d bytes buffered", bufferedBytes());
         }
+
+        const qint32 size = bufferedBytes();
+        std::memmove(m_sectorData, m_sectorData + m_readPosition, size);
+        std::memmove(m_sectorErrorData, m_sectorErrorData + m_readPosition, size);
+        std::memmove(m_sectorPaddedData, m_sectorPaddedData + m_readPosition, size);
+        m_readPosition = 0;
+        m_writePosition = size;
+    }
+
+    for (int i = 0; i < 98; i++) {
+        const Data24 frame = data24Section.frame(i);
+        const QVector<quint8> frameData = frame.data();
+        const QVector<bool> frameErrorData = frame.errorData();
+        const QVector<bool> framePaddedData = frame.paddedData();
+
+        // Flags are stored as 0 or 1 bytes, the same representation as bool
+        Q_STATIC_ASSERT(sizeof(bool) == 1);
+        std::memcpy(m_sectorData + m_writePosition, frameData.constData(), 24);
+        std::memcpy(m_sectorErrorData + m_writePosition, frameErrorData.constData(), 24);
+        std::memcpy(m_sectorPaddedData + m_writePosition, framePaddedData.constData(), 24);
+        m_writePosition += 24;
+    }
+}
+
+void Data24ToRawSector::discardBytes(qint32 count)
+{
+    m_readPosition += count;
+    if (m_readPosition == m_writePosition) {
+        m_readPosition = 0;
+        m_writePosition = 0;
+    }
+}
+
+// Discard bytes that are not part of a sector, keeping count of how many of
+// them were padding
+void Data24ToRawSector::discardUnsyncedBytes(qint32 count)
+{
+    if (count <= 0) return;
+    m_discardedBytes += count;
+    m_discardedPaddingBytes += countFlags(m_sectorPaddedData + m_readPosition, count);
+    discardBytes(count);
+}
+
+// Returns the position of the first sync pattern at or after from (both
+// relative to the read position), or -1 if the buffered data doesn't contain
+// one.  Long runs of padding (0x00) or random data only cost one look-up per
+// 11 or 12 bytes
+qint32 Data24ToRawSector::findSyncPattern(qint32 from) const
+{
+    const quint8 *start = m_sectorData + m_readPosition;
+    const quint8 *last = m_sectorData + m_writePosition - SyncSize;
+    const quint8 *candidate = start + from;
+
+    while (candidate <= last) {
+        const quint8 lastByte = candidate[SyncSize - 1];
+        if (lastByte == 0x00 && isSyncPattern(candidate)) return static_cast<qint32>(candidate - start);
+        candidate += m_syncSkipTable[lastByte];
+    }
+
+    return -1;
+}
+
+bool Data24ToRawSector::isSyncPattern(const quint8 *data) const
+{
+    quint64 words[2];
+    std::memcpy(&words[0], data, sizeof(quint64));
+    std::memcpy(&words[1], data + SyncSize - sizeof(quint64), sizeof(quint64));
+    return words[0] == m_syncWords[0] && words[1] == m_syncWords[1];
+}
+
+// Note: the caller must ensure a full sector is buffered from position
+Data24ToRawSector::SyncCandidate Data24ToRawSector::syncCandidate(qint32 position) const
+{
+    SyncCandidate candidate;
+    candidate.position = position;
+    candidate.errorByteCount = countFlags(m_sectorErrorData + m_readPosition + position, SectorSize);
+    candidate.paddingByteCount = countFlags(m_sectorPaddedData + m_readPosition + position, SectorSize);
+    return candidate;
+}
+
+// Unscramble bytes 12 to 2351 of a sector in place
+void Data24ToRawSector::unscramble(quint8 *data) const
+{
+    qint32 i = SyncSize;
+#if defined(__SSE2__)
+    for (; i + 16 <= SectorSize; i += 16) {
+        const __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        const __m128i table = _mm_loadu_si128(reinterpret_cast<const __m128i *>(m_unscrambleTable + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(data + i), _mm_xor_si128(value, table));
+    }
+#endif
+    for (; i < SectorSize; i++) {
+        data[i] ^= m_unscrambleTable[i];
+    }
+}
+
+// Count the flags that are set, 8 flag bytes at a time (each byte is 0 or 1
+// so the population count of a 64-bit word is the number of flags set in it)
+qint32 Data24ToRawSector::countFlags(const quint8 *flags, qint32 length)
+{
+    qint32 count = 0;
+    qint32 i = 0;
+    for (; i + 8 <= length; i += 8) {
+        quint64 word;
+        std::memcpy(&word, flags + i, sizeof(word));
+        count += qPopulationCount(word);
+    }
+    for (; i < length; i++) {
+        count += flags[i];
     }
+    return count;
 }
 
 Data24ToRawSector::State Data24ToRawSector::waitingForSync()
@@ -102,7 +242,7 @@ Data24ToRawSector::State Data24ToRawSector::waitingForSync()
     State nextState = WaitingForSync;
 
     // Is there enough data in the buffer to form a sector?
-    if (m_sectorData.size() < 2352) {
+    if (bufferedBytes() < SectorSize) {
         // Not enough data
         if (m_showDebug) qDebug() << "Data24ToRawSector::waitingForSync(): Not enough data in sectorData to form a sector, waiting for more data";
 
@@ -111,53 +251,50 @@ Data24ToRawSector::State Data24ToRawSector::waitingForSync()
         return nextState;
     }
 
-    // Does the sector data contain the sync pattern?
-    quint32 syncPatternPosition = m_sectorData.indexOf(m_syncPattern);
-    if (syncPatternPosition == -1) {
-        // No sync pattern found
-        //if (m_showDebug) qDebug() << "Data24ToRawSector::waitingForSync(): No sync pattern found in sectorData, discarding" << m_sectorData.size() - 11 << "bytes";
+    // Check every sync pattern in the buffered data, so that a false positive
+    // doesn't delay the search until the next section arrives
+    qint32 from = 0;
+    for (;;) {
+        const qint32 syncPatternPosition = findSyncPattern(from);
+        if (syncPatternPosition == -1) {
+            // No sync pattern found
 
-        // Clear the sector data buffer (except the last 11 bytes)
-        m_discardedBytes += m_sectorData.size() - 11;
-        m_sectorData = m_sectorData.right(11);
-        m_sectorErrorData = m_sectorErrorData.right(11);
+            // Clear the sector data buffer (except the last 11 bytes which could be
+            // the start of a sync pattern)
+            discardUnsyncedBytes(bufferedBytes() - (SyncSize - 1));
 
-        // Get more data and try again
-        nextState = WaitingForSync;
-    } else {
-        // Sync pattern found
-
-        // Discard any data before the sync pattern
-        m_discardedBytes += syncPatternPosition;
-        m_sectorData = m_sectorData.right(m_sectorData.size() - syncPatternPosition);
-        m_sectorErrorData = m_sectorErrorData.right(m_sectorErrorData.size() - syncPatternPosition);
-        m_sectorPaddedData = m_sectorPaddedData.right(m_sectorPaddedData.size() - syncPatternPosition);
-        if (m_showDebug) qDebug() << "Data24ToRawSector::waitingForSync(): Possible sync pattern found in sectorData at position:" << syncPatternPosition << "discarding" << syncPatternPosition << "bytes";
+            // Get more data and try again
+            return nextState;
+        }
 
         // Do we really have a valid sector or is this a false positive?
+        if (syncPatternPosition + SectorSize > bufferedBytes()) {
+            // Not enough data to check the sector yet, discard any data before the
+            // sync pattern and try again with more data
+            if (m_showDebug) qDebug() << "Data24ToRawSector::waitingForSync(): Possible sync pattern found in sectorData at position:" << syncPatternPosition << "waiting for more data";
+            discardUnsyncedBytes(syncPatternPosition);
+            return nextState;
+        }
 
         // Is the sector broken?  Count the total number of error bytes and padding bytes in the sector
-        qint32 errorByteCount = 0;
-        qint32 paddingByteCount = 0;
-        for (int i = 0; i < 2352; i++) {
-            if (static_cast<quint8>(m_sectorErrorData[i]) == 1) {
-                errorByteCount++;
-            }
-            if (static_cast<quint8>(m_sectorPaddedData[i]) == 1) {
-                paddingByteCount++;
-            }
-        }
+        const SyncCandidate candidate = syncCandidate(syncPatternPosition);
 
-        if (errorByteCount > 1000 || paddingByteCount > 1000) {
-            if (m_showDebug) qDebug() << "Data24ToRawSector::waitingForSync(): Discarding sync as false positive due to" << errorByteCount << "error bytes and" << paddingByteCount << "padding bytes";
-            nextState = WaitingForSync;
+        if (candidate.errorByteCount > 1000 || candidate.paddingByteCount > 1000) {
+            if (m_showDebug) qDebug() << "Data24ToRawSector::waitingForSync(): Discarding sync at position" << candidate.position << "as false positive due to"
+                << candidate.errorByteCount << "error bytes and" << candidate.paddingByteCount << "padding bytes";
+
+            // Step past the false sync so the next search doesn't find it again
+            m_falseSyncPatternCount++;
+            from = syncPatternPosition + 1;
         } else {
-            if (m_showDebug) qDebug() << "Data24ToRawSector::waitingForSync(): Valid sector sync found with" << errorByteCount << "error bytes and" << paddingByteCount << "padding bytes";
+            // Discard any data before the sync pattern
+            if (m_showDebug) qDebug() << "Data24ToRawSector::waitingForSync(): Valid sector sync found at position" << candidate.position << "with"
+                << candidate.errorByteCount << "error bytes and" << candidate.paddingByteCount << "padding bytes, discarding" << candidate.position << "bytes";
+            discardUnsyncedBytes(syncPatternPosition);
             nextState = InSync;
+            return nextState;
         }
     }
-
-    return nextState;
 }
 
 Data24ToRawSector::State Data24ToRawSector::inSync()
@@ -165,7 +302,7 @@ Data24ToRawSector::State Data24ToRawSector::inSync()
     State nextState = InSync;
 
     // Is there enough data in the buffer to form a sector?
-    if (m_sectorData.size() < 2352) {
+    if (bufferedBytes() < SectorSize) {
         // Not enough data
         if (m_showDebug) qDebug() << "Data24ToRawSector::inSync(): Not enough data in sectorData to form a sector, waiting for more data";
 
@@ -173,28 +310,19 @@ Data24ToRawSector::State Data24ToRawSector::inSync()
         nextState = InSync;
         return nextState;
     } else {
+        const quint8 *sectorData = m_sectorData + m_readPosition;
+        const quint8 *sectorErrorData = m_sectorErrorData + m_readPosition;
+        const quint8 *sectorPaddedData = m_sectorPaddedData + m_readPosition;
+
         // Are there any error bytes or padding in the first 12 bytes?
-        if (m_sectorErrorData.left(12).contains(1) || m_sectorPaddedData.left(12).contains(1)) {
+        if (m_showDebug && (countFlags(sectorErrorData, SyncSize) || countFlags(sectorPaddedData, SyncSize))) {
             // Is the sector broken?  Count the total number of error bytes and padding bytes in the sector
-            qint32 errorByteCount = 0;
-            qint32 paddingByteCount = 0;
-            for (int i = 0; i < 2352; i++) {
-                if (static_cast<quint8>(m_sectorErrorData[i]) == 1) {
-                    errorByteCount++;
-                }
-                if (static_cast<quint8>(m_sectorPaddedData[i]) == 1) {
-                    paddingByteCount++;
-                }
-            }
-
-            if (m_showDebug) {
-                qDebug() << "Data24ToRawSector::inSync(): Sector header corrupt. Sector contains" << errorByteCount
-                    << "error bytes and" << paddingByteCount << "padding bytes";
-            }
+            qDebug() << "Data24ToRawSector::inSync(): Sector header corrupt. Sector contains" << countFlags(sectorErrorData, SectorSize)
+                << "error bytes and" << countFlags(sectorPaddedData, SectorSize) << "padding bytes";
         }
 
         // Is there a valid sync pattern at the beginning of the sector data?
-        if (m_sectorData.left(12) != m_syncPattern) {
+        if (!isSyncPattern(sectorData)) {
             // No sync pattern found
             m_missedSyncPatternCount++;
             m_badSyncPatternCount++;
@@ -206,7 +334,7 @@ Data24ToRawSector::State Data24ToRawSector::inSync()
                 return nextState;
             } else {
                 if (m_showDebug) {
-                    QString foundPattern = m_sectorData.left(12).toHex(' ').toUpper();
+                    QString foundPattern = QByteArray(reinterpret_cast<const char *>(sectorData), SyncSize).toHex(' ').toUpper();
                     qDebug() << "Data24ToRawSector::inSync(): Sync pattern mismatch:"
                         << "Found:" << foundPattern
                         << "Sector count:" << m_validSectorCount
@@ -224,41 +352,29 @@ Data24ToRawSector::State Data24ToRawSector::inSync()
             m_missedSyncPatternCount = 0;
         }
 
-        // Unscramble the sector (bytes 12 to 2351)
-        QByteArray rawDataOut = m_sectorData.left(2352);
-        QByteArray rawErrorDataOut = m_sectorErrorData.left(2352);
-        QByteArray rawPaddedDataOut = m_sectorErrorData.left(2352);
-
-        for (qint32 i = 0; i < 2352; i++) {
-            if (i < 12) {
-                // Replace the sync pattern (or the EDC will always be wrong)
-                rawDataOut[i] = m_syncPattern[i];
-                rawErrorDataOut[i] = 0;
-                rawPaddedDataOut[i] = 0;
-            } else {
-                // Only bytes 12 to 2351 are scrambled
-                rawDataOut[i] = rawDataOut[i] ^ m_unscrambleTable[i];
-            }
-        }
+        // Create a new sector (in place in the output queue)
+        RawSector &rawSector = m_outputBuffer.tail();
+        std::memcpy(rawSector.data(), sectorData, SectorSize);
+        std::memcpy(rawSector.errorData(), sectorErrorData, SectorSize);
+        std::memcpy(rawSector.paddedData(), sectorPaddedData, SectorSize);
 
-        // Create a new sector
-        RawSector rawSector;
-        rawSector.pushData(rawDataOut);
-        rawSector.pushErrorData(rawErrorDataOut);
-        rawSector.pushPaddedData(rawPaddedDataOut);
+        // Replace the sync pattern (or the EDC will always be wrong)
+        std::memcpy(rawSector.data(), m_syncPattern.constData(), SyncSize);
+        std::memset(rawSector.errorData(), 0, SyncSize);
+        std::memset(rawSector.paddedData(), 0, SyncSize);
 
-        m_outputBuffer.enqueue(rawSector);
+        // Unscramble the sector (only bytes 12 to 2351 are scrambled)
+        unscramble(rawSector.data());
+
+        m_outputBuffer.push();
         m_validSectorCount++;
         
         // Remove 2352 bytes of processed data from the buffers
-        m_sectorData = m_sectorData.right(m_sectorData.size() - 2352);
-        m_sectorErrorData = m_sectorErrorData.right(m_sectorErrorData.size() - 2352);
-        m_sectorPaddedData = m_sectorErrorData.right(m_sectorPaddedData.size() - 2352);
+        discardBytes(SectorSize);
     }
 
     return nextState;
 }
-
 Data24ToRawSector::State Data24ToRawSector::lostSync()
 {
     State nextState = WaitingForSync;
@@ -277,6 +393,7 @@ void Data24ToRawSector::showStatistics()
     
     qInfo() << "  Good sync patterns:" << m_goodSyncPatternCount;
     qInfo() << "  Bad sync patterns:" << m_badSyncPatternCount;
+    qInfo() << "  False positive sync patterns:" << m_falseSyncPatternCount;
 
     qInfo() << "  Missed sync patterns:" << m_missedSyncPatternCount;
     qInfo() << "  Sync lost count:" << m_syncLostCount;
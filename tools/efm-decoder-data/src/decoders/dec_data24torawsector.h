@@ -27,22 +27,30 @@
 
 #include "decoders.h"
 #include "sector.h"
+#include "sector_queue.h"
 
 class Data24ToRawSector : public Decoder
 {
 public:
     Data24ToRawSector();
     void pushSection(const Data24Section &data24Section);
-    RawSector popSector();
+    RawSector &headSector();
+    void popSector();
     bool isReady() const;
 
     void showStatistics();
 
 private:
+    enum {
+        SectorSize = 2352,
+        SyncSize = 12,
+        BufferSize = 4 * SectorSize
+    };
+
     void processStateMachine();
 
     QQueue<Data24Section> m_inputBuffer;
-    QQueue<RawSector> m_outputBuffer;
+    SectorQueue<RawSector> m_outputBuffer;
 
     // State machine states
     enum State { WaitingForSync, InSync, LostSync };
@@ -52,10 +60,38 @@ private:
     // 12 byte sync pattern
     const QByteArray m_syncPattern = QByteArray::fromHex("00FFFFFFFFFFFFFFFFFFFF00");
 
-    // Sector data buffer
-    QByteArray m_sectorData;
-    QByteArray m_sectorErrorData;
-    QByteArray m_sectorPaddedData;
+    // Sector data buffer (fixed size, the bytes between the read and write
+    // positions are waiting to be formed into sectors).  Error and padding
+    // flags are stored one byte per data byte (0 or 1)
+    quint8 m_sectorData[BufferSize];
+    quint8 m_sectorErrorData[BufferSize];
+    quint8 m_sectorPaddedData[BufferSize];
+    qint32 m_readPosition;
+    qint32 m_writePosition;
+
+    // A sync pattern found while waiting for sync, with the error and padding
+    // byte counts of the sector that would start at it
+    struct SyncCandidate {
+        qint32 position; // Relative to the read position
+        qint32 errorByteCount;
+        qint32 paddingByteCount;
+    };
+
+    // Skip distances for the sync pattern search, indexed by the last byte of
+    // the current search window, and the sync pattern as two overlapping
+    // 64-bit words (bytes 0-7 and 4-11)
+    quint8 m_syncSkipTable[256];
+    quint64 m_syncWords[2];
+
+    void appendSection(const Data24Section &data24Section);
+    qint32 bufferedBytes() const { return m_writePosition - m_readPosition; }
+    void discardBytes(qint32 count);
+    void discardUnsyncedBytes(qint32 count);
+    qint32 findSyncPattern(qint32 from) const;
+    bool isSyncPattern(const quint8 *data) const;
+    SyncCandidate syncCandidate(qint32 position) const;
+    void unscramble(quint8 *data) const;
+    static qint32 countFlags(const quint8 *flags, qint32 length);
 
     // State machine state processing functions
     State waitingForSync();
@@ -65,6 +101,7 @@ private:
     quint32 m_missedSyncPatternCount;
     quint32 m_goodSyncPatternCount;
     quint32 m_badSyncPatternCount;
+    quint32 m_falseSyncPatternCount;
 
     // Statistics
     quint32 m_invalidSectorCount;
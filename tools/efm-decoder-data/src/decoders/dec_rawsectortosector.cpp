@@ -24,29 +24,105 @@
 
 #include "dec_rawsectortosector.h"
 
+#include <QtAlgorithms>
+
 RawSectorToSector::RawSectorToSector()
-    : m_validSectors(0),
-    m_invalidSectors(0),
-    m_correctedSectors(0),
-    m_mode0Sectors(0),
-    m_mode1Sectors(0),
-    m_mode2Sectors(0),
-    m_invalidModeSectors(0)
+    : m_keepInvalidSectors(false),
+    m_threads(0),
+    m_batchSize(0),
+    m_nextBatchSector(0)
+{
+    setThreads(1);
+}
+
+RawSectorToSector::~RawSectorToSector()
+{
+    qDeleteAll(m_workers);
+}
+
+// Set the number of threads used for EDC checking and RSPC correction.  Each
+// thread has its own worker state (EDC/RSPC tables, scratch sector and
+// statistics)
+void RawSectorToSector::setThreads(qint32 threads)
+{
+    threads = qMax(1, threads);
+    if (threads == m_threads) return;
+
+    // Keep the statistics gathered so far
+    Statistics statistics;
+    for (qint32 i = 0; i < m_workers.size(); i++) statistics.add(m_workers[i]->statistics);
+    qDeleteAll(m_workers);
+    m_workers.clear();
+
+    m_threads = threads;
+    for (qint32 i = 0; i < m_threads; i++) m_workers.append(new Worker);
+    m_workers[0]->statistics = statistics;
+
+    if (m_threads > 1) {
+        m_threadPool.setMaxThreadCount(m_threads);
+        m_batchInput.resize(BatchSize);
+        m_batchOutput.resize(BatchSize);
+        m_batchOutputValid.resize(BatchSize);
+    }
+}
+
+RawSectorToSector::Statistics::Statistics() :
+    validSectors(0),
+    invalidSectors(0),
+    correctedSectors(0),
+    mode0Sectors(0),
+    mode1Sectors(0),
+    mode2Sectors(0),
+    mode2Form1Sectors(0),
+    mode2Form2Sectors(0),
+    mode2FormlessSectors(0),
+    invalidModeSectors(0),
+    keptInvalidSectors(0),
+    unreadableAddressSectors(0)
 {}
 
+void RawSectorToSector::Statistics::add(const Statistics &other)
+{
+    validSectors += other.validSectors;
+    invalidSectors += other.invalidSectors;
+    correctedSectors += other.correctedSectors;
+    mode0Sectors += other.mode0Sectors;
+    mode1Sectors += other.mode1Sectors;
+    mode2Sectors += other.mode2Sectors;
+    mode2Form1Sectors += other.mode2Form1Sectors;
+    mode2Form2Sectors += other.mode2Form2Sectors;
+    mode2FormlessSectors += other.mode2FormlessSectors;
+    invalidModeSectors += other.invalidModeSectors;
+    keptInvalidSectors += other.keptInvalidSectors;
+    unreadableAddressSectors += other.unreadableAddressSectors;
+}
+
+// Keep sectors that fail EDC (and can't be corrected) rather than discarding
+// them, so that the sector data and error flags are available for stacking
+void RawSectorToSector::setKeepInvalidSectors(bool keepInvalidSectors)
+{
+    m_keepInvalidSectors = keepInvalidSectors;
+}
+
 void RawSectorToSector::pushSector(const RawSector &rawSector)
 {
     // Add the data to the input buffer
-    m_inputBuffer.enqueue(rawSector);
+    m_inputBuffer.push(rawSector);
 
     // Process the queue
     processQueue();
 }
 
-Sector RawSectorToSector::popSector()
+// The sector is read in place from the output queue, call popSector() once
+// it has been used
+const Sector &RawSectorToSector::headSector() const
+{
+    return m_outputBuffer.head();
+}
+
+void RawSectorToSector::popSector()
 {
-    // Return the first item in the output buffer
-    return m_outputBuffer.dequeue();
+    m_outputBuffer.pop();
 }
 
 bool RawSectorToSector::isReady() const
@@ -55,213 +131,201 @@ bool RawSectorToSector::isReady() const
     return !m_outputBuffer.isEmpty();
 }
 
-// Note: Mode 0 and Mode 2 support missing
 // Note: Does not fill missing sectors
 void RawSectorToSector::processQueue()
 {
-    while (!m_inputBuffer.isEmpty()) {
-        // Get the first item in the input buffer
-        RawSector rawSector = m_inputBuffer.dequeue();
-        bool rawSectorValid = false;
-
-        // Verify the data sizes (sanity check)
-        if (rawSector.data().size() != 2352) {
-            if (m_showDebug) {
-                qDebug() << "RawSectorToSector::processQueue(): Sector data size is incorrect. Expected 2352 bytes, got" << rawSector.data().size() << "bytes";
-                qFatal("RawSectorToSector::processQueue(): Sector data size is incorrect");
-            }
+    // With a single thread the sectors are decoded as they arrive
+    if (m_threads <= 1) {
+        while (!m_inputBuffer.isEmpty()) {
+            // Error correction modifies the raw sector in place in the input
+            // queue, and the sector is decoded straight into the output queue
+            if (decodeSector(m_inputBuffer.head(), m_outputBuffer.tail(), *m_workers[0])) m_outputBuffer.push();
+            m_inputBuffer.pop();
         }
+        return;
+    }
 
-        if (rawSector.errorData().size() != 2352) {
-            if (m_showDebug) {
-                qDebug() << "RawSectorToSector::processQueue(): Sector error data size is incorrect. Expected 2352 bytes, got" << rawSector.errorData().size() << "bytes";
-                qFatal("RawSectorToSector::processQueue(): Sector error data size is incorrect");
-            }
-        }
+    // Otherwise they are decoded in batches across the thread pool
+    while (m_inputBuffer.size() >= BatchSize) {
+        processBatch();
+    }
+}
 
-        if (rawSector.paddedData().size() != 2352) {
-            if (m_showDebug) {
-                qDebug() << "RawSectorToSector::processQueue(): Sector padded data size is incorrect. Expected 2352 bytes, got" << rawSector.paddedData().size() << "bytes";
-                qFatal("RawSectorToSector::processQueue(): Sector padded data size is incorrect");
-            }
-        }
+// Decode any sectors waiting for a full batch
+void RawSectorToSector::flush()
+{
+    while (!m_inputBuffer.isEmpty()) {
+        processBatch();
+    }
+}
+
+// Sectors are independent once framed, so a batch is decoded by one task per
+// worker with each task taking the next undecoded sector from the batch until
+// none are left (so a slow, badly damaged sector doesn't hold up the others).
+// The decoded sectors are then output in their original order
+void RawSectorToSector::processBatch()
+{
+    // The batch is decoded in place in the input queue
+    m_batchSize = qMin(m_inputBuffer.size(), static_cast<qint32>(BatchSize));
+    for (qint32 i = 0; i < m_batchSize; i++) {
+        m_batchInput[i] = &m_inputBuffer.at(i);
+    }
 
-        // Determine the sector mode (for modes 0 and 2 there is no correction available)
-        qint32 mode = 0;
+    m_nextBatchSector.storeRelease(0);
+    for (qint32 i = 0; i < m_workers.size(); i++) {
+        m_threadPool.start(new BatchTask(*this, *m_workers[i]));
+    }
+    m_threadPool.waitForDone();
 
-        // Is the mode byte valid (not error or padding)?
-        if (static_cast<quint8>(rawSector.errorData()[15]) != 0) {
-            // Mode byte is invalid
-            if (m_showDebug) qDebug() << "RawSectorToSector::processQueue(): Sector mode byte is invalid. Assuming it's mode 1";
-            mode = -1;
-        } else {
-            // Extract the sector mode data
-            if (static_cast<quint8>(rawSector.data()[15]) == 0) mode = 0;
-            else if (static_cast<quint8>(rawSector.data()[15]) == 1) mode = 1;
-            else if (static_cast<quint8>(rawSector.data()[15]) == 2) mode = 2;
-            else mode = -1;
-
-            if (mode != 1) {
-                if (m_showDebug) qDebug() << "RawSectorToSector::processQueue(): Sector mode byte is valid, but mode isn't? Mode reported as" << static_cast<quint8>(rawSector.data()[15]);
-            }
+    for (qint32 i = 0; i < m_batchSize; i++) {
+        if (m_batchOutputValid[i]) m_outputBuffer.push(m_batchOutput[i]);
+        m_inputBuffer.pop();
+    }
+}
+
+RawSectorToSector::BatchTask::BatchTask(RawSectorToSector &decoder, Worker &worker) :
+    m_decoder(decoder),
+    m_worker(worker)
+{}
+
+void RawSectorToSector::BatchTask::run()
+{
+    qint32 index;
+    while ((index = m_decoder.m_nextBatchSector.fetchAndAddOrdered(1)) < m_decoder.m_batchSize) {
+        m_decoder.m_batchOutputValid[index] = m_decoder.decodeSector(*m_decoder.m_batchInput[index],
+            m_decoder.m_batchOutput[index], m_worker);
+    }
+}
+
+// Decode a single raw sector (in place) using the worker's sector verifier and
+// statistics.  Returns true if the sector should be output
+bool RawSectorToSector::decodeSector(RawSector &rawSector, Sector &sector, Worker &worker) const
+{
+    // Check (and if necessary correct) the sector.  If the mode byte is in error
+    // (or isn't a known mode) the verifier tries the sector as Mode 1 and then as
+    // Mode 2.  Mode 0 and formless Mode 2 sectors have no EDC, so they are only
+    // valid if no bytes are in error
+    qint32 mode = 0;
+    qint32 form = 0;
+    bool corrected = false;
+    const bool rawSectorValid = worker.sectorVerifier.verify(rawSector.data(), rawSector.errorData(),
+        mode, form, corrected, m_showDebug);
+
+    if (mode == 0) worker.statistics.mode0Sectors++;
+    else if (mode == 1) worker.statistics.mode1Sectors++;
+    else if (mode == 2) worker.statistics.mode2Sectors++;
+    else worker.statistics.invalidModeSectors++;
+
+    if (rawSectorValid) {
+        if (mode == 2) {
+            if (form == 1) worker.statistics.mode2Form1Sectors++;
+            else if (form == 2) worker.statistics.mode2Form2Sectors++;
+            else worker.statistics.mode2FormlessSectors++;
         }
 
-        // If the mode is invalid, we try to treat the sector as mode 1 to see if the error correction
-        // makes the mode metadata valid.  If it doesn't we discard the sector as error
-        if (mode == 1 || mode == -1) {
-            // Compute the CRC32 of the sector data based on the EDC word
-            quint32 originalEdcWord =
-                ((static_cast<quint32>(static_cast<uchar>(rawSector.data()[2064]))) <<  0) |
-                ((static_cast<quint32>(static_cast<uchar>(rawSector.data()[2065]))) <<  8) |
-                ((static_cast<quint32>(static_cast<uchar>(rawSector.data()[2066]))) << 16) |
-                ((static_cast<quint32>(static_cast<uchar>(rawSector.data()[2067]))) << 24);
-
-            quint32 edcWord = crc32(rawSector.data(), 2064);
-
-            // If the CRC32 of the sector data is incorrect, attempt to correct it using Q and P parity
-            if (originalEdcWord != edcWord) {
-                if (m_showDebug) {
-                    qDebug() << "RawSectorToSector::processQueue(): CRC32 error - sector data is corrupt. EDC:" << originalEdcWord << "Calculated:" << edcWord << "attempting to correct";
-                }
-
-                // Attempt Q and P parity error correction on the sector data
-                Rspc rspc;
-
-                // Make a local copy of the sector data
-                QByteArray correctedData = rawSector.data();
-                QByteArray correctedErrorData = rawSector.errorData();
-
-                rspc.qParityEcc(correctedData, correctedErrorData, m_showDebug);
-                rspc.pParityEcc(correctedData, correctedErrorData, m_showDebug);
-
-                // Copy the corrected data back to the raw sector
-                rawSector.pushData(correctedData);
-                rawSector.pushErrorData(correctedErrorData);
-
-                // Computer CRC32 again for the corrected data
-                quint32 correctedEdcWord =
-                    ((static_cast<quint32>(static_cast<uchar>(rawSector.data()[2064]))) <<  0) |
-                    ((static_cast<quint32>(static_cast<uchar>(rawSector.data()[2065]))) <<  8) |
-                    ((static_cast<quint32>(static_cast<uchar>(rawSector.data()[2066]))) << 16) |
-                    ((static_cast<quint32>(static_cast<uchar>(rawSector.data()[2067]))) << 24);
-
-                edcWord = crc32(rawSector.data(), 2064);
-
-                // Is the CRC now correct?
-                if (correctedEdcWord != edcWord) {
-                    // Error correction failed - sector is invalid and there's nothing more we can do
-
-                    if (mode == 1) {
-                        if (m_showDebug) qDebug() << "RawSectorToSector::processQueue(): CRC32 error - sector data cannot be recovered. EDC:" << correctedEdcWord << "Calculated:" << edcWord << "post correction";
-                        m_mode1Sectors++;
-                        rawSectorValid = false;
-                    } else {
-                        // Mode was invalid as the sector is completely invalid.  This is probably padding of some sort
-                        if (m_showDebug) qDebug() << "RawSectorToSector::processQueue(): Sector mode was invalid and the sector doesn't appear to be mode 1";
-                        m_invalidModeSectors++;
-                        rawSectorValid = false;
-                    }
-                } else {
-                    // Sector was invalid, but now corrected
-                    if (m_showDebug) qDebug() << "RawSectorToSector::processQueue(): Sector data corrected. EDC:" << correctedEdcWord << "Calculated:" << edcWord << "";
-                    m_correctedSectors++;
-                    rawSectorValid = true;
-                    mode = 1; // If error correction worked... this a mode 1 sector
-                }
-            } else {
-                // Original sector data is valid
-                m_validSectors++;
-                rawSectorValid = true;
-
-                // It's possible that the original mode byte was marked as error, but the RSCP error correction
-                // was able to correct the data.  In this case, we need to update the mode byte
-                if (static_cast<quint8>(rawSector.data()[15]) == 0) mode = 0;
-                else if (static_cast<quint8>(rawSector.data()[15]) == 1) mode = 1;
-                else if (static_cast<quint8>(rawSector.data()[15]) == 2) mode = 2;
-                else mode = -1;
-
-                if (mode == 0) m_mode0Sectors++;
-                else if (mode == 1) m_mode1Sectors++;
-                else if (mode == 2) m_mode2Sectors++;
-                else {
-                    qDebug() << "RawSectorToSector::processQueue(): EDC:" << originalEdcWord << "Calculated:" << edcWord << "Mode byte:" << static_cast<quint8>(rawSector.data()[15]);
-                    qFatal("RawSectorToSector::processQueue(): Invalid sector mode of %d - even though sector data was valid - bug?", mode);
-                }
-            }
+        if (corrected) {
+            if (m_showDebug) qDebug() << "RawSectorToSector::decodeSector(): Mode" << mode << "sector data corrected";
+            worker.statistics.correctedSectors++;
         } else {
-            // Mode 0 and Mode 2 sectors are not corrected
-            if (mode == 0) m_mode0Sectors++;
-            else if (mode == 2) m_mode2Sectors++;
-            rawSectorValid = true;
-
-            qWarning() << "RawSectorToSector::processQueue(): Mode 0 and Mode 2 sectors are probably not handled correctly - consider submitting this as test data";
+            worker.statistics.validSectors++;
         }
+    } else if (m_showDebug) {
+        if (mode < 0 || mode > 2) qDebug() << "RawSectorToSector::decodeSector(): Sector mode is invalid and the sector doesn't appear to be mode 1 or 2";
+        else qDebug() << "RawSectorToSector::decodeSector(): Mode" << mode << "sector data cannot be recovered";
+    }
 
-        // Determine the sector's metadata
-        SectorAddress sectorAddress(0, 0, 0);
+    // Determine the sector's metadata
+    SectorAddress sectorAddress(0, 0, 0);
 
-        // If the raw sector data is valid, form a sector from it
-        if (rawSectorValid) {
-            // Extract the sector address data
+    // If the raw sector data is valid, form a sector from it
+    if (rawSectorValid) {
+        // Extract the sector address data.  Only the Mode 1 EDC covers the
+        // header; the Mode 2 EDC starts at byte 16 and Mode 0 has no EDC, so for
+        // those the address must be checked before it's used to place the sector
+        if (mode == 1) {
             qint32 min = bcdToInt(rawSector.data()[12]);
             qint32 sec = bcdToInt(rawSector.data()[13]);
             qint32 frame = bcdToInt(rawSector.data()[14]);
             sectorAddress = SectorAddress(min, sec, frame);
+        } else if (!headerAddress(rawSector, sectorAddress)) {
+            if (m_showDebug) qDebug() << "RawSectorToSector::decodeSector(): Mode" << mode << "sector header address is unreadable - dropping sector";
+            worker.statistics.unreadableAddressSectors++;
+            return false;
+        }
 
-            // Extract the sector mode data
-            if (static_cast<quint8>(rawSector.data()[15]) == 0) mode = 0;
-            else if (static_cast<quint8>(rawSector.data()[15]) == 1) mode = 1;
-            else if (static_cast<quint8>(rawSector.data()[15]) == 2) mode = 2;
-            else mode = -1;
-        
-            // Create an output sector
-            Sector sector;
-            sector.dataValid(rawSectorValid);
+        // Create an output sector
+        sector.dataValid(rawSectorValid);
+        sector.setAddress(sectorAddress);
+        sector.setMode(mode);
+        sector.setForm(mode == 2 ? form : 0);
+
+        // Push the corrected raw sector to the output sector (the user data
+        // position is given by the mode and form)
+        sector.pushRawSector(rawSector);
+
+        return true;
+    } else {
+        // Sector is invalid - discard it, unless invalid sectors are being kept
+        // (for sector stacking) and the header address is readable
+        worker.statistics.invalidSectors++;
+        if (m_keepInvalidSectors && headerAddress(rawSector, sectorAddress)) {
+            sector.dataValid(false);
             sector.setAddress(sectorAddress);
-            sector.setMode(mode);
-            
-            // Push only the user data to the output sector (bytes 16 to 2063 = 2KBytes data)
-            sector.pushData(rawSector.data().mid(16, 2048));
-            sector.pushErrorData(rawSector.errorData().mid(16, 2048));
-
-            // Add the sector to the output buffer
-            m_outputBuffer.enqueue(sector);
-        } else {
-            // Sector is invalid - discard it
-            m_invalidSectors++;
+            sector.setMode(rawSector.errorData()[15] == 0 && rawSector.data()[15] <= 2 ? rawSector.data()[15] : -1);
+            sector.setForm(0);
+            sector.pushRawSector(rawSector);
+            worker.statistics.keptInvalidSectors++;
+            return true;
         }
     }
-}
 
-// Convert 1 byte BCD to integer
-quint8 RawSectorToSector::bcdToInt(quint8 bcd)
-{
-    return (bcd >> 4) * 10 + (bcd & 0x0F);
+    return false;
 }
 
-// CRC code adapted and used under GPLv3 from:
-// https://github.com/claunia/edccchk/blob/master/edccchk.c
-quint32 RawSectorToSector::crc32(const QByteArray &src, qint32 size)
+// Get the sector address from a header that isn't protected by the EDC (an
+// invalid sector, or a Mode 0 or Mode 2 sector).  Returns false if the address
+// bytes are in error or are not a valid BCD time
+bool RawSectorToSector::headerAddress(const RawSector &rawSector, SectorAddress &address)
 {
-    quint32 crc = 0;
-    const uchar *data = reinterpret_cast<const uchar*>(src.constData());
+    const quint8 *data = rawSector.data();
+    const quint8 *errorData = rawSector.errorData();
 
-    while(size--) {
-        crc = (crc >> 8) ^ m_crc32Lut[(crc ^ (*data++)) & 0xFF];
+    for (qint32 i = 12; i < 15; i++) {
+        if (errorData[i] || (data[i] & 0x0F) > 9 || (data[i] >> 4) > 9) return false;
     }
 
-    return crc;
+    const qint32 min = bcdToInt(data[12]);
+    const qint32 sec = bcdToInt(data[13]);
+    const qint32 frame = bcdToInt(data[14]);
+    if (sec > 59 || frame > 74) return false;
+
+    address = SectorAddress(min, sec, frame);
+    return true;
+}
+
+// Convert 1 byte BCD to integer
+quint8 RawSectorToSector::bcdToInt(quint8 bcd)
+{
+    return (bcd >> 4) * 10 + (bcd & 0x0F);
 }
 
 void RawSectorToSector::showStatistics()
 {
+    Statistics statistics;
+    for (qint32 i = 0; i < m_workers.size(); i++) statistics.add(m_workers[i]->statistics);
+
     qInfo() << "Raw Sector to Sector (RSPC error-correction):";
-    qInfo().nospace() << "  Valid sectors: " << m_validSectors + m_correctedSectors << " (corrected: " << m_correctedSectors << ")";
-    qInfo() << "  Invalid sectors:" << m_invalidSectors;
+    qInfo().nospace() << "  Valid sectors: " << statistics.validSectors + statistics.correctedSectors << " (corrected: " << statistics.correctedSectors << ")";
+    qInfo() << "    Dropped (unreadable header address):" << statistics.unreadableAddressSectors;
+    qInfo() << "  Invalid sectors:" << statistics.invalidSectors;
+    if (m_keepInvalidSectors) qInfo() << "    Kept (readable address):" << statistics.keptInvalidSectors;
 
     qInfo() << "  Sector metadata:";
-    qInfo() << "    Mode 0 sectors:" << m_mode0Sectors;
-    qInfo() << "    Mode 1 sectors:" << m_mode1Sectors;
-    qInfo() << "    Mode 2 sectors:" << m_mode2Sectors;
-    qInfo() << "    Invalid mode sectors:" << m_invalidModeSectors;
+    qInfo() << "    Mode 0 sectors:" << statistics.mode0Sectors;
+    qInfo() << "    Mode 1 sectors:" << statistics.mode1Sectors;
+    qInfo() << "    Mode 2 sectors:" << statistics.mode2Sectors;
+    qInfo() << "      Form 1:" << statistics.mode2Form1Sectors;
+    qInfo() << "      Form 2:" << statistics.mode2Form2Sectors;
+    qInfo() << "      No XA subheader:" << statistics.mode2FormlessSectors;
+    qInfo() << "    Invalid mode sectors:" << statistics.invalidModeSectors;
 }
\ No newline at end of file
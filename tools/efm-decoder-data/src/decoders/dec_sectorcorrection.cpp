@@ -28,99 +28,202 @@ SectorCorrection::SectorCorrection()
     : m_missingLeadingSectors(0),
     m_missingSectors(0),
     m_haveLastSectorInfo(false),
+    m_havePendingSector(false),
     m_lastSectorAddress(0),
+    m_nextSectorAddress(0),
     m_lastSectorMode(0),
-    m_goodSectors(0)
+    m_goodSectors(0),
+    m_keptInvalidSectors(0),
+    m_droppedSectors(0),
+    m_droppedInvalidSectors(0),
+    m_sectorsQueued(0),
+    m_sectorsPopped(0)
 {}
 
+// Gaps are passed on as a single missing sector range (rather than a sector for
+// every missing address) so the cost of gap filling depends on the number of
+// gaps and not on their length.  The sector is only copied (into the output
+// queue) if it is kept
+//
+// Only valid sectors are used to place the output: the header address of an
+// invalid sector (kept with --keep-invalid-sectors) can't be trusted, so an
+// invalid sector is only kept if it is at the next output address.  It
+// doesn't move the last good sector address, fill a gap or fill the missing
+// leading sectors
+//
+// A valid sector that jumps forward (including the first sector, which sets
+// the missing leading sectors) is held until the next valid sector confirms
+// the jump by following it.  Otherwise one sector with a wrong address would
+// move the output position past every following sector
 void SectorCorrection::pushSector(const Sector &sector)
 {
-    // Add the data to the input buffer
-    m_inputBuffer.enqueue(sector);
+    if (!sector.isDataValid()) {
+        if (m_havePendingSector || !m_haveLastSectorInfo || sector.address() != m_nextSectorAddress) {
+            if (m_showDebug) {
+                qDebug() << "SectorCorrection::pushSector(): Invalid sector address" << sector.address().address()
+                    << sector.address().toString() << "is not at the next output address - dropping sector";
+            }
+            m_droppedInvalidSectors++;
+            return;
+        }
+
+        outputSector(sector);
+        return;
+    }
+
+    if (m_havePendingSector) {
+        m_havePendingSector = false;
+
+        if (sector.address() > m_pendingSector.address()) {
+            // The sectors agree - the jump is real
+            placeSector(m_pendingSector);
+            placeSector(sector);
+            return;
+        }
+
+        // The held sector is an outlier
+        if (m_showDebug) {
+            qDebug() << "SectorCorrection::pushSector(): Sector address" << m_pendingSector.address().address()
+                << m_pendingSector.address().toString() << "was not confirmed by the next sector address"
+                << sector.address().address() << sector.address().toString() << "- dropping sector";
+        }
+        m_droppedSectors++;
+    }
+
+    if (m_haveLastSectorInfo && sector.address() < m_nextSectorAddress) {
+        // The address has gone backwards (or repeated).  The output position of
+        // every sector is its address (the BIN offset and the sector map record
+        // index), and the earlier sector may already have been output, so the
+        // sector is dropped
+        if (m_showDebug) {
+            qDebug() << "SectorCorrection::pushSector(): Sector address is not after the last output sector address. Last good sector address:"
+                << m_lastSectorAddress.address() << m_lastSectorAddress.toString()
+                << "Current sector address:" << sector.address().address() << sector.address().toString() << "- dropping sector";
+        }
+
+        m_droppedSectors++;
+        return;
+    }
 
-    // Process the queue
-    processQueue();
+    if (!m_haveLastSectorInfo || sector.address() != m_nextSectorAddress) {
+        // Hold the sector until the next valid sector confirms its address
+        m_pendingSector = sector;
+        m_havePendingSector = true;
+        return;
+    }
+
+    outputSector(sector);
 }
 
-Sector SectorCorrection::popSector()
+// Called once all the sectors have been pushed.  A sector still waiting for
+// its address to be confirmed is dropped
+void SectorCorrection::flush()
 {
-    // Return the first item in the output buffer
-    return m_outputBuffer.dequeue();
+    if (!m_havePendingSector) return;
+
+    if (m_showDebug) {
+        qDebug() << "SectorCorrection::flush(): Sector address" << m_pendingSector.address().address()
+            << m_pendingSector.address().toString() << "was not confirmed - dropping sector";
+    }
+    m_havePendingSector = false;
+    m_droppedSectors++;
 }
 
-void SectorCorrection::processQueue()
+// Output a valid sector at its address, filling the missing sectors before it
+void SectorCorrection::placeSector(const Sector &sector)
 {
-    while (!m_inputBuffer.isEmpty()) {
-        // Get the first item in the input buffer
-        Sector sector = m_inputBuffer.dequeue();
-
-        if (!m_haveLastSectorInfo) {
-            // This is the first sector - we have to fill the missing leading sectors
-            // if the address isn't 0
-
-            if (sector.address().frameNumber() != 0) {
-                // Fill the missing leading sectors from address 0 to the first decoded sector address
-                if (m_showDebug) {
-                    qDebug().nospace().noquote() << "SectorCorrection::processQueue(): First received frame address is "
-                        << sector.address().address() << " (" << sector.address().toString() << ")";
-                    qDebug() << "SectorCorrection::processQueue(): Filling missing leading sectors with"
-                        << sector.address().address() << "sectors";
-                }
-                for (int i = 0; i < sector.address().address(); i++) {
-                    Sector missingSector;
-                    missingSector.dataValid(false);
-                    missingSector.setAddress(SectorAddress(i));
-                    missingSector.setMode(1);
-                    missingSector.pushData(QByteArray(2048, 0));
-                    missingSector.pushErrorData(QByteArray(2048, 1));
-                    m_outputBuffer.enqueue(missingSector);
-                    m_missingLeadingSectors++;
-                }
+    if (!m_haveLastSectorInfo) {
+        // This is the first good sector - we have to fill the missing leading
+        // sectors if the address isn't 0
+
+        if (sector.address().address() > 0) {
+            // Fill the missing leading sectors from address 0 to the first decoded sector address
+            if (m_showDebug) {
+                qDebug().nospace().noquote() << "SectorCorrection::placeSector(): First received frame address is "
+                    << sector.address().address() << " (" << sector.address().toString() << ")";
+                qDebug() << "SectorCorrection::placeSector(): Filling missing leading sectors with"
+                    << sector.address().address() << "sectors";
             }
+            enqueueMissingRange(SectorRange(SectorAddress(0), sector.address().address()));
+            m_missingLeadingSectors += sector.address().address();
+        }
 
-            m_haveLastSectorInfo = true;
-            m_lastSectorAddress = sector.address();
-            m_lastSectorMode = sector.mode();
-        } else {
-            // Check if there is a gap between this sector and the last
-            if (sector.address() != m_lastSectorAddress + 1) {
-                // Calculate the number of missing sectors
-                quint32 gap = sector.address().address() - m_lastSectorAddress.address() - 1;
-
-                if (m_showDebug) {
-                    qDebug() << "SectorCorrection::processQueue(): Sector is not in the correct position. Last good sector address:"
-                        << m_lastSectorAddress.address() << m_lastSectorAddress.toString()
-                        << "Current sector address:" << sector.address().address() << sector.address().toString() << "Gap:" << gap;
-                }
-                
-                 // Add missing sectors
-                for (int i = 0; i < gap; ++i) {
-                    Sector missingSector;
-                    missingSector.dataValid(false);
-                    missingSector.setAddress(m_lastSectorAddress + 1 + i);
-                    missingSector.setMode(1);
-                    missingSector.pushData(QByteArray(2048, 0));
-                    missingSector.pushErrorData(QByteArray(2048, 1));
-                    m_outputBuffer.enqueue(missingSector);
-                    m_missingSectors++;
-                }
-            }
+        m_haveLastSectorInfo = true;
+    } else if (sector.address() != m_nextSectorAddress) {
+        // Calculate the number of missing sectors
+        qint32 gap = sector.address().address() - m_nextSectorAddress.address();
+
+        if (m_showDebug) {
+            qDebug() << "SectorCorrection::placeSector(): Sector is not in the correct position. Last good sector address:"
+                << m_lastSectorAddress.address() << m_lastSectorAddress.toString()
+                << "Current sector address:" << sector.address().address() << sector.address().toString() << "Gap:" << gap;
         }
 
-        // Add the sector to the output buffer
-        m_outputBuffer.enqueue(sector);
-        m_goodSectors++;
+        // Add the missing sectors as a single range
+        enqueueMissingRange(SectorRange(m_nextSectorAddress, gap));
+        m_missingSectors += gap;
+    }
+
+    outputSector(sector);
+}
 
-        // Update the last-good sector information
+// Add the sector to the output buffer at the next output address
+void SectorCorrection::outputSector(const Sector &sector)
+{
+    m_outputBuffer.push(sector);
+    m_sectorsQueued++;
+    m_nextSectorAddress = sector.address() + 1;
+
+    // Update the last-good sector information
+    if (sector.isDataValid()) {
+        m_goodSectors++;
         m_lastSectorAddress = sector.address();
         m_lastSectorMode = sector.mode();
+    } else {
+        m_keptInvalidSectors++;
     }
 }
 
+// The sector is read in place from the output queue, call popSector() once
+// it has been used
+const Sector &SectorCorrection::headSector() const
+{
+    return m_outputBuffer.head();
+}
+
+void SectorCorrection::popSector()
+{
+    m_sectorsPopped++;
+    m_outputBuffer.pop();
+}
+
 bool SectorCorrection::isReady() const
 {
     // Return true if the output buffer is not empty
-    return !m_outputBuffer.isEmpty();
+    return !m_outputBuffer.isEmpty() || !m_missingBuffer.isEmpty();
+}
+
+// Returns true if the next output is a missing sector range rather than a
+// sector
+bool SectorCorrection::isMissingRangeNext() const
+{
+    return !m_missingBuffer.isEmpty() && m_missingBuffer.head().position == m_sectorsPopped;
+}
+
+SectorRange SectorCorrection::popMissingRange()
+{
+    // Return the first item in the missing sector range buffer
+    return m_missingBuffer.dequeue().range;
+}
+
+// Ranges are tagged with the number of sectors queued before them, so that
+// they are output in order with the sectors
+void SectorCorrection::enqueueMissingRange(const SectorRange &range)
+{
+    MissingRange missingRange;
+    missingRange.range = range;
+    missingRange.position = m_sectorsQueued;
+    m_missingBuffer.enqueue(missingRange);
 }
 
 void SectorCorrection::showStatistics()
@@ -129,5 +232,8 @@ void SectorCorrection::showStatistics()
     qInfo().noquote() << "  Good sectors:" << m_goodSectors;
     qInfo().noquote() << "  Missing leading sectors:" << m_missingLeadingSectors;
     qInfo().noquote() << "  Missing/Gap sectors:" << m_missingSectors;
-    qInfo().noquote() << "  Total sectors:" << m_goodSectors + m_missingLeadingSectors + m_missingSectors;
+    qInfo().noquote() << "  Kept invalid sectors:" << m_keptInvalidSectors;
+    qInfo().noquote() << "  Dropped sectors (repeated or out of order):" << m_droppedSectors;
+    qInfo().noquote() << "  Dropped invalid sectors (unconfirmed address):" << m_droppedInvalidSectors;
+    qInfo().noquote() << "  Total sectors:" << m_goodSectors + m_keptInvalidSectors + m_missingLeadingSectors + m_missingSectors;
 }
\ No newline at end of file
@@ -27,31 +27,53 @@
 
 #include "decoders.h"
 #include "sector.h"
+#include "sector_queue.h"
 
 class SectorCorrection : public Decoder
 {
 public:
     SectorCorrection();
     void pushSector(const Sector &sector);
-    Sector popSector();
+    void flush();
+    const Sector &headSector() const;
+    void popSector();
+    SectorRange popMissingRange();
     bool isReady() const;
+    bool isMissingRangeNext() const;
 
     void showStatistics();
 
 private:
-    void processQueue();
+    struct MissingRange {
+        SectorRange range;
+        quint64 position; // Number of sectors output before the range
+    };
 
-    QQueue<Sector> m_inputBuffer;
-    QQueue<Sector> m_outputBuffer;
+    void placeSector(const Sector &sector);
+    void outputSector(const Sector &sector);
+    void enqueueMissingRange(const SectorRange &range);
+
+    SectorQueue<Sector> m_outputBuffer;
+    QQueue<MissingRange> m_missingBuffer;
+    quint64 m_sectorsQueued;
+    quint64 m_sectorsPopped;
 
     bool m_haveLastSectorInfo;
     SectorAddress m_lastSectorAddress;
+    SectorAddress m_nextSectorAddress;
     qint32 m_lastSectorMode;
 
+    // A sector that jumps forward, held until its address is confirmed
+    bool m_havePendingSector;
+    Sector m_pendingSector;
+
     // Statistics
     quint32 m_goodSectors;
+    quint32 m_keptInvalidSectors;
     quint32 m_missingLeadingSectors;
     quint32 m_missingSectors;
+    quint32 m_droppedSectors;
+    quint32 m_droppedInvalidSectors;
 };
 
 #endif // DEC_SECTORCORRECTION_H
\ No newline at end of file
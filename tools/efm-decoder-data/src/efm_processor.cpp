@@ -25,7 +25,10 @@
 #include "efm_processor.h"
 
 EfmProcessor::EfmProcessor() : 
-    m_outputDataMetadata(false)
+    m_outputDataMetadata(false),
+    m_outputSectorMap(false),
+    m_outputCue(false),
+    m_outputSectorSize(2048)
 {}
 
 bool EfmProcessor::process(const QString &inputFilename, const QString &outputFilename)
@@ -40,15 +43,18 @@ bool EfmProcessor::process(const QString &inputFilename, const QString &outputFi
     }
 
     // Prepare the output file writers
-    m_writerSector.open(outputFilename);
+    if (!m_writerSector.open(outputFilename, m_outputSectorSize)) {
+        qDebug() << "EfmProcessor::process(): Failed to open output data file:" << outputFilename;
+        return false;
+    }
     if (m_outputDataMetadata) {
-        QString metadataFilename = outputFilename;
-        if (metadataFilename.endsWith(".dat")) {
-            metadataFilename.replace(".dat", ".bsm"); // Bad Sector Map
-        } else {
-            metadataFilename.append(".bsm");
-        }
-        m_writerSectorMetadata.open(metadataFilename);
+        m_writerSectorMetadata.open(sidecarFilename(outputFilename, ".bsm")); // Bad Sector Map
+    }
+    if (m_outputSectorMap) {
+        if (!m_writerSectorMap.open(sidecarFilename(outputFilename, ".smap"))) return false;
+    }
+    if (m_outputCue) {
+        if (!m_writerCue.open(sidecarFilename(outputFilename, ".cue"), outputFilename, m_outputSectorSize)) return false;
     }
 
     // Process the Data24 Section data
@@ -69,10 +75,11 @@ bool EfmProcessor::process(const QString &inputFilename, const QString &outputFi
 
     // We are out of data flush the pipeline and process it one last time
     qInfo() << "Flushing decoding pipelines";
-    // Nothing to do here at the moment...
+    m_rawSectorToSector.flush();
 
     qInfo() << "Processing final pipeline data";
     processDataPipeline();
+    m_sectorCorrection.flush();
 
     // Show summary
     qInfo() << "Decoding complete";
@@ -93,6 +100,8 @@ bool EfmProcessor::process(const QString &inputFilename, const QString &outputFi
     // Close the output files
     if (m_writerSector.isOpen()) m_writerSector.close();
     if (m_writerSectorMetadata.isOpen()) m_writerSectorMetadata.close();
+    if (m_writerSectorMap.isOpen()) m_writerSectorMap.close();
+    if (m_writerCue.isOpen()) m_writerCue.close();
 
     qInfo() << "Encoding complete";
     return true;
@@ -104,29 +113,58 @@ void EfmProcessor::processDataPipeline()
 
     // Raw sector to sector processing
     dataPipelineTimer.restart();
+    // (sectors are passed between the decoders by reference from their output
+    // queues, so each decoder makes at most one copy of a sector)
     while (m_data24ToRawSector.isReady()) {
-        RawSector rawSector = m_data24ToRawSector.popSector();
-        m_rawSectorToSector.pushSector(rawSector);
+        RawSector &rawSector = m_data24ToRawSector.headSector();
         if (m_showRawSector)
             rawSector.showData();
+        m_rawSectorToSector.pushSector(rawSector);
+        m_data24ToRawSector.popSector();
     }
     m_dataPipelineStats.rawSectorToSectorTime += dataPipelineTimer.nsecsElapsed();
 
     // Sector correction processing
     while (m_rawSectorToSector.isReady()) {
-        Sector sector = m_rawSectorToSector.popSector();
-        m_sectorCorrection.pushSector(sector);
+        m_sectorCorrection.pushSector(m_rawSectorToSector.headSector());
+        m_rawSectorToSector.popSector();
     }
 
     // Write out the sector data
     while (m_sectorCorrection.isReady()) {
-        Sector sector = m_sectorCorrection.popSector();
+        if (m_sectorCorrection.isMissingRangeNext()) {
+            SectorRange range = m_sectorCorrection.popMissingRange();
+            m_writerSector.writeMissing(range);
+            if (m_outputDataMetadata)
+                m_writerSectorMetadata.writeMissing(range);
+            if (m_outputSectorMap)
+                m_writerSectorMap.writeMissing(range);
+            continue;
+        }
+
+        const Sector &sector = m_sectorCorrection.headSector();
         m_writerSector.write(sector);
         if (m_outputDataMetadata)
             m_writerSectorMetadata.write(sector);
+        if (m_outputSectorMap)
+            m_writerSectorMap.write(sector);
+        if (m_outputCue)
+            m_writerCue.write(sector);
+        m_sectorCorrection.popSector();
     }
 }
 
+// Sidecar files are named after the output file, replacing a .dat or .bin
+// extension if present
+QString EfmProcessor::sidecarFilename(const QString &outputFilename, const QString &extension)
+{
+    QString filename = outputFilename;
+    if (filename.endsWith(".dat") || filename.endsWith(".bin")) {
+        filename.chop(4);
+    }
+    return filename + extension;
+}
+
 void EfmProcessor::showDataPipelineStatistics()
 {
     qInfo() << "Decoder processing summary (data):";
@@ -147,9 +185,22 @@ void EfmProcessor::setShowData(bool showRawSector)
 }
 
 // Set the output data type (true for WAV, false for raw)
-void EfmProcessor::setOutputType(bool outputDataMetadata)
+void EfmProcessor::setOutputType(bool outputDataMetadata, bool outputSectorMap, bool outputCue, qint32 outputSectorSize)
 {
     m_outputDataMetadata = outputDataMetadata;
+    m_outputSectorMap = outputSectorMap;
+    m_outputCue = outputCue;
+    m_outputSectorSize = outputSectorSize;
+}
+
+void EfmProcessor::setKeepInvalidSectors(bool keepInvalidSectors)
+{
+    m_rawSectorToSector.setKeepInvalidSectors(keepInvalidSectors);
+}
+
+void EfmProcessor::setThreads(qint32 threads)
+{
+    m_rawSectorToSector.setThreads(threads);
 }
 
 void EfmProcessor::setDebug(bool rawSector, bool sector, bool sectorCorrection)
@@ -37,6 +37,8 @@
 
 #include "writer_sector.h"
 #include "writer_sector_metadata.h"
+#include "writer_sector_map.h"
+#include "writer_cue.h"
 
 #include "reader_data24section.h"
 
@@ -47,7 +49,9 @@ public:
 
     bool process(const QString &inputFilename, const QString &outputFilename);
     void setShowData(bool showRawSector);
-    void setOutputType(bool outputDataMetadata);
+    void setOutputType(bool outputDataMetadata, bool outputSectorMap, bool outputCue, qint32 outputSectorSize);
+    void setKeepInvalidSectors(bool keepInvalidSectors);
+    void setThreads(qint32 threads);
     void setDebug(bool rawSector, bool sector, bool sectorCorrection);
     void showStatistics() const;
 
@@ -57,6 +61,9 @@ private:
 
     // Output options
     bool m_outputDataMetadata;
+    bool m_outputSectorMap;
+    bool m_outputCue;
+    qint32 m_outputSectorSize;
 
     // ECMA-130 Decoders
     Data24ToRawSector m_data24ToRawSector;
@@ -69,6 +76,8 @@ private:
     // Output file writers
     WriterSector m_writerSector;
     WriterSectorMetadata m_writerSectorMetadata;
+    WriterSectorMap m_writerSectorMap;
+    WriterCue m_writerCue;
 
     // Processing statistics
     struct DataPipelineStatistics {
@@ -78,6 +87,7 @@ private:
 
     void processDataPipeline();
     void showDataPipelineStatistics();
+    static QString sidecarFilename(const QString &outputFilename, const QString &extension);
 };
 
 #endif // EFM_PROCESSOR_H
\ No newline at end of file
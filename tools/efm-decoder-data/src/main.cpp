@@ -64,6 +64,15 @@ int main(int argc, char *argv[])
     QList<QCommandLineOption> outputTypeOptions = {
         QCommandLineOption("output-metadata",
                 QCoreApplication::translate("main", "Output bad sector map metadata")),
+        QCommandLineOption("output-sector-size",
+                QCoreApplication::translate("main", "Output sector size: 2048 (user data), 2336 (raw without sync and header) or 2352 (raw) (default 2048)"),
+                QCoreApplication::translate("main", "bytes")),
+        QCommandLineOption("output-sector-map",
+                QCoreApplication::translate("main", "Output binary sector map (per-sector status and error bitmap)")),
+        QCommandLineOption("output-cue",
+                QCoreApplication::translate("main", "Output a CUE sheet for the raw sector (BIN) output (sets 2352 byte sectors by default)")),
+        QCommandLineOption("keep-invalid-sectors",
+                QCoreApplication::translate("main", "Output uncorrectable sectors (flagged as bad) instead of treating them as missing, for use with efm-stacker-sector")),
     };
     parser.addOptions(outputTypeOptions);
 
@@ -87,6 +96,12 @@ int main(int argc, char *argv[])
     };
     parser.addOptions(advancedDebugOptions);
 
+    // Option to select the number of error correction threads
+    QCommandLineOption threadsOption(QStringList() << "t" << "threads",
+                                     QCoreApplication::translate("main", "Specify the number of sector error correction threads (default is the number of logical CPUs)"),
+                                     QCoreApplication::translate("main", "number"));
+    parser.addOption(threadsOption);
+
     // -- Positional arguments --
     parser.addPositionalArgument("input",
                                  QCoreApplication::translate("main", "Specify input Data24 Section file"));
@@ -101,6 +116,32 @@ int main(int argc, char *argv[])
 
     // Check for output data type options
     bool outputDataMetadata = parser.isSet("output-metadata");
+    bool outputSectorMap = parser.isSet("output-sector-map");
+    bool outputCue = parser.isSet("output-cue");
+    qint32 outputSectorSize = outputCue ? 2352 : 2048;
+    if (parser.isSet("output-sector-size")) {
+        bool ok = false;
+        outputSectorSize = parser.value("output-sector-size").toInt(&ok);
+        if (!ok || (outputSectorSize != 2048 && outputSectorSize != 2336 && outputSectorSize != 2352)) {
+            qCritical() << "The output sector size must be 2048, 2336 or 2352";
+            return 1;
+        }
+    }
+    if (outputCue && outputSectorSize == 2048) {
+        qCritical() << "CUE sheet output requires 2336 or 2352 byte sectors";
+        return 1;
+    }
+
+    // Check the number of threads
+    qint32 threads = QThread::idealThreadCount();
+    if (parser.isSet(threadsOption)) {
+        threads = parser.value(threadsOption).toInt();
+        if (threads < 1) {
+            // Quit with error
+            qCritical("Specified number of threads must be greater than zero");
+            return 1;
+        }
+    }
 
     // Check for frame data options
     bool showRawSector = parser.isSet("show-rawsector");
@@ -134,7 +175,9 @@ int main(int argc, char *argv[])
     EfmProcessor efmProcessor;
 
     efmProcessor.setShowData(showRawSector);
-    efmProcessor.setOutputType(outputDataMetadata);
+    efmProcessor.setOutputType(outputDataMetadata, outputSectorMap, outputCue, outputSectorSize);
+    efmProcessor.setKeepInvalidSectors(parser.isSet("keep-invalid-sectors"));
+    efmProcessor.setThreads(threads);
     efmProcessor.setDebug(showRawSectorDebug, showSectorDebug, showSectorCorrectionDebug);
 
     if (!efmProcessor.process(inputFilename, outputFilename)) {
@@ -0,0 +1,122 @@
+/************************************************************************
+
+    buffered_writer.cpp
+
+    efm-decoder-data - EFM Data24 to data decoder
+    Copyright (C) 2025 Simon Inns
+
+    This file is part of ld-decode-tools.
+
+    This application is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+************************************************************************/
+
+#include "buffered_writer.h"
+
+#include <cstring>
+
+BufferedWriter::BufferedWriter() :
+    m_used(0),
+    m_bytesWritten(0)
+{}
+
+BufferedWriter::~BufferedWriter()
+{
+    close();
+}
+
+bool BufferedWriter::open(const QString &filename)
+{
+    close();
+
+    m_file.setFileName(filename);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Unbuffered)) {
+        return false;
+    }
+
+    m_buffer.resize(BufferSize);
+    m_used = 0;
+    m_bytesWritten = 0;
+    return true;
+}
+
+void BufferedWriter::write(const char *data, qint64 size)
+{
+    if (!m_file.isOpen()) {
+        qCritical() << "BufferedWriter::write() - File is not open for writing";
+        return;
+    }
+
+    m_bytesWritten += size;
+
+    // Writes larger than the buffer go straight to the file
+    if (m_used + size > BufferSize) {
+        flush();
+        if (size >= BufferSize) {
+            if (m_file.write(data, size) != size) {
+                qCritical() << "BufferedWriter::write() - Failed to write to" << m_file.fileName() << "-" << m_file.errorString();
+            }
+            return;
+        }
+    }
+
+    std::memcpy(m_buffer.data() + m_used, data, size);
+    m_used += size;
+}
+
+// Skip over size bytes of the output, which will read as zero
+void BufferedWriter::skip(qint64 size)
+{
+    if (!m_file.isOpen()) {
+        qCritical() << "BufferedWriter::skip() - File is not open for writing";
+        return;
+    }
+
+    flush();
+    m_bytesWritten += size;
+    if (!m_file.seek(m_bytesWritten)) {
+        qCritical() << "BufferedWriter::skip() - Failed to seek in" << m_file.fileName() << "-" << m_file.errorString();
+    }
+}
+
+bool BufferedWriter::flush()
+{
+    if (!m_file.isOpen() || m_used == 0) {
+        return true;
+    }
+
+    const bool ok = m_file.write(m_buffer.constData(), m_used) == m_used;
+    if (!ok) {
+        qCritical() << "BufferedWriter::flush() - Failed to write to" << m_file.fileName() << "-" << m_file.errorString();
+    }
+    m_used = 0;
+    return ok;
+}
+
+void BufferedWriter::close()
+{
+    if (!m_file.isOpen()) {
+        return;
+    }
+
+    flush();
+
+    // If the file ends with a skipped region, extend the file to cover it
+    if (m_file.size() < m_bytesWritten) {
+        m_file.resize(m_bytesWritten);
+    }
+
+    m_file.close();
+    m_buffer.clear();
+}
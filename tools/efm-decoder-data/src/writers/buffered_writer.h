@@ -0,0 +1,62 @@
+/************************************************************************
+
+    buffered_writer.h
+
+    efm-decoder-data - EFM Data24 to data decoder
+    Copyright (C) 2025 Simon Inns
+
+    This file is part of ld-decode-tools.
+
+    This application is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+************************************************************************/
+
+#ifndef BUFFERED_WRITER_H
+#define BUFFERED_WRITER_H
+
+#include <QString>
+#include <QDebug>
+#include <QFile>
+#include <QByteArray>
+
+// Output file with a large write buffer, so that the writers can write each
+// sector (or metadata entry) individually without a system call per write.
+// Skipped regions are left as holes, so runs of zeros cost nothing to write
+// (and take no space on file systems that support sparse files)
+class BufferedWriter
+{
+public:
+    enum { BufferSize = 1024 * 1024 };
+
+    BufferedWriter();
+    ~BufferedWriter();
+
+    bool open(const QString &filename);
+    void write(const char *data, qint64 size);
+    void write(const QByteArray &data) { write(data.constData(), data.size()); }
+    void skip(qint64 size);
+    bool flush();
+    void close();
+    qint64 size() const { return m_bytesWritten; }
+    bool isOpen() const { return m_file.isOpen(); }
+    QString fileName() const { return m_file.fileName(); }
+
+private:
+    QFile m_file;
+    QByteArray m_buffer;
+    qint64 m_used;
+    qint64 m_bytesWritten;
+};
+
+#endif // BUFFERED_WRITER_H
@@ -0,0 +1,89 @@
+/************************************************************************
+
+    writer_cue.cpp
+
+    efm-decoder-data - EFM Data24 to data decoder
+    Copyright (C) 2025 Simon Inns
+
+    This file is part of ld-decode-tools.
+
+    This application is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+************************************************************************/
+
+#include "writer_cue.h"
+
+#include <QFileInfo>
+
+WriterCue::WriterCue() :
+    m_sectorSize(2352),
+    m_mode(-1)
+{}
+
+WriterCue::~WriterCue()
+{
+    close();
+}
+
+bool WriterCue::open(const QString &filename, const QString &binFilename, qint32 sectorSize)
+{
+    if (sectorSize != 2336 && sectorSize != 2352) {
+        qCritical() << "WriterCue::open() - CUE output requires 2336 or 2352 byte sectors";
+        return false;
+    }
+
+    if (!m_writer.open(filename)) {
+        qCritical() << "WriterCue::open() - Could not open file" << filename << "for writing";
+        return false;
+    }
+    qDebug() << "WriterCue::open() - Opened file" << filename << "for CUE sheet writing";
+
+    // The CUE sheet refers to the BIN file relative to itself
+    m_binFilename = QFileInfo(binFilename).fileName();
+    m_sectorSize = sectorSize;
+    m_mode = -1;
+    return true;
+}
+
+void WriterCue::write(const Sector &sector)
+{
+    if (m_mode == -1 && sector.isDataValid() && (sector.mode() == 1 || sector.mode() == 2)) {
+        m_mode = sector.mode();
+    }
+}
+
+void WriterCue::close()
+{
+    if (!m_writer.isOpen()) {
+        return;
+    }
+
+    // 2336 byte sectors are only meaningful for Mode 2
+    qint32 mode = m_mode;
+    if (m_sectorSize == 2336) mode = 2;
+    else if (mode == -1) mode = 1;
+
+    QByteArray cue;
+    cue.append("FILE \"").append(m_binFilename.toUtf8()).append("\" BINARY\n");
+    cue.append("  TRACK 01 MODE").append(QByteArray::number(mode)).append('/').append(QByteArray::number(m_sectorSize)).append('\n');
+    // The BIN file starts at address 00:00:00 (missing leading sectors are
+    // filled), so the first 150 sectors are the track 1 pregap and LBA 0
+    // (00:02:00) is 150 sectors in
+    cue.append("    INDEX 00 00:00:00\n");
+    cue.append("    INDEX 01 00:02:00\n");
+    m_writer.write(cue);
+
+    m_writer.close();
+    qDebug() << "WriterCue::close(): Closed the CUE sheet file" << m_writer.fileName();
+}
@@ -0,0 +1,55 @@
+/************************************************************************
+
+    writer_cue.h
+
+    efm-decoder-data - EFM Data24 to data decoder
+    Copyright (C) 2025 Simon Inns
+
+    This file is part of ld-decode-tools.
+
+    This application is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+************************************************************************/
+
+#ifndef WRITER_CUE_H
+#define WRITER_CUE_H
+
+#include <QString>
+#include <QDebug>
+
+#include "sector.h"
+#include "buffered_writer.h"
+
+// Writes a CUE sheet describing the raw sector (BIN) output as a single data
+// track.  The track mode is taken from the first valid sector, so the sheet
+// is only written when the writer is closed
+class WriterCue
+{
+public:
+    WriterCue();
+    ~WriterCue();
+
+    bool open(const QString &filename, const QString &binFilename, qint32 sectorSize);
+    void write(const Sector &sector);
+    void close();
+    bool isOpen() const { return m_writer.isOpen(); };
+
+private:
+    BufferedWriter m_writer;
+    QString m_binFilename;
+    qint32 m_sectorSize;
+    qint32 m_mode;
+};
+
+#endif // WRITER_CUE_H
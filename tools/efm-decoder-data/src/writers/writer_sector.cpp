@@ -24,56 +24,102 @@
 
 #include "writer_sector.h"
 
+#include <cstring>
+
 // This writer class writes raw data to a file directly from the Data24 sections
 // This is (generally) used when the output is not stereo audio data
 
-WriterSector::WriterSector() { }
+WriterSector::WriterSector() :
+    m_sectorSize(2048)
+{
+    // Missing raw sectors are written as a Mode 1 sync pattern and header with
+    // zero data
+    static const quint8 syncPattern[12] = { 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00 };
+    std::memset(m_missingSector, 0, sizeof(m_missingSector));
+    std::memcpy(m_missingSector, syncPattern, sizeof(syncPattern));
+    m_missingSector[15] = 1;
+}
 
 WriterSector::~WriterSector()
 {
-    if (m_file.isOpen()) {
-        m_file.close();
-    }
+    close();
 }
 
-bool WriterSector::open(const QString &filename)
+// The sector size can be 2048 (user data only), 2336 (raw sector without the
+// sync pattern and header) or 2352 (the complete raw sector)
+bool WriterSector::open(const QString &filename, qint32 sectorSize)
 {
-    m_file.setFileName(filename);
-    if (!m_file.open(QIODevice::WriteOnly)) {
+    if (sectorSize != 2048 && sectorSize != 2336 && sectorSize != 2352) {
+        qCritical() << "WriterSector::open() - Invalid sector size of" << sectorSize;
+        return false;
+    }
+    m_sectorSize = sectorSize;
+
+    if (!m_writer.open(filename)) {
         qCritical() << "WriterSector::open() - Could not open file" << filename << "for writing";
         return false;
     }
-    qDebug() << "WriterSector::open() - Opened file" << filename << "for data writing";
+    qDebug() << "WriterSector::open() - Opened file" << filename << "for data writing with" << m_sectorSize << "byte sectors";
     return true;
 }
 
 void WriterSector::write(const Sector &sector)
 {
-    if (!m_file.isOpen()) {
+    if (!m_writer.isOpen()) {
         qCritical() << "WriterSector::write() - File is not open for writing";
         return;
     }
 
-    // Each sector contains 2048 bytes that we need to write to the output file
-    m_file.write(reinterpret_cast<const char *>(sector.data().data()),
-                    sector.size() * sizeof(uint8_t));
+    // For 2048 byte output only the first 2048 bytes of user data are written
+    // (so Mode 2 Form 2 sectors are truncated), otherwise the raw sector is
+    // written with or without the sync pattern and header
+    switch (m_sectorSize) {
+        case 2336:
+            m_writer.write(reinterpret_cast<const char *>(sector.rawData() + 16), 2336);
+            break;
+        case 2352:
+            m_writer.write(reinterpret_cast<const char *>(sector.rawData()), 2352);
+            break;
+        default:
+            m_writer.write(reinterpret_cast<const char *>(sector.data()), 2048);
+            break;
+    }
 }
 
-void WriterSector::close()
+// Missing sectors are zero filled.  For 2048 and 2336 byte output the whole
+// range is skipped in one go (leaving a hole in the file), for 2352 byte output
+// each sector needs a sync pattern and header to keep the image readable
+void WriterSector::writeMissing(const SectorRange &range)
 {
-    if (!m_file.isOpen()) {
+    if (!m_writer.isOpen()) {
+        qCritical() << "WriterSector::writeMissing() - File is not open for writing";
+        return;
+    }
+
+    if (m_sectorSize != 2352) {
+        m_writer.skip(static_cast<qint64>(range.count()) * m_sectorSize);
         return;
     }
 
-    m_file.close();
-    qDebug() << "WriterSector::close(): Closed the data file" << m_file.fileName();
+    SectorAddress address = range.first();
+    for (qint32 i = 0; i < range.count(); i++, address++) {
+        address.toBcd(m_missingSector + 12);
+        m_writer.write(reinterpret_cast<const char *>(m_missingSector), RawSector::Size);
+    }
 }
 
-qint64 WriterSector::size() const
+void WriterSector::close()
 {
-    if (m_file.isOpen()) {
-        return m_file.size();
+    if (!m_writer.isOpen()) {
+        return;
     }
 
-    return 0;
+    m_writer.close();
+    qDebug() << "WriterSector::close(): Closed the data file" << m_writer.fileName();
+}
+
+qint64 WriterSector::size() const
+{
+    return m_writer.size();
 }
\ No newline at end of file
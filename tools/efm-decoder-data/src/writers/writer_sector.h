@@ -30,6 +30,7 @@
 #include <QFile>
 
 #include "sector.h"
+#include "buffered_writer.h"
 
 class WriterSector
 {
@@ -37,14 +38,17 @@ public:
     WriterSector();
     ~WriterSector();
 
-    bool open(const QString &filename);
+    bool open(const QString &filename, qint32 sectorSize = 2048);
     void write(const Sector &sector);
+    void writeMissing(const SectorRange &range);
     void close();
     qint64 size() const;
-    bool isOpen() const { return m_file.isOpen(); };
+    bool isOpen() const { return m_writer.isOpen(); };
 
 private:
-    QFile m_file;
+    BufferedWriter m_writer;
+    qint32 m_sectorSize;
+    quint8 m_missingSector[RawSector::Size];
 };
 
 #endif // WRITER_SECTOR_H
\ No newline at end of file
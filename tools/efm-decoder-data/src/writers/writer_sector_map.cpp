@@ -0,0 +1,85 @@
+/************************************************************************
+
+    writer_sector_map.cpp
+
+    efm-decoder-data - EFM Data24 to data decoder
+    Copyright (C) 2025 Simon Inns
+
+    This file is part of ld-decode-tools.
+
+    This application is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+************************************************************************/
+
+#include "writer_sector_map.h"
+
+WriterSectorMap::WriterSectorMap()
+{}
+
+WriterSectorMap::~WriterSectorMap()
+{
+    close();
+}
+
+bool WriterSectorMap::open(const QString &filename)
+{
+    if (!m_writer.open(filename)) {
+        qCritical() << "WriterSectorMap::open() - Could not open file" << filename << "for writing";
+        return false;
+    }
+    qDebug() << "WriterSectorMap::open() - Opened file" << filename << "for sector map writing";
+
+    quint8 header[SectorMap::HeaderSize];
+    SectorMap::encodeHeader(header);
+    m_writer.write(reinterpret_cast<const char *>(header), SectorMap::HeaderSize);
+
+    return true;
+}
+
+void WriterSectorMap::write(const Sector &sector)
+{
+    if (!m_writer.isOpen()) {
+        qCritical() << "WriterSectorMap::write() - File is not open for writing";
+        return;
+    }
+
+    SectorMap::encodeRecord(sector, m_record);
+    m_writer.write(reinterpret_cast<const char *>(m_record), SectorMap::RecordSize);
+}
+
+// Missing sectors are left as zero records (a hole in the file)
+void WriterSectorMap::writeMissing(const SectorRange &range)
+{
+    if (!m_writer.isOpen()) {
+        qCritical() << "WriterSectorMap::writeMissing() - File is not open for writing";
+        return;
+    }
+
+    m_writer.skip(static_cast<qint64>(range.count()) * SectorMap::RecordSize);
+}
+
+void WriterSectorMap::close()
+{
+    if (!m_writer.isOpen()) {
+        return;
+    }
+
+    m_writer.close();
+    qDebug() << "WriterSectorMap::close(): Closed the sector map file" << m_writer.fileName();
+}
+
+qint64 WriterSectorMap::size() const
+{
+    return m_writer.size();
+}
@@ -0,0 +1,55 @@
+/************************************************************************
+
+    writer_sector_map.h
+
+    efm-decoder-data - EFM Data24 to data decoder
+    Copyright (C) 2025 Simon Inns
+
+    This file is part of ld-decode-tools.
+
+    This application is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+************************************************************************/
+
+#ifndef WRITER_SECTOR_MAP_H
+#define WRITER_SECTOR_MAP_H
+
+#include <QString>
+#include <QDebug>
+
+#include "sector.h"
+#include "sector_map.h"
+#include "buffered_writer.h"
+
+// Writes the binary sector map (per-sector status and error bitmap, see
+// sector_map.h for the format)
+class WriterSectorMap
+{
+public:
+    WriterSectorMap();
+    ~WriterSectorMap();
+
+    bool open(const QString &filename);
+    void write(const Sector &sector);
+    void writeMissing(const SectorRange &range);
+    void close();
+    qint64 size() const;
+    bool isOpen() const { return m_writer.isOpen(); };
+
+private:
+    BufferedWriter m_writer;
+    quint8 m_record[SectorMap::RecordSize];
+};
+
+#endif // WRITER_SECTOR_MAP_H
@@ -31,15 +31,12 @@ WriterSectorMetadata::WriterSectorMetadata()
 
 WriterSectorMetadata::~WriterSectorMetadata()
 {
-    if (m_file.isOpen()) {
-        m_file.close();
-    }
+    close();
 }
 
 bool WriterSectorMetadata::open(const QString &filename)
 {
-    m_file.setFileName(filename);
-    if (!m_file.open(QIODevice::WriteOnly)) {
+    if (!m_writer.open(filename)) {
         qCritical() << "WriterSectorMetadata::open() - Could not open file" << filename << "for writing";
         return false;
     }
@@ -50,7 +47,7 @@ bool WriterSectorMetadata::open(const QString &filename)
 
 void WriterSectorMetadata::write(const Sector &sector)
 {
-    if (!m_file.isOpen()) {
+    if (!m_writer.isOpen()) {
         qCritical() << "WriterSectorMetadata::write() - File is not open for writing";
         return;
     }
@@ -58,26 +55,40 @@ void WriterSectorMetadata::write(const Sector &sector)
     // If the sector is not valid, write a metadata entry for it
     if (!sector.isDataValid()) {
         // Write a metadata entry for the sector
-        QString metadata = QString::number(sector.address().address()) + "\n";
-        m_file.write(metadata.toUtf8());
+        QByteArray metadata = QByteArray::number(sector.address().address());
+        metadata.append('\n');
+        m_writer.write(metadata);
     }
 }
 
-void WriterSectorMetadata::close()
+// A range of missing sectors is written as a single "first-last" entry
+void WriterSectorMetadata::writeMissing(const SectorRange &range)
 {
-    if (!m_file.isOpen()) {
+    if (!m_writer.isOpen()) {
+        qCritical() << "WriterSectorMetadata::writeMissing() - File is not open for writing";
         return;
     }
 
-    m_file.close();
-    qDebug() << "WriterSectorMetadata::close(): Closed the bad sector map metadata file" << m_file.fileName();
+    QByteArray metadata = QByteArray::number(range.first().address());
+    if (range.count() > 1) {
+        metadata.append('-');
+        metadata.append(QByteArray::number(range.last().address()));
+    }
+    metadata.append('\n');
+    m_writer.write(metadata);
 }
 
-qint64 WriterSectorMetadata::size() const
+void WriterSectorMetadata::close()
 {
-    if (m_file.isOpen()) {
-        return m_file.size();
+    if (!m_writer.isOpen()) {
+        return;
     }
 
-    return 0;
+    m_writer.close();
+    qDebug() << "WriterSectorMetadata::close(): Closed the bad sector map metadata file" << m_writer.fileName();
+}
+
+qint64 WriterSectorMetadata::size() const
+{
+    return m_writer.size();
 }
\ No newline at end of file
@@ -30,6 +30,7 @@
 #include <QFile>
 
 #include "sector.h"
+#include "buffered_writer.h"
 
 class WriterSectorMetadata
 {
@@ -39,12 +40,13 @@ public:
 
     bool open(const QString &filename);
     void write(const Sector &sector);
+    void writeMissing(const SectorRange &range);
     void close();
     qint64 size() const;
-    bool isOpen() const { return m_file.isOpen(); };
+    bool isOpen() const { return m_writer.isOpen(); };
 
 private:
-    QFile m_file;
+    BufferedWriter m_writer;
 };
 
 #endif // WRITER_SECTOR_METADATA_H
\ No newline at end of file
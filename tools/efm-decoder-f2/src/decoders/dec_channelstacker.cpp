@@ -0,0 +1,307 @@
+/************************************************************************
+
+    dec_channelstacker.cpp
+
+    efm-decoder-f2 - EFM T-values to F2 Section decoder
+    Copyright (C) 2025 Simon Inns
+
+    This file is part of ld-decode-tools.
+
+    This application is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+************************************************************************/
+
+#include "dec_channelstacker.h"
+#include "dec_channeltof3frame.h"
+
+ChannelStacker::ChannelStacker(qint32 sourceCount) :
+    m_sources(sourceCount),
+    m_lastOutputTime(-1),
+    m_stackedSections(0),
+    m_singleSourceSections(0),
+    m_unalignedSections(0),
+    m_discardedSections(0),
+    m_unplacedSections(0),
+    m_agreedSymbols(0),
+    m_votedSymbols(0),
+    m_recoveredSymbols(0),
+    m_unrecoverableSymbols(0)
+{}
+
+void ChannelStacker::pushFrame(qint32 sourceIndex, const QVector<quint16> &symbols, quint32 bitCount)
+{
+    Source &source = m_sources[sourceIndex];
+
+    // A sync0 subcode symbol marks the start of a section
+    if (m_efm.fourteenToEight(symbols.at(0)) == 256) {
+        if (source.started) closeSection(source);
+        source.started = true;
+    }
+
+    // Discard frames until the first section start is seen
+    if (!source.started) return;
+
+    source.symbols.append(symbols);
+    source.bitCounts.append(bitCount);
+
+    processQueue();
+}
+
+// Mark the source as having no more data
+void ChannelStacker::flush(qint32 sourceIndex)
+{
+    Source &source = m_sources[sourceIndex];
+    if (source.started && !source.symbols.isEmpty()) closeSection(source);
+    source.ended = true;
+
+    processQueue();
+}
+
+// A source needs more data if it has no complete section waiting to be stacked
+bool ChannelStacker::needsData(qint32 sourceIndex) const
+{
+    return !m_sources[sourceIndex].ended && m_sources[sourceIndex].sections.isEmpty();
+}
+
+bool ChannelStacker::isFinished() const
+{
+    for (int i = 0; i < m_sources.size(); ++i) {
+        if (!m_sources[i].ended || !m_sources[i].sections.isEmpty()) return false;
+    }
+    return true;
+}
+
+QVector<quint16> ChannelStacker::popFrame(quint8 &qualityFlags)
+{
+    qualityFlags = m_outputQualityFlags.dequeue();
+    return m_outputBuffer.dequeue();
+}
+
+bool ChannelStacker::isReady() const
+{
+    return !m_outputBuffer.isEmpty();
+}
+
+// Place the source's current frames into a section and work out its time.  Sections
+// without valid Q-channel metadata are assumed to follow the previous section
+void ChannelStacker::closeSection(Source &source)
+{
+    ChannelSection section;
+    section.symbols = source.symbols;
+    section.bitCounts = source.bitCounts;
+    section.time = -1;
+    source.symbols.clear();
+    source.bitCounts.clear();
+
+    if (section.symbols.size() == 98) {
+        QByteArray subcodeData;
+        for (int i = 0; i < 98; ++i) {
+            quint16 subcode = m_efm.fourteenToEight(section.symbols.at(i).at(0));
+            subcodeData.append(static_cast<char>(subcode < 256 ? subcode : 0));
+        }
+
+        SectionMetadata metadata = m_subcode.fromData(subcodeData);
+        if (metadata.isValid()) section.time = metadata.absoluteSectionTime().frames();
+    }
+
+    if (section.time == -1) {
+        if (source.lastTime == -1 || source.lastTime + 1 >= 270000) {
+            m_unplacedSections++;
+            return;
+        }
+        section.time = source.lastTime + 1;
+    }
+
+    source.lastTime = section.time;
+    source.sections.enqueue(section);
+}
+
+void ChannelStacker::processQueue()
+{
+    while (true) {
+        // Wait until every source that is still providing data has a section queued
+        bool haveSections = false;
+        for (int i = 0; i < m_sources.size(); ++i) {
+            if (m_sources[i].sections.isEmpty()) {
+                if (!m_sources[i].ended) return;
+            } else {
+                haveSections = true;
+            }
+        }
+        if (!haveSections) return;
+
+        // Find the earliest section time, dropping any sections that are
+        // earlier than the last output section (i.e. out of order sections)
+        qint32 time = -1;
+        for (int i = 0; i < m_sources.size(); ++i) {
+            QQueue<ChannelSection> &sections = m_sources[i].sections;
+            while (!sections.isEmpty() && sections.head().time <= m_lastOutputTime) {
+                sections.dequeue();
+                m_discardedSections++;
+            }
+            if (!sections.isEmpty() && (time == -1 || sections.head().time < time)) {
+                time = sections.head().time;
+            }
+        }
+        if (time == -1) continue;
+
+        // Gather the sections for that time from each source
+        QVector<ChannelSection> alignedSections;
+        QVector<ChannelSection> unalignedSections;
+        for (int i = 0; i < m_sources.size(); ++i) {
+            QQueue<ChannelSection> &sections = m_sources[i].sections;
+            if (!sections.isEmpty() && sections.head().time == time) {
+                if (sections.head().symbols.size() == 98)
+                    alignedSections.append(sections.dequeue());
+                else
+                    unalignedSections.append(sections.dequeue());
+            }
+        }
+
+        if (!alignedSections.isEmpty()) {
+            stackSections(alignedSections);
+            m_discardedSections += unalignedSections.size();
+        } else {
+            // Nothing can be aligned; pass the first section through and let
+            // the F3 to F2 section decoder deal with the frame count
+            const ChannelSection &section = unalignedSections.first();
+            for (int i = 0; i < section.symbols.size(); ++i) {
+                m_outputBuffer.enqueue(section.symbols.at(i));
+                m_outputQualityFlags.enqueue(section.bitCounts.at(i) == 588 ? 0 : FrameBitCountError);
+            }
+            m_unalignedSections++;
+            m_discardedSections += unalignedSections.size() - 1;
+        }
+
+        m_lastOutputTime = time;
+    }
+}
+
+void ChannelStacker::stackSections(const QVector<ChannelSection> &sections)
+{
+    if (sections.size() == 1)
+        m_singleSourceSections++;
+    else
+        m_stackedSections++;
+
+    for (int frameIndex = 0; frameIndex < 98; ++frameIndex) {
+        QVector<quint16> symbols(33);
+        for (int symbolIndex = 0; symbolIndex < 33; ++symbolIndex) {
+            symbols[symbolIndex] = voteSymbol(sections, frameIndex, symbolIndex);
+        }
+
+        // The stacked frame only has a bit count error if every source did
+        bool bitCountError = true;
+        for (int i = 0; i < sections.size(); ++i) {
+            if (sections.at(i).bitCounts.at(frameIndex) == 588) bitCountError = false;
+        }
+
+        m_outputBuffer.enqueue(symbols);
+        m_outputQualityFlags.enqueue(bitCountError ? FrameBitCountError : 0);
+    }
+}
+
+// Vote on a single 14-bit symbol.  Valid symbols are voted on (weighted towards
+// sources with a 588 bit channel frame); if no source has a valid symbol and
+// there are 3 or more sources, a bit-wise majority vote is tried
+quint16 ChannelStacker::voteSymbol(const QVector<ChannelSection> &sections, qint32 frameIndex, qint32 symbolIndex)
+{
+    const qint32 sourceCount = sections.size();
+    const quint16 firstSymbol = sections.at(0).symbols.at(frameIndex).at(symbolIndex);
+
+    bool allSame = true;
+    for (int i = 1; i < sourceCount; ++i) {
+        if (sections.at(i).symbols.at(frameIndex).at(symbolIndex) != firstSymbol) {
+            allSame = false;
+            break;
+        }
+    }
+    if (allSame) {
+        if (sourceCount > 1) m_agreedSymbols++;
+        return firstSymbol;
+    }
+
+    // Weighted vote over the valid symbols (ties go to the earliest source)
+    quint16 bestSymbol = 0;
+    qint32 bestWeight = 0;
+    for (int i = 0; i < sourceCount; ++i) {
+        const quint16 symbol = sections.at(i).symbols.at(frameIndex).at(symbolIndex);
+        if (!isValidSymbol(symbol)) continue;
+
+        qint32 weight = 0;
+        for (int j = i; j < sourceCount; ++j) {
+            if (sections.at(j).symbols.at(frameIndex).at(symbolIndex) == symbol) {
+                weight += (sections.at(j).bitCounts.at(frameIndex) == 588) ? 2 : 1;
+            }
+        }
+        if (weight > bestWeight) {
+            bestWeight = weight;
+            bestSymbol = symbol;
+        }
+    }
+
+    if (bestWeight > 0) {
+        m_votedSymbols++;
+        return bestSymbol;
+    }
+
+    // No valid symbols - try a bit-wise majority vote of the channel bits
+    if (sourceCount >= 3) {
+        qint32 bitVotes[14] = { 0 };
+        qint32 voters = 0;
+        for (int i = 0; i < sourceCount; ++i) {
+            const quint16 symbol = sections.at(i).symbols.at(frameIndex).at(symbolIndex);
+            if (symbol == ChannelToF3Frame::PaddingSymbol) continue;
+            for (int bit = 0; bit < 14; ++bit) {
+                if (symbol & (1 << bit)) bitVotes[bit]++;
+            }
+            voters++;
+        }
+
+        quint16 symbol = 0;
+        for (int bit = 0; bit < 14; ++bit) {
+            if (bitVotes[bit] * 2 > voters) symbol |= (1 << bit);
+        }
+
+        if (voters >= 3 && isValidSymbol(symbol)) {
+            if (m_showDebug) qDebug() << "ChannelStacker::voteSymbol(): Recovered symbol" << symbolIndex << "of frame" << frameIndex << "using a bit-wise vote";
+            m_recoveredSymbols++;
+            return symbol;
+        }
+    }
+
+    m_unrecoverableSymbols++;
+    return firstSymbol;
+}
+
+bool ChannelStacker::isValidSymbol(quint16 symbol) const
+{
+    return symbol != ChannelToF3Frame::PaddingSymbol && m_efm.fourteenToEight(symbol) != 300;
+}
+
+void ChannelStacker::showStatistics()
+{
+    qInfo() << "Channel stacker statistics:";
+    qInfo() << "  Sections:";
+    qInfo() << "    Stacked from multiple sources:" << m_stackedSections;
+    qInfo() << "    Single source:" << m_singleSourceSections;
+    qInfo() << "    Unaligned (passed through):" << m_unalignedSections;
+    qInfo() << "    Discarded:" << m_discardedSections;
+    qInfo() << "    Unplaced:" << m_unplacedSections;
+    qInfo() << "  Channel symbols:";
+    qInfo() << "    Agreed:" << m_agreedSymbols;
+    qInfo() << "    Voted:" << m_votedSymbols;
+    qInfo() << "    Recovered (bit-wise vote):" << m_recoveredSymbols;
+    qInfo() << "    Unrecoverable:" << m_unrecoverableSymbols;
+}
@@ -0,0 +1,93 @@
+/************************************************************************
+
+    dec_channelstacker.h
+
+    efm-decoder-f2 - EFM T-values to F2 Section decoder
+    Copyright (C) 2025 Simon Inns
+
+    This file is part of ld-decode-tools.
+
+    This application is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+************************************************************************/
+
+#ifndef DEC_CHANNELSTACKER_H
+#define DEC_CHANNELSTACKER_H
+
+#include "decoders.h"
+#include "efm.h"
+#include "subcode.h"
+
+// Stacks channel frames from multiple captures of the same disc.  The frames
+// of each source are grouped into sections (using the sync0 subcode symbol),
+// aligned by section time and then voted on at the 14-bit channel symbol
+// level before the symbols are EFM decoded
+class ChannelStacker : public Decoder
+{
+public:
+    ChannelStacker(qint32 sourceCount);
+    void pushFrame(qint32 source, const QVector<quint16> &symbols, quint32 bitCount);
+    void flush(qint32 source);
+    bool needsData(qint32 source) const;
+    bool isFinished() const;
+
+    QVector<quint16> popFrame(quint8 &qualityFlags);
+    bool isReady() const;
+
+    void showStatistics();
+
+private:
+    struct ChannelSection {
+        qint32 time;
+        QVector<QVector<quint16>> symbols;
+        QVector<quint32> bitCounts;
+    };
+
+    struct Source {
+        Source() : started(false), ended(false), lastTime(-1) {}
+        bool started;
+        bool ended;
+        qint32 lastTime;
+        QVector<QVector<quint16>> symbols;
+        QVector<quint32> bitCounts;
+        QQueue<ChannelSection> sections;
+    };
+
+    void closeSection(Source &source);
+    void processQueue();
+    void stackSections(const QVector<ChannelSection> &sections);
+    quint16 voteSymbol(const QVector<ChannelSection> &sections, qint32 frameIndex, qint32 symbolIndex);
+    bool isValidSymbol(quint16 symbol) const;
+
+    Efm m_efm;
+    Subcode m_subcode;
+    QVector<Source> m_sources;
+    qint32 m_lastOutputTime;
+
+    QQueue<QVector<quint16>> m_outputBuffer;
+    QQueue<quint8> m_outputQualityFlags;
+
+    // Statistics
+    quint32 m_stackedSections;
+    quint32 m_singleSourceSections;
+    quint32 m_unalignedSections;
+    quint32 m_discardedSections;
+    quint32 m_unplacedSections;
+    quint64 m_agreedSymbols;
+    quint64 m_votedSymbols;
+    quint64 m_recoveredSymbols;
+    quint64 m_unrecoverableSymbols;
+};
+
+#endif // DEC_CHANNELSTACKER_H
@@ -24,6 +24,8 @@
 
 #include "dec_channeltof3frame.h"
 
+const quint16 ChannelToF3Frame::PaddingSymbol;
+
 ChannelToF3Frame::ChannelToF3Frame()
 {
     // Statistics
@@ -83,17 +85,28 @@ void ChannelToF3Frame::processQueue()
             m_overshootFrames++;
 
         // Create an F3 frame
-        F3Frame f3Frame = createF3Frame(frameData);
+        F3Frame f3Frame = createF3Frame(channelSymbols(frameData));
+
+        // Flag frames with the wrong number of bits as lower quality
+        if (bitCount != 588)
+            f3Frame.setQualityFlags(f3Frame.qualityFlags() | FrameBitCountError);
 
         // Place the frame into the output buffer
         m_outputBuffer.enqueue(f3Frame);
     }
 }
 
-F3Frame ChannelToF3Frame::createF3Frame(const QByteArray &tValues)
+void ChannelToF3Frame::pushSymbols(const QVector<quint16> &symbols, quint8 qualityFlags)
 {
-    F3Frame f3Frame;
+    // Create an F3 frame from channel symbols that have already been extracted
+    // (i.e. by the channel stacker) and place it into the output buffer
+    F3Frame f3Frame = createF3Frame(symbols);
+    f3Frame.setQualityFlags(f3Frame.qualityFlags() | qualityFlags);
+    m_outputBuffer.enqueue(f3Frame);
+}
 
+QVector<quint16> ChannelToF3Frame::channelSymbols(const QByteArray &tValues)
+{
     // The channel frame data is:
     //   Sync Header: 24 bits (bits 0-23)
     //   Merging bits: 3 bits (bits 24-26)
@@ -108,20 +121,48 @@ F3Frame ChannelToF3Frame::createF3Frame(const QByteArray &tValues)
     // Convert the T-values to data
     QByteArray frameData = tvaluesToData(tValues);
 
-    // Extract the subcode in bits 27-40
-    quint16 subcode = m_efm.fourteenToEight(getBits(frameData, 27, 40));
+    // Extract the subcode in bits 27-40 followed by the data values in
+    // bits 44-587 ignoring the merging bits
+    QVector<quint16> symbols;
+    symbols.reserve(33);
+    symbols.append(getBits(frameData, 27, 40));
+    for (int i = 44; i < (frameData.size() * 8) - 13; i += 17) {
+        symbols.append(getBits(frameData, i, i + 13));
+    }
+
+    // If the data values are not a multiple of 32 (due to undershoot), pad
+    while (symbols.size() < 33) {
+        symbols.append(PaddingSymbol);
+    }
+
+    return symbols;
+}
+
+F3Frame ChannelToF3Frame::createF3Frame(const QVector<quint16> &symbols)
+{
+    F3Frame f3Frame;
+
+    // Decode the subcode symbol
+    quint16 subcode = m_efm.fourteenToEight(symbols.at(0));
     if (subcode == 300) {
         subcode = 0;
+        f3Frame.setQualityFlags(FrameSubcodeError);
         m_invalidSubcodeSymbols++;
     } else {
         m_validSubcodeSymbols++;
     }
 
-    // Extract the data values in bits 44-587 ignoring the merging bits
+    // Decode the data symbols
     QVector<quint8> dataValues;
     QVector<bool> errorValues;
-    for (int i = 44; i < (frameData.size() * 8) - 13; i += 17) {
-        quint16 dataValue = m_efm.fourteenToEight(getBits(frameData, i, i + 13));
+    for (int i = 1; i < symbols.size(); ++i) {
+        if (symbols.at(i) == PaddingSymbol) {
+            dataValues.append(0);
+            errorValues.append(true);
+            continue;
+        }
+
+        quint16 dataValue = m_efm.fourteenToEight(symbols.at(i));
 
         if (dataValue < 256) {
             dataValues.append(dataValue);
@@ -134,12 +175,6 @@ F3Frame ChannelToF3Frame::createF3Frame(const QByteArray &tValues)
         }
     }
 
-    // If the data values are not a multiple of 32 (due to undershoot), pad with zeros
-    while (dataValues.size() < 32) {
-        dataValues.append(0);
-        errorValues.append(true);
-    }
-
     // Create an F3 frame...
 
     // Determine the frame type
@@ -237,11 +272,14 @@ quint16 ChannelToF3Frame::getBits(const QByteArray &data, int startBit, int endB
 void ChannelToF3Frame::showStatistics()
 {
     qInfo() << "Channel to F3 Frame statistics:";
-    qInfo() << "  Channel Frames:";
-    qInfo() << "    Total:" << m_goodFrames + m_undershootFrames + m_overshootFrames;
-    qInfo() << "    Good:" << m_goodFrames;
-    qInfo() << "    Undershoot:" << m_undershootFrames;
-    qInfo() << "    Overshoot:" << m_overshootFrames;
+    // Note: Frames pushed as symbols (when stacking) are counted by the channel stacker
+    if (m_goodFrames + m_undershootFrames + m_overshootFrames > 0) {
+        qInfo() << "  Channel Frames:";
+        qInfo() << "    Total:" << m_goodFrames + m_undershootFrames + m_overshootFrames;
+        qInfo() << "    Good:" << m_goodFrames;
+        qInfo() << "    Undershoot:" << m_undershootFrames;
+        qInfo() << "    Overshoot:" << m_overshootFrames;
+    }
     qInfo() << "  EFM symbols:";
     qInfo() << "    Valid:" << m_validEfmSymbols;
     qInfo() << "    Invalid:" << m_invalidEfmSymbols;
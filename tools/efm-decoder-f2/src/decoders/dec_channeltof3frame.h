@@ -33,14 +33,19 @@ class ChannelToF3Frame : public Decoder
 public:
     ChannelToF3Frame();
     void pushFrame(const QByteArray &data);
+    void pushSymbols(const QVector<quint16> &symbols, quint8 qualityFlags);
     F3Frame popFrame();
     bool isReady() const;
 
+    // Symbol 0 is the subcode symbol, symbols 1-32 are the data symbols
+    QVector<quint16> channelSymbols(const QByteArray &tValues);
+    static const quint16 PaddingSymbol = 0xFFFF;
+
     void showStatistics();
 
 private:
     void processQueue();
-    F3Frame createF3Frame(const QByteArray &data);
+    F3Frame createF3Frame(const QVector<quint16> &symbols);
 
     QByteArray tvaluesToData(const QByteArray &tvalues);
     quint16 getBits(const QByteArray &data, int startBit, int endBit);
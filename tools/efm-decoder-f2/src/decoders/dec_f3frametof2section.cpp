@@ -287,6 +287,7 @@ void F3FrameToF2Section::outputSection(bool showAddress)
         F2Frame f2Frame;
         f2Frame.setData(m_sectionFrames[index].data());
         f2Frame.setErrorData(m_sectionFrames[index].errorData());
+        f2Frame.setQualityFlags(m_sectionFrames[index].qualityFlags());
         f2Section.pushFrame(f2Frame);
     }
 
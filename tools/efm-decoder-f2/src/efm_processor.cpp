@@ -26,7 +26,9 @@
 
 EfmProcessor::EfmProcessor() : 
     m_showF2(false),
-    m_showF3(false)
+    m_showF3(false),
+    m_showTvaluesDebug(false),
+    m_showChannelDebug(false)
 {}
 
 bool EfmProcessor::process(const QString &inputFilename, const QString &outputFilename)
@@ -101,6 +103,119 @@ bool EfmProcessor::process(const QString &inputFilename, const QString &outputFi
     return true;
 }
 
+// Decode multiple captures of the same disc, stacking them at the channel
+// symbol level before EFM decoding
+bool EfmProcessor::processStacked(const QVector<QString> &inputFilenames, const QString &outputFilename)
+{
+    qDebug() << "EfmProcessor::processStacked(): Decoding EFM from" << inputFilenames.size()
+             << "files to file:" << outputFilename;
+
+    // Prepare the input file readers and a T-value front end for each source
+    const qint32 sourceCount = inputFilenames.size();
+    QVector<ReaderData*> readers;
+    QVector<TvaluesToChannel> tValuesToChannels(sourceCount);
+    bool success = true;
+    for (int i = 0; i < sourceCount; ++i) {
+        readers.append(new ReaderData());
+        tValuesToChannels[i].setShowDebug(m_showTvaluesDebug);
+        if (!readers.last()->open(inputFilenames[i])) {
+            qDebug() << "EfmProcessor::processStacked(): Failed to open input file:" << inputFilenames[i];
+            success = false;
+        }
+    }
+
+    ChannelStacker channelStacker(sourceCount);
+    channelStacker.setShowDebug(m_showChannelDebug);
+
+    if (success) {
+        // Prepare the output file writer
+        m_writerF2Section.open(outputFilename);
+
+        qint64 totalSize = 0;
+        for (int i = 0; i < sourceCount; ++i) totalSize += readers[i]->size();
+        qint64 processedSize = 0;
+        int lastProgress = 0;
+        QElapsedTimer pipelineTimer;
+
+        while (!channelStacker.isFinished()) {
+            // Read T-values for the sources that don't have a section ready to stack
+            pipelineTimer.start();
+            for (int i = 0; i < sourceCount; ++i) {
+                if (!channelStacker.needsData(i)) continue;
+
+                QByteArray tValues = readers[i]->read(1024);
+                processedSize += tValues.size();
+                if (tValues.isEmpty()) {
+                    channelStacker.flush(i);
+                    continue;
+                }
+
+                tValuesToChannels[i].pushFrame(tValues);
+                while (tValuesToChannels[i].isReady()) {
+                    QByteArray channelData = tValuesToChannels[i].popFrame();
+                    quint32 bitCount = 0;
+                    for (int j = 0; j < channelData.size(); ++j) bitCount += channelData.at(j);
+                    channelStacker.pushFrame(i, m_channelToF3.channelSymbols(channelData), bitCount);
+                }
+            }
+
+            int progress = static_cast<int>((processedSize * 100) / qMax(totalSize, static_cast<qint64>(1)));
+            if (progress >= lastProgress + 5) { // Show progress every 5%
+                qInfo() << "Progress:" << progress << "%";
+                lastProgress = progress;
+            }
+
+            // Pass the stacked channel symbols to the F3 frame decoder
+            while (channelStacker.isReady()) {
+                quint8 qualityFlags;
+                QVector<quint16> symbols = channelStacker.popFrame(qualityFlags);
+                m_channelToF3.pushSymbols(symbols, qualityFlags);
+            }
+            m_generalPipelineStats.channelToF3Time += pipelineTimer.nsecsElapsed();
+
+            processGeneralPipeline();
+        }
+
+        // We are out of data flush the pipeline and process it one last time
+        qInfo() << "Flushing decoding pipelines";
+        m_f2SectionCorrection.flush();
+
+        qInfo() << "Processing final pipeline data";
+        processGeneralPipeline();
+
+        // Show summary
+        qInfo() << "Decoding complete";
+
+        for (int i = 0; i < sourceCount; ++i) {
+            qInfo().noquote() << "Source" << i << inputFilenames[i];
+            tValuesToChannels[i].showStatistics();
+            qInfo() << "";
+        }
+        channelStacker.showStatistics();
+        qInfo() << "";
+        m_channelToF3.showStatistics();
+        qInfo() << "";
+        m_f3FrameToF2Section.showStatistics();
+        qInfo() << "";
+        m_f2SectionCorrection.showStatistics();
+        qInfo() << "";
+
+        showGeneralPipelineStatistics();
+    }
+
+    // Close the input files
+    for (int i = 0; i < sourceCount; ++i) {
+        readers[i]->close();
+        delete readers[i];
+    }
+
+    // Close the output files
+    if (m_writerF2Section.isOpen()) m_writerF2Section.close();
+
+    if (success) qInfo() << "Encoding complete";
+    return success;
+}
+
 void EfmProcessor::processGeneralPipeline()
 {
     QElapsedTimer pipelineTimer;
@@ -167,6 +282,8 @@ void EfmProcessor::setShowData(bool showF2, bool showF3)
 void EfmProcessor::setDebug(bool tvalue, bool channel, bool f3, bool f2)
 {
     // Set the debug flags
+    m_showTvaluesDebug = tvalue;
+    m_showChannelDebug = channel;
     m_tValuesToChannel.setShowDebug(tvalue);
     m_channelToF3.setShowDebug(channel);
     m_f3FrameToF2Section.setShowDebug(f3);
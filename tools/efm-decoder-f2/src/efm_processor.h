@@ -33,6 +33,7 @@
 #include "decoders.h"
 #include "dec_tvaluestochannel.h"
 #include "dec_channeltof3frame.h"
+#include "dec_channelstacker.h"
 #include "dec_f3frametof2section.h"
 #include "dec_f2sectioncorrection.h"
 
@@ -45,6 +46,7 @@ public:
     EfmProcessor();
 
     bool process(const QString &inputFilename, const QString &outputFilename);
+    bool processStacked(const QVector<QString> &inputFilenames, const QString &outputFilename);
     void setShowData(bool showF2, bool showF3);
     void setDebug(bool tvalue, bool channel, bool f3, bool f2);
     void showStatistics() const;
@@ -54,6 +56,10 @@ private:
     bool m_showF2;
     bool m_showF3;
 
+    // Debug options for the per-source decoders used when stacking
+    bool m_showTvaluesDebug;
+    bool m_showChannelDebug;
+
     // IEC 60909-1999 Decoders
     TvaluesToChannel m_tValuesToChannel;
     ChannelToF3Frame m_channelToF3;
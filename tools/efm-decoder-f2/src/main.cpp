@@ -89,7 +89,7 @@ int main(int argc, char *argv[])
 
     // -- Positional arguments --
     parser.addPositionalArgument("input",
-                                 QCoreApplication::translate("main", "Specify input EFM file"));
+                                 QCoreApplication::translate("main", "Specify input EFM file (specify more than one to stack multiple captures of the same disc)"));
     parser.addPositionalArgument("output",
                                  QCoreApplication::translate("main", "Specify output F2 section file"));
 
@@ -118,26 +118,41 @@ int main(int argc, char *argv[])
     }
 
     // Get the filename arguments from the parser
-    QString inputFilename;
+    QVector<QString> inputFilenames;
     QString outputFilename;
     QStringList positionalArguments = parser.positionalArguments();
 
-    if (positionalArguments.count() != 2) {
+    if (positionalArguments.count() < 2) {
         qWarning() << "You must specify the input EFM filename and the output F2 section filename";
         return 1;
     }
-    inputFilename = positionalArguments.at(0);
-    outputFilename = positionalArguments.at(1);
+    for (int i = 0; i < positionalArguments.count() - 1; ++i) {
+        inputFilenames.append(positionalArguments.at(i));
+    }
+    outputFilename = positionalArguments.last();
+
+    // Check that none of the input filenames are used as the output file
+    if (inputFilenames.contains(outputFilename)) {
+        qWarning() << "Input and output files cannot have the same filenames";
+        return 1;
+    }
 
     // Perform the processing
-    qInfo() << "Beginning EFM decoding of" << inputFilename;
     EfmProcessor efmProcessor;
 
     efmProcessor.setShowData(showF2, showF3);
     efmProcessor.setDebug(showTValuesDebug, showChannelDebug, showF3Debug, showF2CorrectDebug);
 
-    if (!efmProcessor.process(inputFilename, outputFilename)) {
-        return 1;
+    if (inputFilenames.size() == 1) {
+        qInfo() << "Beginning EFM decoding of" << inputFilenames.first();
+        if (!efmProcessor.process(inputFilenames.first(), outputFilename)) {
+            return 1;
+        }
+    } else {
+        qInfo() << "Beginning stacked EFM decoding of" << inputFilenames.size() << "captures";
+        if (!efmProcessor.processStacked(inputFilenames, outputFilename)) {
+            return 1;
+        }
     }
 
     // Quit with success
@@ -0,0 +1,169 @@
+/************************************************************************
+
+    f2_stack_kernel.cpp
+
+    efm-stacker-f2 - EFM F2 Section stacker
+    Copyright (C) 2025 Simon Inns
+
+    This file is part of ld-decode-tools.
+
+    This application is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+************************************************************************/
+
+#include "f2_stack_kernel.h"
+
+#include <QtAlgorithms>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Stack K sources of 32 bytes.  The output data defaults to source 0's bytes
+// so that positions with no valid value carry the same data as before.
+//
+// Source differences are only counted for byte positions where no valid
+// value was available or where a vote was required; positions where all
+// valid values agreed are not counted (matching the original per-byte
+// stacking behaviour)
+void F2StackKernel::stack(const quint8 sourceData[][FrameSize], const quint32 *sourceErrorMasks,
+    const quint32 *sourceWeights, qint32 sourceCount, Result &result, quint64 *sourceDifferences)
+{
+    if (sourceCount < 1 || sourceCount > MaxSources) {
+        qFatal("F2StackKernel::stack(): Source count of %d is out of range", sourceCount);
+    }
+
+    // Compare every source with source 0 in a single pass, building a mask of
+    // equal byte positions per source.  A byte position "agrees" if every
+    // source either matches source 0 or is in error at that position
+    quint32 equal[MaxSources];
+    quint32 validAny = 0;
+    quint32 agreed = 0xFFFFFFFF;
+    for (qint32 source = 0; source < sourceCount; source++) {
+        equal[source] = equalMask(sourceData[source], sourceData[0]);
+        validAny |= ~sourceErrorMasks[source];
+        agreed &= equal[source] | sourceErrorMasks[source];
+    }
+
+    // Fast path - source 0 is valid and all other valid bytes match it
+    const quint32 fastMask = agreed & ~sourceErrorMasks[0];
+    const quint32 noValidMask = ~validAny;
+    quint32 slowMask = validAny & ~fastMask;
+
+    std::memcpy(result.data, sourceData[0], FrameSize);
+    result.errorMask = noValidMask;
+    result.agreedMask = fastMask;
+    result.votedMask = 0;
+
+    // Slow path - only byte positions that disagree (or where source 0 is in error)
+    while (slowMask) {
+        const qint32 byteIndex = static_cast<qint32>(qCountTrailingZeroBits(slowMask));
+        const quint32 bit = 1u << byteIndex;
+        slowMask &= slowMask - 1;
+
+        // Gather the valid bytes (and their weights) in source order
+        quint8 validBytes[MaxSources];
+        quint32 validWeights[MaxSources];
+        qint32 validCount = 0;
+        bool allBytesSame = true;
+        for (qint32 source = 0; source < sourceCount; source++) {
+            if (!(sourceErrorMasks[source] & bit)) {
+                validBytes[validCount] = sourceData[source][byteIndex];
+                if (sourceWeights) validWeights[validCount] = sourceWeights[source];
+                if (validBytes[validCount] != validBytes[0]) allBytesSame = false;
+                validCount++;
+            }
+        }
+
+        // If all valid bytes are the same, use that value or, if there are only
+        // two sources (and no weights), use the value from the first source
+        if (allBytesSame || (validCount == 2 && !sourceWeights)) {
+            result.data[byteIndex] = validBytes[0];
+            result.agreedMask |= bit;
+        } else if (sourceWeights) {
+            result.data[byteIndex] = highestWeightValue(validBytes, validWeights, validCount);
+            result.votedMask |= bit;
+        } else {
+            result.data[byteIndex] = mostCommonValue(validBytes, validCount);
+            result.votedMask |= bit;
+        }
+    }
+
+    // Update the source differences statistics
+    const quint32 differenceMask = result.errorMask | result.votedMask;
+    if (differenceMask && sourceDifferences) {
+        for (qint32 source = 1; source < sourceCount; source++) {
+            sourceDifferences[source] += qPopulationCount(~equal[source] & differenceMask);
+        }
+    }
+}
+
+// Returns a mask with bit n set if byte n of a and b are equal
+quint32 F2StackKernel::equalMask(const quint8 *a, const quint8 *b)
+{
+#if defined(__SSE2__)
+    const __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a));
+    const __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + 16));
+    const __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b));
+    const __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + 16));
+    const quint32 low = static_cast<quint32>(_mm_movemask_epi8(_mm_cmpeq_epi8(a0, b0))) & 0xFFFF;
+    const quint32 high = static_cast<quint32>(_mm_movemask_epi8(_mm_cmpeq_epi8(a1, b1))) & 0xFFFF;
+    return low | (high << 16);
+#else
+    quint32 mask = 0;
+    for (qint32 i = 0; i < FrameSize; i++) {
+        if (a[i] == b[i]) mask |= 1u << i;
+    }
+    return mask;
+#endif
+}
+
+// Returns the most common value, ties are resolved in favour of the value
+// seen first (i.e. from the lowest numbered source)
+quint8 F2StackKernel::mostCommonValue(const quint8 *values, qint32 count)
+{
+    quint8 mostCommon = values[0];
+    qint32 maxCount = 0;
+    for (qint32 i = 0; i < count; i++) {
+        qint32 valueCount = 0;
+        for (qint32 j = i; j < count; j++) {
+            if (values[j] == values[i]) valueCount++;
+        }
+        if (valueCount > maxCount) {
+            maxCount = valueCount;
+            mostCommon = values[i];
+        }
+    }
+    return mostCommon;
+}
+
+// Returns the value with the highest total weight, ties are resolved in favour
+// of the value seen first (i.e. from the lowest numbered source)
+quint8 F2StackKernel::highestWeightValue(const quint8 *values, const quint32 *weights, qint32 count)
+{
+    quint8 bestValue = values[0];
+    quint32 bestWeight = 0;
+    for (qint32 i = 0; i < count; i++) {
+        quint32 valueWeight = 0;
+        for (qint32 j = i; j < count; j++) {
+            if (values[j] == values[i]) valueWeight += weights[j];
+        }
+        if (valueWeight > bestWeight) {
+            bestWeight = valueWeight;
+            bestValue = values[i];
+        }
+    }
+    return bestValue;
+}
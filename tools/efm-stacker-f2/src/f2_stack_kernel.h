@@ -0,0 +1,63 @@
+/************************************************************************
+
+    f2_stack_kernel.h
+
+    efm-stacker-f2 - EFM F2 Section stacker
+    Copyright (C) 2025 Simon Inns
+
+    This file is part of ld-decode-tools.
+
+    This application is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+************************************************************************/
+
+#ifndef F2_STACK_KERNEL_H
+#define F2_STACK_KERNEL_H
+
+#include <QtGlobal>
+
+// Byte-wise voting kernel for stacking F2 frames
+//
+// The kernel works on K sources of 32 bytes each with a 32-bit error mask
+// per source (bit n set means byte n of that source is in error).  Nothing
+// is allocated on the heap; the common case where all valid bytes agree is
+// resolved for the whole frame at once using SIMD compares and only the
+// byte positions that actually disagree are voted on individually.
+class F2StackKernel
+{
+public:
+    enum {
+        MaxSources = 32,
+        FrameSize = 32
+    };
+
+    struct Result {
+        quint8 data[FrameSize];
+        quint32 errorMask;  // No valid value was available for the byte
+        quint32 agreedMask; // All valid values agreed (or two sources, first valid used)
+        quint32 votedMask;  // Valid values differed and the most common value was used
+    };
+
+    // If sourceWeights is not null, disagreements are resolved by the value
+    // with the highest total weight rather than a simple majority
+    static void stack(const quint8 sourceData[][FrameSize], const quint32 *sourceErrorMasks,
+        const quint32 *sourceWeights, qint32 sourceCount, Result &result, quint64 *sourceDifferences);
+
+private:
+    static quint32 equalMask(const quint8 *a, const quint8 *b);
+    static quint8 mostCommonValue(const quint8 *values, qint32 count);
+    static quint8 highestWeightValue(const quint8 *values, const quint32 *weights, qint32 count);
+};
+
+#endif // F2_STACK_KERNEL_H
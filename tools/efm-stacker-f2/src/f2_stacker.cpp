@@ -23,23 +23,93 @@
 ************************************************************************/
 
 #include "f2_stacker.h"
+#include "f2_stacker_thread.h"
+
+#include <algorithm>
+#include "logging.h"
 
 F2Stacker::F2Stacker() :
-    m_goodBytes(0),
-    m_noValidValueForByte(0),
-    m_errorFreeFrames(0),
-    m_errorFrames(0),
-    m_validValueForByte(0),
-    m_usedMostCommonValue(0),
-    m_paddedFrames(0)
+    m_threads(1),
+    m_stackStartAddress(0),
+    m_stackEndAddress(0),
+    m_totalChunks(0),
+    m_nextChunk(0),
+    m_nextChunkToWrite(0),
+    m_maxPendingChunks(0),
+    m_abort(false),
+    m_weighted(false),
+    m_dropThreshold(50.0),
+    m_showDebug(getDebugState())
 {}
 
-bool F2Stacker::process(const QVector<QString> &inputFilenames, const QString &outputFilename)
+F2Stacker::Statistics::Statistics(qint32 sourceCount) :
+    noValidValueForByte(0),
+    validValueForByte(0),
+    usedMostCommonValue(0),
+    errorFreeFrames(0),
+    errorFrames(0),
+    paddedFrames(0),
+    sourceDifferences(sourceCount, 0)
+{}
+
+void F2Stacker::Statistics::add(const Statistics &other)
 {
-    // Prepare the source differences statistics
-    m_sourceDifferences.resize(inputFilenames.size());
-    m_sourceDifferences.fill(0);
+    noValidValueForByte += other.noValidValueForByte;
+    validValueForByte += other.validValueForByte;
+    usedMostCommonValue += other.usedMostCommonValue;
+    errorFreeFrames += other.errorFreeFrames;
+    errorFrames += other.errorFrames;
+    paddedFrames += other.paddedFrames;
+
+    for (int sourceIndex = 0; sourceIndex < sourceDifferences.size() && sourceIndex < other.sourceDifferences.size(); sourceIndex++) {
+        sourceDifferences[sourceIndex] += other.sourceDifferences[sourceIndex];
+    }
+}
+
+void F2Stacker::setThreads(qint32 threads)
+{
+    m_threads = qMax(1, threads);
+}
+
+void F2Stacker::setWeighted(bool weighted)
+{
+    m_weighted = weighted;
+}
+
+// Sources (other than the best 2) with a sampled byte error rate above the
+// threshold (or valid metadata below 100 - threshold) percent are dropped
+void F2Stacker::setDropThreshold(double threshold)
+{
+    m_dropThreshold = threshold;
+}
+
+F2Stacker::SourceQuality::SourceQuality() :
+    sampledSections(0),
+    validMetadata(0),
+    bytes(0),
+    errorBytes(0)
+{}
 
+double F2Stacker::SourceQuality::errorRate() const
+{
+    if (bytes == 0) return 1.0;
+    return static_cast<double>(errorBytes) / static_cast<double>(bytes);
+}
+
+double F2Stacker::SourceQuality::metadataRate() const
+{
+    if (sampledSections == 0) return 0.0;
+    return static_cast<double>(validMetadata) / static_cast<double>(sampledSections);
+}
+
+// The byte error rate is the main indicator of quality with the metadata as a tie-breaker
+double F2Stacker::SourceQuality::score() const
+{
+    return (1.0 - errorRate()) * 100.0 + metadataRate();
+}
+
+bool F2Stacker::process(const QVector<QString> &inputFilenames, const QString &outputFilename)
+{
     // Start by opening all the input F2 section files
     for (int index = 0; index < inputFilenames.size(); index++) {
         ReaderF2Section* reader = new ReaderF2Section();
@@ -65,16 +135,67 @@ bool F2Stacker::process(const QVector<QString> &inputFilenames, const QString &o
         SectionTime endTime = m_inputFiles[inputFileIdx]->read().metadata.absoluteSectionTime();
         m_startTimes.append(startTime);
         m_endTimes.append(endTime);
-        
-        // Seek back to the start of the file
-        m_inputFiles[inputFileIdx]->seekToSection(0);
+
         qInfo().noquote() << "Input File" << inputFilenames[inputFileIdx] << "- Start:" << startTime.toString() << "- End:" << endTime.toString();
     }
 
+    // Sample each source to rank it by quality before the full stacking pass
+    QVector<SourceQuality> sourceQuality = prescanSources(inputFilenames);
+
+    // The stacking threads open their own readers, so the scanning readers can be closed
+    for (int index = 0; index < m_inputFiles.size(); index++) {
+        m_inputFiles[index]->close();
+        delete m_inputFiles[index];
+    }
+    m_inputFiles.clear();
+
+    // Order the sources from best to worst (the first source is preferred for
+    // metadata and when votes are tied) and drop the sources that are unlikely
+    // to contribute anything (whilst keeping at least 2 sources)
+    QVector<qint32> sourceOrder;
+    for (int index = 0; index < inputFilenames.size(); index++) {
+        sourceOrder.append(index);
+    }
+    std::stable_sort(sourceOrder.begin(), sourceOrder.end(), [&sourceQuality](qint32 a, qint32 b) {
+        return sourceQuality[a].score() > sourceQuality[b].score();
+    });
+
+    QVector<QString> sourceFilenames;
+    QVector<SectionTime> sourceStartTimes;
+    QVector<SectionTime> sourceEndTimes;
+    m_sourceWeights.clear();
+    for (int rank = 0; rank < sourceOrder.size(); rank++) {
+        const qint32 index = sourceOrder[rank];
+        const SourceQuality &quality = sourceQuality[index];
+
+        if (rank >= 2 && (quality.errorRate() * 100.0 > m_dropThreshold || quality.metadataRate() * 100.0 < 100.0 - m_dropThreshold)) {
+            qInfo().noquote().nospace() << "Dropping source " << inputFilenames[index] << " - sampled byte error rate "
+                << QString::number(quality.errorRate() * 100.0, 'f', 2) << "%, valid metadata "
+                << QString::number(quality.metadataRate() * 100.0, 'f', 2) << "%";
+            continue;
+        }
+
+        sourceFilenames.append(inputFilenames[index]);
+        sourceStartTimes.append(m_startTimes[index]);
+        sourceEndTimes.append(m_endTimes[index]);
+
+        // Sources with a higher error rate have a lower base weight when weighted stacking is used
+        m_sourceWeights.append(16 - static_cast<quint32>(quality.errorRate() * 8.0 + 0.5));
+    }
+    m_startTimes = sourceStartTimes;
+    m_endTimes = sourceEndTimes;
+
+    qInfo() << "Source ranking:";
+    for (int index = 0; index < sourceFilenames.size(); index++) {
+        qInfo().noquote() << "  Source" << index << sourceFilenames[index];
+    }
+
     // The start time (for the stacking) is the earliest start time of all the input files
     // The end time (for the stacking) is the latest end time of all the input files
     SectionTime stackStartTime(59,59,74);
     SectionTime stackEndTime(0,0,0);
+    QVector<qint32> startAddresses;
+    QVector<qint32> endAddresses;
     for (int index = 0; index < m_startTimes.size(); index++) {
         if (m_startTimes[index] < stackStartTime) {
             stackStartTime = m_startTimes[index];
@@ -82,6 +203,8 @@ bool F2Stacker::process(const QVector<QString> &inputFilenames, const QString &o
         if (m_endTimes[index] > stackEndTime) {
             stackEndTime = m_endTimes[index];
         }
+        startAddresses.append(m_startTimes[index].frames());
+        endAddresses.append(m_endTimes[index].frames());
     }
     qInfo().noquote() << "Stacking Start Time:" << stackStartTime.toString() << "End Time:" << stackEndTime.toString();
 
@@ -91,71 +214,182 @@ bool F2Stacker::process(const QVector<QString> &inputFilenames, const QString &o
         return false;
     }
 
-    // Process
-    for (int address = stackStartTime.frames(); address <= stackEndTime.frames(); address++) {
-        // Make a list of the input files that have data for this frame
-        QVector<ReaderF2Section*> inputReaderList;
-        for (int inputFileIdx = 0; inputFileIdx < m_inputFiles.size(); inputFileIdx++) {
-            if (m_startTimes[inputFileIdx].frames() <= address && m_endTimes[inputFileIdx].frames() >= address) {
-                inputReaderList.append(m_inputFiles[inputFileIdx]);
-            }
-        }
+    // Split the address range into chunks that are stacked in parallel and
+    // then written in address order.  The number of chunks that can be waiting
+    // to be written is limited to keep the memory use bounded
+    m_stackStartAddress = stackStartTime.frames();
+    m_stackEndAddress = stackEndTime.frames();
+    m_totalChunks = (m_stackEndAddress - m_stackStartAddress + ChunkSize) / ChunkSize;
+    m_nextChunk = 0;
+    m_nextChunkToWrite = 0;
+    m_maxPendingChunks = m_threads * 2;
+    m_abort = false;
+    m_pendingChunks.clear();
+
+    qInfo() << "Stacking using" << m_threads << "threads";
+    QVector<F2StackerThread*> threads;
+    for (int index = 0; index < m_threads; index++) {
+        threads.append(new F2StackerThread(*this, sourceFilenames, startAddresses, endAddresses));
+        threads.last()->start();
+    }
 
-        QVector<F2Section> sectionList;
-        for (int inputFileIdx = 0; inputFileIdx < inputReaderList.size(); inputFileIdx++) {
-            sectionList.append(inputReaderList[inputFileIdx]->read());
+    // Write the stacked chunks in address order as they become available
+    bool success = true;
+    for (qint32 chunkIndex = 0; chunkIndex < m_totalChunks; chunkIndex++) {
+        QVector<F2Section> stackedSections;
+        {
+            QMutexLocker locker(&m_mutex);
+            while (!m_pendingChunks.contains(chunkIndex) && !m_abort) {
+                m_outputReady.wait(&m_mutex);
+            }
+            if (m_abort) {
+                success = false;
+                break;
+            }
+            stackedSections = m_pendingChunks.take(chunkIndex);
+            m_nextChunkToWrite = chunkIndex + 1;
+            m_inputAvailable.wakeAll();
         }
 
-        qDebug().noquote() << "F2Stacker::process() - Stacking section" << sectionList.at(0).metadata.absoluteSectionTime().toString();
-
-        F2Section stackedF2Section = stackSections(sectionList);
-
-        // Write the output F2 Section
-        m_outputFile.write(stackedF2Section);
-
-        // Every 2500 Sections, show progress
-        if (address % 2500 == 0) {
-            float percentageComplete = (static_cast<float>(address) - static_cast<float>(stackStartTime.frames())) *
-                100.0 / (static_cast<float>(stackEndTime.frames()) - static_cast<float>(stackStartTime.frames()));
-            qInfo().noquote().nospace() << "Processed " << address << " sections of " << (stackEndTime.frames() - stackStartTime.frames() + 1)
-                << " " << QString::number(percentageComplete, 'f', 2) << "%";
+        qint32 address = m_stackStartAddress + chunkIndex * ChunkSize;
+        for (int index = 0; index < stackedSections.size(); index++, address++) {
+            // Write the output F2 Section
+            m_outputFile.write(stackedSections[index]);
+
+            // Every 2500 Sections, show progress
+            if (address % 2500 == 0) {
+                float percentageComplete = (static_cast<float>(address) - static_cast<float>(stackStartTime.frames())) *
+                    100.0 / (static_cast<float>(stackEndTime.frames()) - static_cast<float>(stackStartTime.frames()));
+                qInfo().noquote().nospace() << "Processed " << address << " sections of " << (stackEndTime.frames() - stackStartTime.frames() + 1)
+                    << " " << QString::number(percentageComplete, 'f', 2) << "%";
+            }
         }
     }
 
-    // Close the input files
-    for (int index = 0; index < m_inputFiles.size(); index++) {
-        m_inputFiles[index]->close();
-        delete m_inputFiles[index];
+    // Wait for the threads to finish and merge their statistics
+    Statistics statistics(sourceFilenames.size());
+    for (int index = 0; index < threads.size(); index++) {
+        threads[index]->wait();
+        statistics.add(threads[index]->statistics());
+        delete threads[index];
     }
-    m_inputFiles.clear();
-    
+    threads.clear();
+
     // Close the output file
     m_outputFile.close();
 
+    if (!success) {
+        return false;
+    }
+
     // Statistics
     qInfo() << "Stacking results:";
     qInfo().noquote() << "  Sections stacked:" << stackEndTime.frames() - stackStartTime.frames() + 1;
     qInfo().noquote() << "  Frames stacked:" << (stackEndTime.frames() - stackStartTime.frames() + 1) * 98;
     qInfo().noquote() << "";
-    qInfo().noquote() << "  Error free frames:" << m_errorFreeFrames;
-    qInfo().noquote() << "  Error frames:" << m_errorFrames;
-    qInfo().noquote().nospace() << "  Padded frames: " << m_paddedFrames << " (" << m_paddedFrames / 98 << " sections)";
-    qInfo().noquote() << "  Total frames:" << m_errorFreeFrames + m_errorFrames + m_paddedFrames;
+    qInfo().noquote() << "  Error free frames:" << statistics.errorFreeFrames;
+    qInfo().noquote() << "  Error frames:" << statistics.errorFrames;
+    qInfo().noquote().nospace() << "  Padded frames: " << statistics.paddedFrames << " (" << statistics.paddedFrames / 98 << " sections)";
+    qInfo().noquote() << "  Total frames:" << statistics.errorFreeFrames + statistics.errorFrames + statistics.paddedFrames;
     qInfo().noquote() << "";
-    qInfo().noquote() << "  Valid bytes common to all sources:" << m_validValueForByte;
-    qInfo().noquote() << "  Valid bytes that differed in value between sources:" << m_usedMostCommonValue;
-    qInfo().noquote() << "  Invalid byte in all sources:" << m_noValidValueForByte;
+    qInfo().noquote() << "  Valid bytes common to all sources:" << statistics.validValueForByte;
+    qInfo().noquote() << "  Valid bytes that differed in value between sources:" << statistics.usedMostCommonValue;
+    qInfo().noquote() << "  Invalid byte in all sources:" << statistics.noValidValueForByte;
     qInfo().noquote() << "";
     qInfo().noquote() << "  Source differences:";
-    qInfo().noquote() << "    Source 0" << inputFilenames[0];
-    for (int sourceIndex = 1; sourceIndex < m_sourceDifferences.size(); sourceIndex++) {
-        qInfo().noquote() << "    Source" << sourceIndex << inputFilenames[sourceIndex] << ":" << m_sourceDifferences[sourceIndex];
+    qInfo().noquote() << "    Source 0" << sourceFilenames[0];
+    for (int sourceIndex = 1; sourceIndex < statistics.sourceDifferences.size(); sourceIndex++) {
+        qInfo().noquote() << "    Source" << sourceIndex << sourceFilenames[sourceIndex] << ":" << statistics.sourceDifferences[sourceIndex];
     }
 
     return true;
 }
 
-F2Section F2Stacker::stackSections(const QVector<F2Section> &f2Sections)
+// Sample sections spread across each source to estimate its quality.  The sections
+// are found by seeking (all sections are the same size) so only the sampled
+// sections are read
+QVector<F2Stacker::SourceQuality> F2Stacker::prescanSources(const QVector<QString> &inputFilenames)
+{
+    const qint64 samplesPerSource = 256;
+    QVector<SourceQuality> sourceQuality(m_inputFiles.size());
+
+    qInfo() << "Pre-scanning input files to estimate the quality of each...";
+    for (int inputFileIdx = 0; inputFileIdx < m_inputFiles.size(); inputFileIdx++) {
+        ReaderF2Section *reader = m_inputFiles[inputFileIdx];
+        SourceQuality &quality = sourceQuality[inputFileIdx];
+        const qint64 samples = qMin(samplesPerSource, reader->size());
+
+        for (qint64 sample = 0; sample < samples; sample++) {
+            reader->seekToSection(sample * reader->size() / samples);
+            F2Section section = reader->read();
+
+            quality.sampledSections++;
+            if (section.metadata.isValid() && !section.metadata.isRepaired()) quality.validMetadata++;
+
+            for (int frameIndex = 0; frameIndex < 98; frameIndex++) {
+                F2Frame frame = section.frame(frameIndex);
+                const quint32 padded = frame.countPadded();
+                if (padded == static_cast<quint32>(frame.frameSize())) continue;
+                quality.bytes += frame.frameSize() - padded;
+                quality.errorBytes += frame.countErrors();
+            }
+        }
+
+        // Put the reader back at the start of the file
+        reader->seekToSection(0);
+
+        qInfo().noquote().nospace() << "Input File " << inputFilenames[inputFileIdx] << " - Sampled " << quality.sampledSections
+            << " sections - Byte error rate: " << QString::number(quality.errorRate() * 100.0, 'f', 2)
+            << "% - Valid metadata: " << QString::number(quality.metadataRate() * 100.0, 'f', 2) << "%";
+    }
+
+    return sourceQuality;
+}
+
+// Get the next chunk of addresses to stack.  Returns false when there is no more work
+bool F2Stacker::getInputChunk(qint32 &chunkIndex, qint32 &startAddress, qint32 &endAddress)
+{
+    QMutexLocker locker(&m_mutex);
+
+    // Don't get too far ahead of the writer
+    while (!m_abort && m_nextChunk < m_totalChunks && m_nextChunk >= m_nextChunkToWrite + m_maxPendingChunks) {
+        m_inputAvailable.wait(&m_mutex);
+    }
+
+    if (m_abort || m_nextChunk >= m_totalChunks) {
+        return false;
+    }
+
+    chunkIndex = m_nextChunk++;
+    startAddress = m_stackStartAddress + chunkIndex * ChunkSize;
+    endAddress = startAddress + ChunkSize - 1;
+    if (endAddress > m_stackEndAddress) endAddress = m_stackEndAddress;
+    return true;
+}
+
+// Hand a stacked chunk to the reorder buffer
+void F2Stacker::putOutputChunk(qint32 chunkIndex, const QVector<F2Section> &sections)
+{
+    QMutexLocker locker(&m_mutex);
+    m_pendingChunks.insert(chunkIndex, sections);
+    m_outputReady.wakeAll();
+}
+
+void F2Stacker::abort()
+{
+    QMutexLocker locker(&m_mutex);
+    m_abort = true;
+    m_inputAvailable.wakeAll();
+    m_outputReady.wakeAll();
+}
+
+bool F2Stacker::showDebug() const
+{
+    return m_showDebug;
+}
+
+F2Section F2Stacker::stackSections(const QVector<F2Section> &f2Sections, const QVector<qint32> &sourceIndexes,
+    Statistics &statistics) const
 {
     F2Section stackedSection;
     SectionMetadata stackedMetadata;
@@ -188,6 +422,7 @@ F2Section F2Stacker::stackSections(const QVector<F2Section> &f2Sections)
     // Check if the section's frames contain only padding rather than valid data
     // and Remove any sections that are just padding
     QVector<F2Section> validF2Sections;
+    QVector<qint32> validSourceIndexes;
     for (int sectionIndex = 0; sectionIndex < f2Sections.size(); sectionIndex++) {
         bool isPadding = true;
         for (int frameIndex = 0; frameIndex < 98; frameIndex++) {
@@ -201,6 +436,7 @@ F2Section F2Stacker::stackSections(const QVector<F2Section> &f2Sections)
             qDebug().noquote() << "F2Stacker::stackSections - Section" << sectionIndex << "is just padding";
         } else {
             validF2Sections.append(f2Sections[sectionIndex]);
+            validSourceIndexes.append(sourceIndexes[sectionIndex]);
         }
     }
 
@@ -208,8 +444,19 @@ F2Section F2Stacker::stackSections(const QVector<F2Section> &f2Sections)
     if (validF2Sections.size() < 2) {
         // Just pass through the first padded section
         stackedSection = f2Sections[0];
-        m_paddedFrames += 98;
+        statistics.paddedFrames += 98;
     } else {
+        // In weighted mode, sources with a failed or repaired Q-channel (or a poor
+        // pre-scan result) have lower confidence
+        quint32 sectionWeights[F2StackKernel::MaxSources];
+        if (m_weighted) {
+            for (int sectionIndex = 0; sectionIndex < validF2Sections.size() && sectionIndex < F2StackKernel::MaxSources; sectionIndex++) {
+                sectionWeights[sectionIndex] = m_sourceWeights[validSourceIndexes[sectionIndex]];
+                if (!validF2Sections[sectionIndex].metadata.isValid()) sectionWeights[sectionIndex] -= 4;
+                else if (validF2Sections[sectionIndex].metadata.isRepaired()) sectionWeights[sectionIndex] -= 2;
+            }
+        }
+
         // Each section contains 98 F2Frames
         for (int frameIndex = 0; frameIndex < 98; frameIndex++) {
             // Make a list of the frames to stack
@@ -219,14 +466,14 @@ F2Section F2Stacker::stackSections(const QVector<F2Section> &f2Sections)
             }
 
             // Stack the frames
-            F2Frame stackedFrame = stackFrames(frameList);
+            F2Frame stackedFrame = stackFrames(frameList, validSourceIndexes, m_weighted ? sectionWeights : nullptr, statistics);
             stackedSection.pushFrame(stackedFrame);
 
             // Does the stacked frame have any errors?
             if (stackedFrame.errorData().contains(1)) {
-                m_errorFrames++;
+                statistics.errorFrames++;
             } else {
-                m_errorFreeFrames++;
+                statistics.errorFreeFrames++;
             }
         }
     }
@@ -235,89 +482,90 @@ F2Section F2Stacker::stackSections(const QVector<F2Section> &f2Sections)
     return stackedSection;
 }
 
-F2Frame F2Stacker::stackFrames(QVector<F2Frame> &f2Frames)
+F2Frame F2Stacker::stackFrames(const QVector<F2Frame> &f2Frames, const QVector<qint32> &sourceIndexes,
+    const quint32 *sectionWeights, Statistics &statistics) const
 {
-    F2Frame stackedFrame;
+    // Flatten the frames into fixed arrays for the stacking kernel
+    quint8 sourceData[F2StackKernel::MaxSources][F2StackKernel::FrameSize];
+    quint32 sourceErrorMasks[F2StackKernel::MaxSources];
+    quint32 sourceWeights[F2StackKernel::MaxSources];
+    const qint32 sourceCount = f2Frames.size();
+    if (sourceCount > F2StackKernel::MaxSources) {
+        qFatal("F2Stacker::stackFrames - Too many sources to stack");
+    }
 
-    // Process one byte at a time
-    QVector<quint8> stackedFrameData;
-    QVector<bool> stackedFrameErrorData;
-    for (int byteIndex = 0; byteIndex < 32; byteIndex++) {
-        // Make a list of the bytes to stack (i.e. those without error flags)
-        QVector<quint8> validBytes;
-        for (int listIndex = 0; listIndex < f2Frames.size(); ++listIndex) {
-            if (f2Frames.at(listIndex).errorData().at(byteIndex) == false) {
-                validBytes.append(f2Frames.at(listIndex).data().at(byteIndex));
-            }
+    for (int sourceIndex = 0; sourceIndex < sourceCount; sourceIndex++) {
+        const QVector<quint8> data = f2Frames.at(sourceIndex).data();
+        const QVector<bool> errorData = f2Frames.at(sourceIndex).errorData();
+        quint32 errorMask = 0;
+        for (int byteIndex = 0; byteIndex < F2StackKernel::FrameSize; byteIndex++) {
+            sourceData[sourceIndex][byteIndex] = data.at(byteIndex);
+            if (errorData.at(byteIndex)) errorMask |= 1u << byteIndex;
         }
+        sourceErrorMasks[sourceIndex] = errorMask;
+
+        // The weight of a source frame is reduced if the channel frame wasn't 588 bits, the
+        // subcode symbol was invalid or other symbols in the same frame were invalid
+        if (sectionWeights) {
+            const quint8 qualityFlags = f2Frames.at(sourceIndex).qualityFlags();
+            qint32 weight = sectionWeights[sourceIndex];
+            if (qualityFlags & FrameBitCountError) weight -= 6;
+            if (qualityFlags & FrameSubcodeError) weight -= 2;
+            weight -= qMin(static_cast<qint32>(qPopulationCount(errorMask)), 4);
+            sourceWeights[sourceIndex] = qMax(weight, 1);
+        }
+    }
 
-        if (validBytes.size() == 0) {
-            // All bytes are errors - can't correct
-            stackedFrameData.append(f2Frames.at(0).data().at(byteIndex));
-            stackedFrameErrorData.append(true);
-            qDebug() << "F2Stacker::stackFrames - No valid byte value for index" << byteIndex;
-            m_noValidValueForByte++;
-        } else {
-            // Are all the valid bytes the same value?
-            bool allBytesSame = true;
-            for (int byteIndex = 1; byteIndex < validBytes.size(); byteIndex++) {
-                if (validBytes.at(byteIndex) != validBytes.at(0)) {
-                    allBytesSame = false;
-                    continue;
-                }
-            }
-
-            // If all valid bytes are the same, use that value or, if there are only
-            // two sources, use the value from the first source
-            if (allBytesSame || validBytes.size() == 2) {
-                stackedFrameData.append(validBytes.at(0));
-                stackedFrameErrorData.append(false);
-                m_validValueForByte++;
-                continue;
-            } else {
-                // If all valid bytes aren't the same, calculate the most common
-                // byte value from the available valid bytes and use that value
-                QHash<quint8, int> byteCounts;
-                for (int byteIndex = 0; byteIndex < validBytes.size(); byteIndex++) {
-                    byteCounts[validBytes.at(byteIndex)]++;
-                }
-
-                // Find the most common byte value
-                int maxCount = 0;
-                quint8 mostCommonByte = 0;
-                for (auto it = byteCounts.begin(); it != byteCounts.end(); ++it) {
-                    if (it.value() > maxCount) {
-                        maxCount = it.value();
-                        mostCommonByte = it.key();
-                    }
-                }
-                m_usedMostCommonValue++;
+    F2StackKernel::Result result;
+    quint64 sourceDifferences[F2StackKernel::MaxSources] = { 0 };
+    F2StackKernel::stack(sourceData, sourceErrorMasks, sectionWeights ? sourceWeights : nullptr, sourceCount,
+        result, sourceDifferences);
 
-                QString validBytesString;
-                for (int byteIndex = 0; byteIndex < validBytes.size(); byteIndex++) {
-                    validBytesString.append(QString("%1 ").arg(validBytes.at(byteIndex), 2, 16, QChar('0')).toUpper());
-                }
-                QString mostCommonByteString = QString("%1").arg(mostCommonByte, 2, 16, QChar('0')).toUpper();
-                qDebug().noquote() << "F2Stacker::stackFrames - Valid byte values differ - using"
-                    << mostCommonByteString << "from" << validBytesString;
+    for (int sourceIndex = 1; sourceIndex < sourceCount; sourceIndex++) {
+        statistics.sourceDifferences[sourceIndexes[sourceIndex]] += sourceDifferences[sourceIndex];
+    }
 
-                stackedFrameData.append(mostCommonByte);
-                stackedFrameErrorData.append(false);                
-            }
-        }
+    statistics.noValidValueForByte += qPopulationCount(result.errorMask);
+    statistics.validValueForByte += qPopulationCount(result.agreedMask);
+    statistics.usedMostCommonValue += qPopulationCount(result.votedMask);
 
-        // Update the source differences statistics for this byte
-        quint8 expectedValue = f2Frames.at(0).data().at(byteIndex);
-        for (int sourceIndex = 0; sourceIndex < f2Frames.size(); sourceIndex++) {
-            if (f2Frames.at(sourceIndex).data().at(byteIndex) != expectedValue) {
-                m_sourceDifferences[sourceIndex]++;
-            }
-        }
+    if (m_showDebug && (result.errorMask | result.votedMask)) {
+        showStackingDebug(sourceData, sourceErrorMasks, sourceCount, result);
     }
 
     // Set the data for the stacked frame
+    QVector<quint8> stackedFrameData(F2StackKernel::FrameSize);
+    QVector<bool> stackedFrameErrorData(F2StackKernel::FrameSize);
+    for (int byteIndex = 0; byteIndex < F2StackKernel::FrameSize; byteIndex++) {
+        stackedFrameData[byteIndex] = result.data[byteIndex];
+        stackedFrameErrorData[byteIndex] = (result.errorMask >> byteIndex) & 1;
+    }
+
+    F2Frame stackedFrame;
     stackedFrame.setData(stackedFrameData);
     stackedFrame.setErrorData(stackedFrameErrorData);
 
     return stackedFrame;
-}
\ No newline at end of file
+}
+
+void F2Stacker::showStackingDebug(const quint8 sourceData[][F2StackKernel::FrameSize], const quint32 *sourceErrorMasks,
+    qint32 sourceCount, const F2StackKernel::Result &result) const
+{
+    for (int byteIndex = 0; byteIndex < F2StackKernel::FrameSize; byteIndex++) {
+        const quint32 bit = 1u << byteIndex;
+
+        if (result.errorMask & bit) {
+            qDebug() << "F2Stacker::stackFrames - No valid byte value for index" << byteIndex;
+        } else if (result.votedMask & bit) {
+            QString validBytesString;
+            for (int sourceIndex = 0; sourceIndex < sourceCount; sourceIndex++) {
+                if (!(sourceErrorMasks[sourceIndex] & bit)) {
+                    validBytesString.append(QString("%1 ").arg(sourceData[sourceIndex][byteIndex], 2, 16, QChar('0')).toUpper());
+                }
+            }
+            QString mostCommonByteString = QString("%1").arg(result.data[byteIndex], 2, 16, QChar('0')).toUpper();
+            qDebug().noquote() << "F2Stacker::stackFrames - Valid byte values differ - using"
+                << mostCommonByteString << "from" << validBytesString;
+        }
+    }
+}
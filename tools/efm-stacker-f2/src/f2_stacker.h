@@ -29,36 +29,92 @@
 #include <QVector>
 #include <QDebug>
 #include <QFile>
+#include <QMap>
+#include <QMutex>
+#include <QWaitCondition>
 
 #include "reader_f2section.h"
 #include "writer_f2section.h"
+#include "f2_stack_kernel.h"
+
+class F2StackerThread;
 
 class F2Stacker
 {
 public:
     F2Stacker();
 
-    bool process(const QVector<QString> &inputFilenames, const QString &outputFilename);
+    struct Statistics {
+        Statistics(qint32 sourceCount = 0);
+        void add(const Statistics &other);
 
-private:
-    QVector<ReaderF2Section*> m_inputFiles;
-    WriterF2Section m_outputFile;
+        quint64 noValidValueForByte;
+        quint64 validValueForByte;
+        quint64 usedMostCommonValue;
 
-    F2Section stackSections(const QVector<F2Section> &sections);
-    F2Frame stackFrames(QVector<F2Frame> &f2Frames);
+        quint64 errorFreeFrames;
+        quint64 errorFrames;
+        quint64 paddedFrames;
 
-    // Statistics
-    quint64 m_goodBytes;
-    quint64 m_noValidValueForByte;
+        QVector<quint64> sourceDifferences;
+    };
 
-    quint64 m_validValueForByte;
-    quint64 m_usedMostCommonValue;
+    void setThreads(qint32 threads);
+    void setWeighted(bool weighted);
+    void setDropThreshold(double threshold);
+    bool process(const QVector<QString> &inputFilenames, const QString &outputFilename);
+
+    // Used by the stacking threads
+    bool getInputChunk(qint32 &chunkIndex, qint32 &startAddress, qint32 &endAddress);
+    void putOutputChunk(qint32 chunkIndex, const QVector<F2Section> &sections);
+    void abort();
+    F2Section stackSections(const QVector<F2Section> &sections, const QVector<qint32> &sourceIndexes,
+        Statistics &statistics) const;
+    bool showDebug() const;
 
-    quint64 m_errorFreeFrames;
-    quint64 m_errorFrames;
-    quint64 m_paddedFrames;
+private:
+    QVector<ReaderF2Section*> m_inputFiles;
+    WriterF2Section m_outputFile;
 
-    QVector<quint64> m_sourceDifferences;
+    // Source quality estimated by the pre-scan
+    struct SourceQuality {
+        SourceQuality();
+        double errorRate() const;
+        double metadataRate() const;
+        double score() const;
+
+        qint32 sampledSections;
+        qint32 validMetadata;
+        quint64 bytes;
+        quint64 errorBytes;
+    };
+
+    QVector<SourceQuality> prescanSources(const QVector<QString> &inputFilenames);
+    QVector<quint32> m_sourceWeights;
+    double m_dropThreshold;
+
+    F2Frame stackFrames(const QVector<F2Frame> &f2Frames, const QVector<qint32> &sourceIndexes,
+        const quint32 *sectionWeights, Statistics &statistics) const;
+    void showStackingDebug(const quint8 sourceData[][F2StackKernel::FrameSize], const quint32 *sourceErrorMasks,
+        qint32 sourceCount, const F2StackKernel::Result &result) const;
+
+    // Chunk scheduling and reordering
+    static const qint32 ChunkSize = 100;
+    qint32 m_threads;
+    qint32 m_stackStartAddress;
+    qint32 m_stackEndAddress;
+    qint32 m_totalChunks;
+    qint32 m_nextChunk;
+    qint32 m_nextChunkToWrite;
+    qint32 m_maxPendingChunks;
+    bool m_abort;
+    QMap<qint32, QVector<F2Section>> m_pendingChunks;
+    QMutex m_mutex;
+    QWaitCondition m_inputAvailable;
+    QWaitCondition m_outputReady;
+
+    bool m_weighted;
+    bool m_showDebug;
 };
 
 #endif // F2_STACKER_H
@@ -0,0 +1,97 @@
+/************************************************************************
+
+    f2_stacker_thread.cpp
+
+    efm-stacker-f2 - EFM F2 Section stacker
+    Copyright (C) 2025 Simon Inns
+
+    This file is part of ld-decode-tools.
+
+    This application is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+************************************************************************/
+
+#include "f2_stacker_thread.h"
+
+F2StackerThread::F2StackerThread(F2Stacker &stacker, const QVector<QString> &inputFilenames,
+    const QVector<qint32> &startAddresses, const QVector<qint32> &endAddresses) :
+    m_stacker(stacker),
+    m_inputFilenames(inputFilenames),
+    m_startAddresses(startAddresses),
+    m_endAddresses(endAddresses),
+    m_statistics(inputFilenames.size())
+{}
+
+const F2Stacker::Statistics &F2StackerThread::statistics() const
+{
+    return m_statistics;
+}
+
+void F2StackerThread::run()
+{
+    // Open a reader for each of the input files
+    QVector<ReaderF2Section*> inputFiles;
+    for (int index = 0; index < m_inputFilenames.size(); index++) {
+        ReaderF2Section* reader = new ReaderF2Section();
+        if (!reader->open(m_inputFilenames[index])) {
+            qCritical() << "F2StackerThread::run() - Could not open input file" << m_inputFilenames[index];
+            delete reader;
+            m_stacker.abort();
+            break;
+        }
+        inputFiles.append(reader);
+    }
+
+    // The next section each reader will return without seeking
+    QVector<qint64> nextSection(inputFiles.size(), -1);
+
+    qint32 chunkIndex;
+    qint32 startAddress;
+    qint32 endAddress;
+    while (inputFiles.size() == m_inputFilenames.size() && m_stacker.getInputChunk(chunkIndex, startAddress, endAddress)) {
+        QVector<F2Section> stackedSections;
+        stackedSections.reserve(endAddress - startAddress + 1);
+
+        for (qint32 address = startAddress; address <= endAddress; address++) {
+            // Read the section for this address from each input file that covers it
+            QVector<F2Section> sectionList;
+            QVector<qint32> sourceIndexes;
+            for (int inputFileIdx = 0; inputFileIdx < inputFiles.size(); inputFileIdx++) {
+                if (m_startAddresses[inputFileIdx] <= address && m_endAddresses[inputFileIdx] >= address) {
+                    qint64 sectionIndex = address - m_startAddresses[inputFileIdx];
+                    if (nextSection[inputFileIdx] != sectionIndex) {
+                        inputFiles[inputFileIdx]->seekToSection(sectionIndex);
+                    }
+                    sectionList.append(inputFiles[inputFileIdx]->read());
+                    sourceIndexes.append(inputFileIdx);
+                    nextSection[inputFileIdx] = sectionIndex + 1;
+                }
+            }
+
+            if (m_stacker.showDebug() && !sectionList.isEmpty()) {
+                qDebug().noquote() << "F2StackerThread::run() - Stacking section" << sectionList.at(0).metadata.absoluteSectionTime().toString();
+            }
+
+            stackedSections.append(m_stacker.stackSections(sectionList, sourceIndexes, m_statistics));
+        }
+
+        m_stacker.putOutputChunk(chunkIndex, stackedSections);
+    }
+
+    // Close the input files
+    for (int index = 0; index < inputFiles.size(); index++) {
+        inputFiles[index]->close();
+        delete inputFiles[index];
+    }
+}
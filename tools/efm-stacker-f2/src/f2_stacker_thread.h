@@ -0,0 +1,57 @@
+/************************************************************************
+
+    f2_stacker_thread.h
+
+    efm-stacker-f2 - EFM F2 Section stacker
+    Copyright (C) 2025 Simon Inns
+
+    This file is part of ld-decode-tools.
+
+    This application is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+************************************************************************/
+
+#ifndef F2_STACKER_THREAD_H
+#define F2_STACKER_THREAD_H
+
+#include <QThread>
+#include <QVector>
+#include <QString>
+
+#include "f2_stacker.h"
+#include "reader_f2section.h"
+
+// Worker thread that stacks chunks of section addresses.  Each thread has its
+// own reader for every input file so reads can be seeked independently
+class F2StackerThread : public QThread
+{
+public:
+    F2StackerThread(F2Stacker &stacker, const QVector<QString> &inputFilenames,
+        const QVector<qint32> &startAddresses, const QVector<qint32> &endAddresses);
+
+    const F2Stacker::Statistics &statistics() const;
+
+protected:
+    void run() override;
+
+private:
+    F2Stacker &m_stacker;
+    QVector<QString> m_inputFilenames;
+    QVector<qint32> m_startAddresses;
+    QVector<qint32> m_endAddresses;
+
+    F2Stacker::Statistics m_statistics;
+};
+
+#endif // F2_STACKER_THREAD_H
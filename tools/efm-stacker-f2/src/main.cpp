@@ -61,6 +61,23 @@ int main(int argc, char *argv[])
     // Add the standard debug options --debug and --quiet
     addStandardDebugOptions(parser);
 
+    // Option to set the number of stacking threads
+    QCommandLineOption threadsOption(QStringList() << "t" << "threads",
+                                     QCoreApplication::translate("main", "Specify the number of concurrent stacking threads (default is the number of logical CPUs)"),
+                                     QCoreApplication::translate("main", "number"));
+    parser.addOption(threadsOption);
+
+    // Option to weight the votes using the frame quality
+    QCommandLineOption weightedOption("weighted",
+                                      QCoreApplication::translate("main", "Weight source bytes by frame quality (channel frame length, EFM symbol validity and Q-channel state) when voting"));
+    parser.addOption(weightedOption);
+
+    // Option to set the pre-scan source drop threshold
+    QCommandLineOption dropThresholdOption("drop-threshold",
+                                           QCoreApplication::translate("main", "Drop sources with a sampled byte error rate above (or valid metadata below 100 minus) this percentage (default 50, the best 2 sources are always kept)"),
+                                           QCoreApplication::translate("main", "percent"));
+    parser.addOption(dropThresholdOption);
+
     // Positional arguments
     parser.addPositionalArgument("inputs",
                                  QCoreApplication::translate("main", "Specify input F2 section files"));
@@ -73,6 +90,17 @@ int main(int argc, char *argv[])
     // Standard logging options
     processStandardDebugOptions(parser);
 
+    // Get the number of stacking threads
+    qint32 maxThreads = QThread::idealThreadCount();
+    if (parser.isSet(threadsOption)) {
+        maxThreads = parser.value(threadsOption).toInt();
+        if (maxThreads < 1) {
+            // Quit with error
+            qCritical("Specified number of threads must be greater than zero");
+            return -1;
+        }
+    }
+
     // Get the filename arguments from the parser
     QVector<QString> inputFilenames;
     QString outputFilename;
@@ -133,6 +161,11 @@ int main(int argc, char *argv[])
     qInfo() << "Beginning F2 Section stacking...";
 
     F2Stacker f2Stacker;
+    f2Stacker.setThreads(maxThreads);
+    f2Stacker.setWeighted(parser.isSet(weightedOption));
+    if (parser.isSet(dropThresholdOption)) {
+        f2Stacker.setDropThreshold(parser.value(dropThresholdOption).toDouble());
+    }
     if (!f2Stacker.process(inputFilenames, outputFilename)) {
         // Quit with error
         qCritical("F2 Section stacking failed");
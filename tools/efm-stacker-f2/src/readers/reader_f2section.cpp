@@ -26,7 +26,9 @@
 
 ReaderF2Section::ReaderF2Section() :
     m_dataStream(nullptr),
-    m_fileSizeInSections(0)
+    m_fileSizeInSections(0),
+    m_version(0),
+    m_dataOffset(0)
 {}
 
 ReaderF2Section::~ReaderF2Section()
@@ -44,26 +46,38 @@ bool ReaderF2Section::open(const QString &filename)
         return false;
     }
 
+    // Check for the file header (files without one are the original format)
+    quint8 header[F2SectionFile::HeaderSize];
+    const qint64 headerBytes = m_file.read(reinterpret_cast<char *>(header), F2SectionFile::HeaderSize);
+    m_version = F2SectionFile::headerVersion(header, qMax<qint64>(headerBytes, 0));
+    if (m_version < 1 || m_version > F2SectionFile::Version) {
+        qCritical() << "ReaderF2Section::open() - File" << filename << "has an unsupported F2 section file version" << m_version;
+        m_file.close();
+        return false;
+    }
+    m_dataOffset = (m_version == 1) ? 0 : F2SectionFile::HeaderSize;
+    if (m_version == 1) {
+        qInfo() << "ReaderF2Section::open() - File" << filename << "has no header (original format), frame quality flags will be clear";
+    }
+
     // Create a data stream for reading
     m_dataStream = new QDataStream(&m_file);
 
-    // Get total file size and current position
-    qint64 currentPos = m_file.pos();
+    // Get total file size
     qint64 totalSize = m_file.size();
-    
-    // Reset to start of file
-    m_file.seek(0);
 
     // Get the size of one F2Section object in bytes
+    m_file.seek(m_dataOffset);
     F2Section dummy;
     *m_dataStream >> dummy;
-    m_sectionSize = m_file.pos();
+    if (m_version >= 2) F2SectionFile::readQualityFlags(*m_dataStream, dummy);
+    m_sectionSize = m_file.pos() - m_dataOffset;
 
     // Calculate the number of F2Sections in the file
-    m_fileSizeInSections = totalSize / m_sectionSize;
-    
-    // Restore original position
-    m_file.seek(currentPos);
+    m_fileSizeInSections = (m_sectionSize > 0) ? (totalSize - m_dataOffset) / m_sectionSize : 0;
+
+    // Start reading from the first section
+    m_file.seek(m_dataOffset);
 
     qDebug() << "ReaderF2Section::open() - Opened file" << filename << "for data reading containing" << size() << "F2 Section objects";
     return true;
@@ -78,6 +92,7 @@ F2Section ReaderF2Section::read()
 
     F2Section f2Section;
     *m_dataStream >> f2Section;
+    if (m_version >= 2) F2SectionFile::readQualityFlags(*m_dataStream, f2Section);
     return f2Section;
 }
 
@@ -108,5 +123,5 @@ void ReaderF2Section::seekToSection(qint64 sectionNumber)
     }
 
     // Seek to the requested section
-    m_file.seek(sectionNumber * m_sectionSize);
+    m_file.seek(m_dataOffset + sectionNumber * m_sectionSize);
 }
\ No newline at end of file
@@ -48,6 +48,8 @@ private:
     QFile m_file;
     QDataStream* m_dataStream;
     qint64 m_fileSizeInSections;
+    qint32 m_version;
+    qint64 m_dataOffset;
     qint64 m_sectionSize;
 };
 
@@ -41,6 +41,11 @@ bool WriterF2Section::open(const QString &filename)
         return false;
     }
 
+    // Write the file header
+    quint8 header[F2SectionFile::HeaderSize];
+    F2SectionFile::encodeHeader(header);
+    m_file.write(reinterpret_cast<const char *>(header), F2SectionFile::HeaderSize);
+
     // Create a data stream for writing
     m_dataStream = new QDataStream(&m_file);
     qDebug() << "WriterData::open() - Opened file" << filename << "for data writing";
@@ -55,6 +60,7 @@ void WriterF2Section::write(const F2Section &f2Section)
     }
 
     *m_dataStream << f2Section;
+    F2SectionFile::writeQualityFlags(*m_dataStream, f2Section);
 }
 
 void WriterF2Section::close()
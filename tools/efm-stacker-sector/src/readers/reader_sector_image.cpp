@@ -0,0 +1,132 @@
+/************************************************************************
+
+    reader_sector_image.cpp
+
+    efm-stacker-sector - EFM sector stacker
+    Copyright (C) 2025 Simon Inns
+
+    This file is part of ld-decode-tools.
+
+    This application is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+************************************************************************/
+
+#include "reader_sector_image.h"
+
+ReaderSectorImage::ReaderSectorImage() :
+    m_image(nullptr),
+    m_sectorMap(nullptr),
+    m_sectorCount(0)
+{}
+
+ReaderSectorImage::~ReaderSectorImage()
+{
+    close();
+}
+
+bool ReaderSectorImage::open(const QString &filename)
+{
+    const QString mapFilename = sectorMapFilename(filename);
+
+    m_imageFile.setFileName(filename);
+    m_sectorMapFile.setFileName(mapFilename);
+    if (!m_imageFile.open(QIODevice::ReadOnly)) {
+        qCritical() << "ReaderSectorImage::open() - Could not open file" << filename << "for reading";
+        return false;
+    }
+    if (!m_sectorMapFile.open(QIODevice::ReadOnly)) {
+        qCritical() << "ReaderSectorImage::open() - Could not open sector map file" << mapFilename << "for reading";
+        close();
+        return false;
+    }
+
+    const qint64 imageSize = m_imageFile.size();
+    const qint64 mapSize = m_sectorMapFile.size();
+    if (mapSize < SectorMap::HeaderSize) {
+        qCritical() << "ReaderSectorImage::open() - Sector map file" << mapFilename << "is not valid";
+        close();
+        return false;
+    }
+
+    m_sectorMap = m_sectorMapFile.map(0, mapSize);
+    if (!m_sectorMap || !SectorMap::isValidHeader(m_sectorMap, mapSize)) {
+        qCritical() << "ReaderSectorImage::open() - Sector map file" << mapFilename << "is not valid";
+        close();
+        return false;
+    }
+
+    const qint64 records = (mapSize - SectorMap::HeaderSize) / SectorMap::RecordSize;
+    if (imageSize != records * RawSector::Size) {
+        qCritical() << "ReaderSectorImage::open() -" << filename << "is not a 2352 byte sector image matching its sector map"
+            << "(" << imageSize << "bytes," << records << "sector map records)";
+        close();
+        return false;
+    }
+
+    if (imageSize > 0) {
+        m_image = m_imageFile.map(0, imageSize);
+        if (!m_image) {
+            qCritical() << "ReaderSectorImage::open() - Could not map file" << filename;
+            close();
+            return false;
+        }
+    }
+
+    m_sectorCount = static_cast<qint32>(records);
+    qDebug() << "ReaderSectorImage::open() - Opened" << filename << "with" << m_sectorCount << "sectors";
+    return true;
+}
+
+void ReaderSectorImage::close()
+{
+    if (m_image) m_imageFile.unmap(const_cast<uchar *>(m_image));
+    if (m_sectorMap) m_sectorMapFile.unmap(const_cast<uchar *>(m_sectorMap));
+    m_image = nullptr;
+    m_sectorMap = nullptr;
+    m_sectorCount = 0;
+
+    if (m_imageFile.isOpen()) m_imageFile.close();
+    if (m_sectorMapFile.isOpen()) m_sectorMapFile.close();
+}
+
+const quint8 *ReaderSectorImage::record(qint32 address) const
+{
+    return m_sectorMap + SectorMap::HeaderSize + static_cast<qint64>(address) * SectorMap::RecordSize;
+}
+
+// A sector is present if it was decoded (valid or not) with the expected address
+bool ReaderSectorImage::isPresent(qint32 address) const
+{
+    if (address < 0 || address >= m_sectorCount) return false;
+
+    const quint8 *sectorRecord = record(address);
+    return (SectorMap::recordStatus(sectorRecord) & SectorMap::Present) &&
+        SectorMap::recordAddress(sectorRecord) == address;
+}
+
+bool ReaderSectorImage::isValid(qint32 address) const
+{
+    return isPresent(address) && (SectorMap::recordStatus(record(address)) & SectorMap::Valid);
+}
+
+// The sector map is named after the image, replacing a .dat or .bin extension
+// if present (as efm-decoder-data does)
+QString ReaderSectorImage::sectorMapFilename(const QString &filename)
+{
+    QString mapFilename = filename;
+    if (mapFilename.endsWith(".dat") || mapFilename.endsWith(".bin")) {
+        mapFilename.chop(4);
+    }
+    return mapFilename + ".smap";
+}
@@ -0,0 +1,64 @@
+/************************************************************************
+
+    reader_sector_image.h
+
+    efm-stacker-sector - EFM sector stacker
+    Copyright (C) 2025 Simon Inns
+
+    This file is part of ld-decode-tools.
+
+    This application is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+************************************************************************/
+
+#ifndef READER_SECTOR_IMAGE_H
+#define READER_SECTOR_IMAGE_H
+
+#include <QString>
+#include <QDebug>
+#include <QFile>
+
+#include "sector.h"
+#include "sector_map.h"
+
+// Memory maps a 2352 byte raw sector image and its binary sector map (both
+// written by efm-decoder-data).  Record n of the sector map describes sector
+// address n of the image
+class ReaderSectorImage
+{
+public:
+    ReaderSectorImage();
+    ~ReaderSectorImage();
+
+    bool open(const QString &filename);
+    void close();
+    qint32 size() const { return m_sectorCount; }
+    QString fileName() const { return m_imageFile.fileName(); }
+
+    const quint8 *data(qint32 address) const { return m_image + static_cast<qint64>(address) * RawSector::Size; }
+    const quint8 *record(qint32 address) const;
+    bool isPresent(qint32 address) const;
+    bool isValid(qint32 address) const;
+
+    static QString sectorMapFilename(const QString &filename);
+
+private:
+    QFile m_imageFile;
+    QFile m_sectorMapFile;
+    const uchar *m_image;
+    const uchar *m_sectorMap;
+    qint32 m_sectorCount;
+};
+
+#endif // READER_SECTOR_IMAGE_H
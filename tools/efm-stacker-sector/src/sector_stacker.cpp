@@ -0,0 +1,261 @@
+/************************************************************************
+
+    sector_stacker.cpp
+
+    efm-stacker-sector - EFM sector stacker
+    Copyright (C) 2025 Simon Inns
+
+    This file is part of ld-decode-tools.
+
+    This application is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+************************************************************************/
+
+#include "sector_stacker.h"
+#include "sector_stacker_thread.h"
+
+#include <cstring>
+#include "logging.h"
+
+SectorStacker::SectorStacker() :
+    m_threads(1),
+    m_sectorCount(0),
+    m_totalChunks(0),
+    m_nextChunk(0),
+    m_showDebug(getDebugState())
+{}
+
+SectorStacker::Statistics::Statistics(qint32 sourceCount) :
+    validCopies(0),
+    rebuiltValid(0),
+    rebuiltCorrected(0),
+    rebuiltInvalid(0),
+    missing(0),
+    sourceUsed(sourceCount, 0)
+{}
+
+void SectorStacker::Statistics::add(const Statistics &other)
+{
+    validCopies += other.validCopies;
+    rebuiltValid += other.rebuiltValid;
+    rebuiltCorrected += other.rebuiltCorrected;
+    rebuiltInvalid += other.rebuiltInvalid;
+    missing += other.missing;
+
+    for (int sourceIndex = 0; sourceIndex < sourceUsed.size() && sourceIndex < other.sourceUsed.size(); sourceIndex++) {
+        sourceUsed[sourceIndex] += other.sourceUsed[sourceIndex];
+    }
+}
+
+void SectorStacker::setThreads(qint32 threads)
+{
+    m_threads = qMax(1, threads);
+}
+
+bool SectorStacker::process(const QVector<QString> &inputFilenames, const QString &outputFilename)
+{
+    if (inputFilenames.size() > MaxSources) {
+        qCritical() << "SectorStacker::process() - A maximum of" << MaxSources << "input sector images are supported";
+        return false;
+    }
+
+    // Map all of the input sector images
+    m_sectorCount = 0;
+    for (int index = 0; index < inputFilenames.size(); index++) {
+        ReaderSectorImage *reader = new ReaderSectorImage();
+        if (!reader->open(inputFilenames[index])) {
+            qCritical() << "SectorStacker::process() - Could not open input sector image" << inputFilenames[index];
+            delete reader;
+            closeFiles();
+            return false;
+        }
+        qInfo().noquote() << "Input sector image" << index << inputFilenames[index] << "contains" << reader->size() << "sectors";
+        m_sectorCount = qMax(m_sectorCount, reader->size());
+        m_inputFiles.append(reader);
+    }
+
+    // Create the output sector image covering all of the inputs
+    if (!m_outputFile.open(outputFilename, m_sectorCount)) {
+        qCritical() << "SectorStacker::process() - Could not open output sector image" << outputFilename;
+        closeFiles();
+        return false;
+    }
+
+    m_totalChunks = (m_sectorCount + ChunkSize - 1) / ChunkSize;
+    m_nextChunk.storeRelease(0);
+
+    qInfo() << "Stacking" << m_sectorCount << "sectors using" << m_threads << "threads";
+    QVector<SectorStackerThread*> threads;
+    for (int index = 0; index < m_threads; index++) {
+        threads.append(new SectorStackerThread(*this, m_inputFiles.size()));
+        threads.last()->start();
+    }
+
+    // Wait for the threads to finish and merge their statistics
+    Statistics statistics(m_inputFiles.size());
+    for (int index = 0; index < threads.size(); index++) {
+        threads[index]->wait();
+        statistics.add(threads[index]->statistics());
+        delete threads[index];
+    }
+    threads.clear();
+
+    closeFiles();
+
+    // Statistics
+    qInfo() << "Stacking results:";
+    qInfo().noquote() << "  Sectors stacked:" << m_sectorCount;
+    qInfo().noquote() << "  Valid copy available:" << statistics.validCopies;
+    qInfo().noquote() << "  Rebuilt and valid:" << statistics.rebuiltValid;
+    qInfo().noquote() << "  Rebuilt and corrected:" << statistics.rebuiltCorrected;
+    qInfo().noquote() << "  Rebuilt but still invalid:" << statistics.rebuiltInvalid;
+    qInfo().noquote() << "  Missing from all sources:" << statistics.missing;
+    qInfo().noquote() << "";
+    qInfo().noquote() << "  Valid copies used from each source:";
+    for (int sourceIndex = 0; sourceIndex < statistics.sourceUsed.size(); sourceIndex++) {
+        qInfo().noquote() << "    Source" << sourceIndex << inputFilenames[sourceIndex] << ":" << statistics.sourceUsed[sourceIndex];
+    }
+
+    return true;
+}
+
+// Returns the next chunk of sector addresses to stack, or false if there are none left
+bool SectorStacker::getInputChunk(qint32 &startAddress, qint32 &endAddress)
+{
+    const qint32 chunkIndex = m_nextChunk.fetchAndAddOrdered(1);
+    if (chunkIndex >= m_totalChunks) return false;
+
+    startAddress = chunkIndex * ChunkSize;
+    endAddress = qMin(startAddress + ChunkSize, m_sectorCount) - 1;
+
+    // Every 100 chunks, show progress
+    if (chunkIndex % 100 == 0) {
+        float percentageComplete = static_cast<float>(startAddress) * 100.0 / static_cast<float>(m_sectorCount);
+        qInfo().noquote().nospace() << "Stacking sector " << startAddress << " of " << m_sectorCount
+            << " " << QString::number(percentageComplete, 'f', 2) << "%";
+    }
+
+    return true;
+}
+
+void SectorStacker::stackSector(qint32 address, SectorVerifier &verifier, Workspace &workspace, Statistics &statistics)
+{
+    quint8 *outputData = m_outputFile.data(address);
+    quint8 *outputRecord = m_outputFile.record(address);
+
+    // If any source has a valid copy of the sector, use it as is
+    const quint8 *sourceData[MaxSources];
+    qint32 sourceCount = 0;
+    for (int sourceIndex = 0; sourceIndex < m_inputFiles.size(); sourceIndex++) {
+        const ReaderSectorImage *input = m_inputFiles[sourceIndex];
+        if (!input->isPresent(address)) continue;
+
+        if (input->isValid(address)) {
+            std::memcpy(outputData, input->data(address), RawSector::Size);
+            std::memcpy(outputRecord, input->record(address), SectorMap::RecordSize);
+            statistics.validCopies++;
+            statistics.sourceUsed[sourceIndex]++;
+            return;
+        }
+
+        SectorMap::decodeBitmap(input->record(address), workspace.sourceErrors[sourceCount]);
+        sourceData[sourceCount] = input->data(address);
+        sourceCount++;
+    }
+
+    if (sourceCount == 0) {
+        // The sector record is left as a hole (a missing sector)
+        writeMissingSector(address, outputData);
+        statistics.missing++;
+        return;
+    }
+
+    // Rebuild the sector byte-wise from the bytes that aren't in error, using
+    // the most common value where the sources disagree
+    for (qint32 byteIndex = 0; byteIndex < RawSector::Size; byteIndex++) {
+        quint8 values[MaxSources];
+        qint32 valueCount = 0;
+        for (qint32 source = 0; source < sourceCount; source++) {
+            if (!workspace.sourceErrors[source][byteIndex]) values[valueCount++] = sourceData[source][byteIndex];
+        }
+
+        if (valueCount == 0) {
+            workspace.data[byteIndex] = sourceData[0][byteIndex];
+            workspace.errorData[byteIndex] = 1;
+        } else {
+            workspace.data[byteIndex] = mostCommonValue(values, valueCount);
+            workspace.errorData[byteIndex] = 0;
+        }
+    }
+
+    // Check the rebuilt sector (using the remaining errors as erasures for correction)
+    qint32 mode = -1;
+    qint32 form = 0;
+    bool corrected = false;
+    const bool valid = verifier.verify(workspace.data, workspace.errorData, mode, form, corrected, m_showDebug);
+
+    if (!valid) statistics.rebuiltInvalid++;
+    else if (corrected) statistics.rebuiltCorrected++;
+    else statistics.rebuiltValid++;
+
+    if (m_showDebug) {
+        qDebug() << "SectorStacker::stackSector(): Rebuilt sector" << address << "from" << sourceCount << "sources -"
+            << (valid ? (corrected ? "corrected" : "valid") : "invalid");
+    }
+
+    std::memcpy(outputData, workspace.data, RawSector::Size);
+    SectorMap::encodeRecord(address, valid ? (SectorMap::Present | SectorMap::Valid) : SectorMap::Present,
+        mode, form, workspace.errorData, outputRecord);
+}
+
+// Missing sectors are written as a Mode 1 sync pattern and header with zero
+// data (the output is zero filled already)
+void SectorStacker::writeMissingSector(qint32 address, quint8 *data) const
+{
+    static const quint8 syncPattern[12] = { 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00 };
+
+    std::memcpy(data, syncPattern, sizeof(syncPattern));
+    SectorAddress(address).toBcd(data + 12);
+    data[15] = 1;
+}
+
+// Returns the most common value, ties are resolved in favour of the value
+// seen first (i.e. from the lowest numbered source)
+quint8 SectorStacker::mostCommonValue(const quint8 *values, qint32 count)
+{
+    quint8 mostCommon = values[0];
+    qint32 maxCount = 0;
+    for (qint32 i = 0; i < count; i++) {
+        qint32 valueCount = 0;
+        for (qint32 j = i; j < count; j++) {
+            if (values[j] == values[i]) valueCount++;
+        }
+        if (valueCount > maxCount) {
+            maxCount = valueCount;
+            mostCommon = values[i];
+        }
+    }
+    return mostCommon;
+}
+
+void SectorStacker::closeFiles()
+{
+    for (int index = 0; index < m_inputFiles.size(); index++) {
+        m_inputFiles[index]->close();
+        delete m_inputFiles[index];
+    }
+    m_inputFiles.clear();
+    m_outputFile.close();
+}
@@ -0,0 +1,94 @@
+/************************************************************************
+
+    sector_stacker.h
+
+    efm-stacker-sector - EFM sector stacker
+    Copyright (C) 2025 Simon Inns
+
+    This file is part of ld-decode-tools.
+
+    This application is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+************************************************************************/
+
+#ifndef SECTOR_STACKER_H
+#define SECTOR_STACKER_H
+
+#include <QString>
+#include <QVector>
+#include <QDebug>
+#include <QAtomicInt>
+
+#include "sector.h"
+#include "sector_map.h"
+#include "sector_verifier.h"
+#include "reader_sector_image.h"
+#include "writer_sector_image.h"
+
+// Stacks 2352 byte sector images (with their binary sector maps) from several
+// decodes of the same disc.  For each sector a valid copy is used if any
+// source has one, otherwise the sector is rebuilt byte-wise from the bytes
+// that aren't flagged as errors and then checked (and corrected) again
+// using the EDC and RSPC
+class SectorStacker
+{
+public:
+    enum { MaxSources = 32 };
+
+    SectorStacker();
+
+    struct Statistics {
+        Statistics(qint32 sourceCount = 0);
+        void add(const Statistics &other);
+
+        quint64 validCopies;    // A source had a valid copy of the sector
+        quint64 rebuiltValid;   // Rebuilt sector passed EDC without correction
+        quint64 rebuiltCorrected; // Rebuilt sector passed EDC after RSPC correction
+        quint64 rebuiltInvalid; // Rebuilt sector is still invalid
+        quint64 missing;        // No source has the sector
+
+        QVector<quint64> sourceUsed; // Valid copies used from each source
+    };
+
+    // Per-thread working storage for rebuilding sectors
+    struct Workspace {
+        quint8 sourceErrors[MaxSources][RawSector::Size];
+        quint8 data[RawSector::Size];
+        quint8 errorData[RawSector::Size];
+    };
+
+    void setThreads(qint32 threads);
+    bool process(const QVector<QString> &inputFilenames, const QString &outputFilename);
+
+    // Used by the stacking threads
+    bool getInputChunk(qint32 &startAddress, qint32 &endAddress);
+    void stackSector(qint32 address, SectorVerifier &verifier, Workspace &workspace, Statistics &statistics);
+
+private:
+    QVector<ReaderSectorImage*> m_inputFiles;
+    WriterSectorImage m_outputFile;
+
+    static const qint32 ChunkSize = 1000;
+    qint32 m_threads;
+    qint32 m_sectorCount;
+    qint32 m_totalChunks;
+    QAtomicInt m_nextChunk;
+    bool m_showDebug;
+
+    void writeMissingSector(qint32 address, quint8 *data) const;
+    static quint8 mostCommonValue(const quint8 *values, qint32 count);
+    void closeFiles();
+};
+
+#endif // SECTOR_STACKER_H
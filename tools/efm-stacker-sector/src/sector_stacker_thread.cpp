@@ -0,0 +1,55 @@
+/************************************************************************
+
+    sector_stacker_thread.cpp
+
+    efm-stacker-sector - EFM sector stacker
+    Copyright (C) 2025 Simon Inns
+
+    This file is part of ld-decode-tools.
+
+    This application is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+************************************************************************/
+
+#include "sector_stacker_thread.h"
+
+SectorStackerThread::SectorStackerThread(SectorStacker &stacker, qint32 sourceCount) :
+    m_stacker(stacker),
+    m_workspace(new SectorStacker::Workspace),
+    m_statistics(sourceCount)
+{}
+
+SectorStackerThread::~SectorStackerThread()
+{
+    delete m_workspace;
+}
+
+const SectorStacker::Statistics &SectorStackerThread::statistics() const
+{
+    return m_statistics;
+}
+
+void SectorStackerThread::run()
+{
+    // Each thread has its own verifier (the EDC and RSPC tables are read-only)
+    SectorVerifier verifier;
+
+    qint32 startAddress;
+    qint32 endAddress;
+    while (m_stacker.getInputChunk(startAddress, endAddress)) {
+        for (qint32 address = startAddress; address <= endAddress; address++) {
+            m_stacker.stackSector(address, verifier, *m_workspace, m_statistics);
+        }
+    }
+}
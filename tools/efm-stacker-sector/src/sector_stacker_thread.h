@@ -0,0 +1,52 @@
+/************************************************************************
+
+    sector_stacker_thread.h
+
+    efm-stacker-sector - EFM sector stacker
+    Copyright (C) 2025 Simon Inns
+
+    This file is part of ld-decode-tools.
+
+    This application is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+************************************************************************/
+
+#ifndef SECTOR_STACKER_THREAD_H
+#define SECTOR_STACKER_THREAD_H
+
+#include <QThread>
+
+#include "sector_stacker.h"
+
+// Worker thread that stacks chunks of sector addresses.  The inputs and
+// output are memory mapped, so the threads share them and write the stacked
+// sectors directly to their place in the output
+class SectorStackerThread : public QThread
+{
+public:
+    SectorStackerThread(SectorStacker &stacker, qint32 sourceCount);
+    ~SectorStackerThread();
+
+    const SectorStacker::Statistics &statistics() const;
+
+protected:
+    void run() override;
+
+private:
+    SectorStacker &m_stacker;
+    SectorStacker::Workspace *m_workspace;
+    SectorStacker::Statistics m_statistics;
+};
+
+#endif // SECTOR_STACKER_THREAD_H
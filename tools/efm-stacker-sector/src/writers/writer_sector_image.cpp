@@ -0,0 +1,90 @@
+/************************************************************************
+
+    writer_sector_image.cpp
+
+    efm-stacker-sector - EFM sector stacker
+    Copyright (C) 2025 Simon Inns
+
+    This file is part of ld-decode-tools.
+
+    This application is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+************************************************************************/
+
+#include "writer_sector_image.h"
+#include "reader_sector_image.h"
+
+WriterSectorImage::WriterSectorImage() :
+    m_image(nullptr),
+    m_sectorMap(nullptr)
+{}
+
+WriterSectorImage::~WriterSectorImage()
+{
+    close();
+}
+
+bool WriterSectorImage::open(const QString &filename, qint32 sectorCount)
+{
+    const QString mapFilename = ReaderSectorImage::sectorMapFilename(filename);
+    const qint64 imageSize = static_cast<qint64>(sectorCount) * RawSector::Size;
+    const qint64 mapSize = SectorMap::HeaderSize + static_cast<qint64>(sectorCount) * SectorMap::RecordSize;
+
+    if (sectorCount < 1) {
+        qCritical() << "WriterSectorImage::open() - There are no sectors to write";
+        return false;
+    }
+
+    m_imageFile.setFileName(filename);
+    m_sectorMapFile.setFileName(mapFilename);
+    if (!m_imageFile.open(QIODevice::ReadWrite | QIODevice::Truncate) || !m_imageFile.resize(imageSize)) {
+        qCritical() << "WriterSectorImage::open() - Could not create file" << filename;
+        close();
+        return false;
+    }
+    if (!m_sectorMapFile.open(QIODevice::ReadWrite | QIODevice::Truncate) || !m_sectorMapFile.resize(mapSize)) {
+        qCritical() << "WriterSectorImage::open() - Could not create sector map file" << mapFilename;
+        close();
+        return false;
+    }
+
+    m_image = m_imageFile.map(0, imageSize);
+    m_sectorMap = m_sectorMapFile.map(0, mapSize);
+    if (!m_image || !m_sectorMap) {
+        qCritical() << "WriterSectorImage::open() - Could not map the output files" << filename << mapFilename;
+        close();
+        return false;
+    }
+
+    SectorMap::encodeHeader(m_sectorMap);
+
+    qDebug() << "WriterSectorImage::open() - Opened" << filename << "and" << mapFilename << "for writing" << sectorCount << "sectors";
+    return true;
+}
+
+void WriterSectorImage::close()
+{
+    if (m_image) m_imageFile.unmap(m_image);
+    if (m_sectorMap) m_sectorMapFile.unmap(m_sectorMap);
+    m_image = nullptr;
+    m_sectorMap = nullptr;
+
+    if (m_imageFile.isOpen()) m_imageFile.close();
+    if (m_sectorMapFile.isOpen()) m_sectorMapFile.close();
+}
+
+quint8 *WriterSectorImage::record(qint32 address) const
+{
+    return m_sectorMap + SectorMap::HeaderSize + static_cast<qint64>(address) * SectorMap::RecordSize;
+}
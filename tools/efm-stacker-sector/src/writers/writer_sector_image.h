@@ -0,0 +1,59 @@
+/************************************************************************
+
+    writer_sector_image.h
+
+    efm-stacker-sector - EFM sector stacker
+    Copyright (C) 2025 Simon Inns
+
+    This file is part of ld-decode-tools.
+
+    This application is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+************************************************************************/
+
+#ifndef WRITER_SECTOR_IMAGE_H
+#define WRITER_SECTOR_IMAGE_H
+
+#include <QString>
+#include <QDebug>
+#include <QFile>
+
+#include "sector.h"
+#include "sector_map.h"
+
+// Creates a 2352 byte raw sector image and its binary sector map at their
+// final size and memory maps them, so that each sector can be written in
+// place (from any thread, as long as each sector is only written once).
+// Sectors (and records) that are never written are left as holes
+class WriterSectorImage
+{
+public:
+    WriterSectorImage();
+    ~WriterSectorImage();
+
+    bool open(const QString &filename, qint32 sectorCount);
+    void close();
+    bool isOpen() const { return m_image != nullptr; }
+
+    quint8 *data(qint32 address) const { return m_image + static_cast<qint64>(address) * RawSector::Size; }
+    quint8 *record(qint32 address) const;
+
+private:
+    QFile m_imageFile;
+    QFile m_sectorMapFile;
+    uchar *m_image;
+    uchar *m_sectorMap;
+};
+
+#endif // WRITER_SECTOR_IMAGE_H
@@ -23,9 +23,15 @@
 ************************************************************************/
 
 #include "bad_sectors.h"
+#include "sector_map.h"
+
+#include <algorithm>
 
 BadSectors::BadSectors() :
-    m_isOpen(false)
+    m_isOpen(false),
+    m_sectorMap(nullptr),
+    m_sectorMapRecords(0),
+    m_sectorMapFirstAddress(0)
 {}
 
 bool BadSectors::open(QString filename)
@@ -37,14 +43,35 @@ bool BadSectors::open(QString filename)
     }
     qDebug() << "BadSectors::open() - Opened file" << filename << "for reading";
 
-    // Read the bad sector list (this is a text file with one sector number per line)
+    // Is this a binary sector map (rather than a text bad sector map)?
+    if (openSectorMap()) {
+        qDebug() << "BadSectors::open() - Mapped" << m_sectorMapRecords << "sector map records from file" << filename;
+        m_isOpen = true;
+        return true;
+    }
+
+    // Read the bad sector list (this is a text file with one sector number, or
+    // a "first-last" range of sector numbers, per line)
+    quint32 badSectorCount = 0;
     while (!m_file.atEnd()) {
-        QByteArray line = m_file.readLine();
-        quint32 sector = line.toUInt();
-        m_badSectors.append(sector);
+        QByteArray line = m_file.readLine().trimmed();
+        if (line.isEmpty()) continue;
+
+        BadSectorRange range;
+        const int separator = line.indexOf('-');
+        if (separator == -1) {
+            range.first = range.last = line.toUInt();
+        } else {
+            range.first = line.left(separator).toUInt();
+            range.last = line.mid(separator + 1).toUInt();
+        }
+        m_badSectors.append(range);
+        badSectorCount += range.last - range.first + 1;
     }
+    std::sort(m_badSectors.begin(), m_badSectors.end(),
+        [](const BadSectorRange &a, const BadSectorRange &b) { return a.first < b.first; });
 
-    qDebug() << "BadSectors::open() - Read" << m_badSectors.size() << "bad sectors from file" << filename;
+    qDebug() << "BadSectors::open() - Read" << badSectorCount << "bad sectors from file" << filename;
 
     m_isOpen = true;
     return true;
@@ -52,6 +79,11 @@ bool BadSectors::open(QString filename)
 
 void BadSectors::close()
 {
+    if (m_sectorMap) {
+        m_file.unmap(const_cast<uchar *>(m_sectorMap));
+        m_sectorMap = nullptr;
+        m_sectorMapRecords = 0;
+    }
     if (m_file.isOpen()) {
         m_file.close();
     }
@@ -60,5 +92,53 @@ void BadSectors::close()
 
 bool BadSectors::isSectorBad(quint32 sector) const
 {
-    return m_badSectors.contains(sector);
+    if (m_sectorMap) return isSectorMapSectorBad(sector);
+
+    // Find the last range starting at or before the sector
+    auto range = std::upper_bound(m_badSectors.begin(), m_badSectors.end(), sector,
+        [](quint32 value, const BadSectorRange &r) { return value < r.first; });
+    if (range == m_badSectors.begin()) return false;
+    --range;
+    return sector <= range->last;
+}
+
+// Memory map the file if it is a binary sector map (written by efm-decoder-data
+// with --output-sector-map)
+bool BadSectors::openSectorMap()
+{
+    const qint64 fileSize = m_file.size();
+    if (fileSize < SectorMap::HeaderSize) return false;
+
+    const uchar *map = m_file.map(0, fileSize);
+    if (!map) return false;
+
+    if (!SectorMap::isValidHeader(map, fileSize)) {
+        m_file.unmap(const_cast<uchar *>(map));
+        return false;
+    }
+
+    m_sectorMap = map;
+    m_sectorMapRecords = (fileSize - SectorMap::HeaderSize) / SectorMap::RecordSize;
+    if (m_sectorMapRecords > 0) {
+        m_sectorMapFirstAddress = SectorMap::recordAddress(m_sectorMap + SectorMap::HeaderSize);
+    }
+    return true;
+}
+
+// The records are written in address order with no gaps, so the record for a
+// sector is found directly from its address.  Sectors that are not in the map
+// are not considered bad (as with the text bad sector map)
+bool BadSectors::isSectorMapSectorBad(quint32 sector) const
+{
+    const qint64 index = static_cast<qint64>(sector) - m_sectorMapFirstAddress;
+    if (index < 0 || index >= m_sectorMapRecords) return false;
+
+    // Missing sectors are zero records, so only valid records have an address
+    const uchar *record = m_sectorMap + SectorMap::HeaderSize + index * SectorMap::RecordSize;
+    if (!(SectorMap::recordStatus(record) & SectorMap::Valid)) return true;
+
+    if (SectorMap::recordAddress(record) != static_cast<qint32>(sector)) {
+        qWarning() << "BadSectors::isSectorBad() - Sector map record" << index << "has address" << SectorMap::recordAddress(record) << "expected" << sector;
+    }
+    return false;
 }
\ No newline at end of file
@@ -40,9 +40,22 @@ public:
     bool isSectorBad(quint32 sector) const;
 
 private:
-    QVector<quint32> m_badSectors;
+    struct BadSectorRange {
+        quint32 first;
+        quint32 last;
+    };
+
+    QVector<BadSectorRange> m_badSectors;
     QFile m_file;
     bool m_isOpen;
+
+    // Binary sector map (memory mapped)
+    const uchar *m_sectorMap;
+    qint64 m_sectorMapRecords;
+    qint32 m_sectorMapFirstAddress;
+
+    bool openSectorMap();
+    bool isSectorMapSectorBad(quint32 sector) const;
 };
 
 #endif // BAD_SECTORS_H
\ No newline at end of file
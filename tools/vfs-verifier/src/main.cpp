@@ -64,7 +64,7 @@ int main(int argc, char *argv[])
     parser.addPositionalArgument("input",
         QCoreApplication::translate("main", "Specify input EFM file"));
     parser.addPositionalArgument("bad-sector-map",
-        QCoreApplication::translate("main", "Specify bad sector map metadata file"));
+        QCoreApplication::translate("main", "Specify bad sector map metadata file (text or binary sector map)"));
 
     // Process the command line options and arguments given by the user
     parser.process(app);